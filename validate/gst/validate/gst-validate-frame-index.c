@@ -0,0 +1,403 @@
+/* GStreamer
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * gst-validate-frame-index.c - Per stream index of the frames of a media
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <glib/gstdio.h>
+
+#include "gst-validate-frame-index.h"
+
+/* A frame index file is made of:
+ *
+ *  - a FrameIndexHeader
+ *  - the stream id and the caps of the stream, as NUL terminated strings,
+ *    padded to 8 bytes
+ *  - one FrameRecord per frame, in decoding order
+ *
+ * All the numbers are little endian. Records are appended as the frames
+ * come and the number of frames is written in the header once done, so
+ * the file can be written without keeping the index in memory and mapped
+ * as is when loaded.
+ */
+#define FRAME_INDEX_MAGIC "GVFI"
+#define FRAME_INDEX_VERSION 1
+
+/* How many frames can come, in decoding order, before a frame with a
+ * lower presentation timestamp */
+#define MAX_REORDER_DEPTH 32
+
+#define NO_KEYFRAME G_MAXUINT32
+#define FRAME_FLAG_KEYFRAME (1 << 0)
+
+#define PADDED_SIZE(size) (((size) + 7) & ~7)
+
+typedef struct
+{
+  gchar magic[4];
+  guint32 version;
+  guint64 n_frames;
+  /* Including the NUL terminator */
+  guint32 stream_id_size;
+  guint32 caps_size;
+} FrameIndexHeader;
+
+typedef struct
+{
+  guint64 pts;
+  guint64 dts;
+  guint64 duration;
+  guint64 offset;
+  guint32 flags;
+  /* Index of the last keyframe, in decoding order, NO_KEYFRAME if none */
+  guint32 keyframe;
+} FrameRecord;
+
+struct _GstValidateFrameIndexWriter
+{
+  FILE *file;
+  gchar *path;
+  guint64 n_frames;
+  guint32 last_keyframe;
+  gboolean failed;
+};
+
+struct _GstValidateFrameIndex
+{
+  GMappedFile *mapped;
+  const gchar *stream_id;
+  const gchar *caps;
+  const FrameRecord *records;
+  guint n_frames;
+};
+
+/**
+ * gst_validate_frame_index_writer_new:
+ * @path: Where to write the index
+ * @stream_id: (allow-none): The id of the indexed stream
+ * @caps: (allow-none): The caps of the indexed stream
+ * @err: Return location for a #GError or %NULL
+ *
+ * Returns: A new #GstValidateFrameIndexWriter to which the frames of the
+ * stream are added with gst_validate_frame_index_writer_add_buffer(), or
+ * %NULL if @path could not be opened
+ */
+GstValidateFrameIndexWriter *
+gst_validate_frame_index_writer_new (const gchar * path,
+    const gchar * stream_id, GstCaps * caps, GError ** err)
+{
+  FrameIndexHeader header;
+  GstValidateFrameIndexWriter *writer;
+  gchar *caps_str = caps ? gst_caps_to_string (caps) : g_strdup ("");
+  static const gchar padding[8] = { 0, };
+  gsize strings_size;
+  FILE *file;
+
+  if (stream_id == NULL)
+    stream_id = "";
+
+  if (!(file = g_fopen (path, "wb"))) {
+    g_set_error (err, G_FILE_ERROR, g_file_error_from_errno (errno),
+        "Could not open %s: %s", path, g_strerror (errno));
+    g_free (caps_str);
+
+    return NULL;
+  }
+
+  memcpy (header.magic, FRAME_INDEX_MAGIC, sizeof (header.magic));
+  header.version = GUINT32_TO_LE (FRAME_INDEX_VERSION);
+  header.n_frames = 0;
+  header.stream_id_size = GUINT32_TO_LE (strlen (stream_id) + 1);
+  header.caps_size = GUINT32_TO_LE (strlen (caps_str) + 1);
+
+  writer = g_slice_new0 (GstValidateFrameIndexWriter);
+  writer->file = file;
+  writer->path = g_strdup (path);
+  writer->last_keyframe = NO_KEYFRAME;
+
+  strings_size = strlen (stream_id) + strlen (caps_str) + 2;
+  if (fwrite (&header, sizeof (header), 1, file) != 1
+      || fwrite (stream_id, strlen (stream_id) + 1, 1, file) != 1
+      || fwrite (caps_str, strlen (caps_str) + 1, 1, file) != 1
+      || fwrite (padding, PADDED_SIZE (strings_size) - strings_size, 1,
+          file) > 1)
+    writer->failed = TRUE;
+  g_free (caps_str);
+
+  return writer;
+}
+
+/**
+ * gst_validate_frame_index_writer_add_buffer:
+ * @writer: The #GstValidateFrameIndexWriter
+ * @buffer: The next frame of the stream, in decoding order
+ */
+void
+gst_validate_frame_index_writer_add_buffer (GstValidateFrameIndexWriter *
+    writer, GstBuffer * buffer)
+{
+  FrameRecord record;
+
+  if (writer->failed)
+    return;
+
+  if (!GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT))
+    writer->last_keyframe = writer->n_frames;
+
+  record.pts = GUINT64_TO_LE (GST_BUFFER_PTS (buffer));
+  record.dts = GUINT64_TO_LE (GST_BUFFER_DTS (buffer));
+  record.duration = GUINT64_TO_LE (GST_BUFFER_DURATION (buffer));
+  record.offset = GUINT64_TO_LE (GST_BUFFER_OFFSET (buffer));
+  record.flags = GUINT32_TO_LE (writer->last_keyframe == writer->n_frames ?
+      FRAME_FLAG_KEYFRAME : 0);
+  record.keyframe = GUINT32_TO_LE (writer->last_keyframe);
+
+  if (fwrite (&record, sizeof (record), 1, writer->file) != 1)
+    writer->failed = TRUE;
+  else
+    writer->n_frames++;
+}
+
+/**
+ * gst_validate_frame_index_writer_close:
+ * @writer: (transfer full): The #GstValidateFrameIndexWriter
+ * @err: Return location for a #GError or %NULL
+ *
+ * Finishes writing the index and frees @writer. The index file is removed
+ * if it could not be fully written.
+ *
+ * Returns: %TRUE if the index was written
+ */
+gboolean
+gst_validate_frame_index_writer_close (GstValidateFrameIndexWriter * writer,
+    GError ** err)
+{
+  guint64 n_frames = GUINT64_TO_LE (writer->n_frames);
+  gboolean ret = !writer->failed;
+
+  if (ret && (writer->n_frames > NO_KEYFRAME
+          || fseek (writer->file, G_STRUCT_OFFSET (FrameIndexHeader,
+                  n_frames), SEEK_SET) != 0
+          || fwrite (&n_frames, sizeof (n_frames), 1, writer->file) != 1))
+    ret = FALSE;
+
+  if (fclose (writer->file) != 0)
+    ret = FALSE;
+
+  if (!ret) {
+    g_set_error (err, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+        "Could not write frame index %s", writer->path);
+    g_unlink (writer->path);
+  }
+
+  g_free (writer->path);
+  g_slice_free (GstValidateFrameIndexWriter, writer);
+
+  return ret;
+}
+
+/**
+ * gst_validate_frame_index_load:
+ * @path: The index file to load
+ * @err: Return location for a #GError or %NULL
+ *
+ * Maps an index written by a #GstValidateFrameIndexWriter, the frames are
+ * only read when looked up.
+ *
+ * Returns: The #GstValidateFrameIndex, or %NULL on error
+ */
+GstValidateFrameIndex *
+gst_validate_frame_index_load (const gchar * path, GError ** err)
+{
+  const gchar *data;
+  gsize size, records_offset;
+  guint64 n_frames;
+  guint32 stream_id_size, caps_size;
+  const FrameIndexHeader *header;
+  GstValidateFrameIndex *index;
+  GMappedFile *mapped = g_mapped_file_new (path, FALSE, err);
+
+  if (mapped == NULL)
+    return NULL;
+
+  data = g_mapped_file_get_contents (mapped);
+  size = g_mapped_file_get_length (mapped);
+  header = (const FrameIndexHeader *) data;
+  if (size < sizeof (FrameIndexHeader)
+      || memcmp (header->magic, FRAME_INDEX_MAGIC, sizeof (header->magic))
+      || GUINT32_FROM_LE (header->version) != FRAME_INDEX_VERSION)
+    goto invalid;
+
+  n_frames = GUINT64_FROM_LE (header->n_frames);
+  stream_id_size = GUINT32_FROM_LE (header->stream_id_size);
+  caps_size = GUINT32_FROM_LE (header->caps_size);
+  records_offset = sizeof (FrameIndexHeader) +
+      PADDED_SIZE ((gsize) stream_id_size + caps_size);
+
+  if (stream_id_size == 0 || caps_size == 0 || n_frames > NO_KEYFRAME
+      || records_offset > size
+      || (size - records_offset) / sizeof (FrameRecord) < n_frames
+      || data[sizeof (FrameIndexHeader) + stream_id_size - 1] != '\0'
+      || data[sizeof (FrameIndexHeader) + stream_id_size + caps_size - 1] !=
+      '\0')
+    goto invalid;
+
+  index = g_slice_new0 (GstValidateFrameIndex);
+  index->mapped = mapped;
+  index->stream_id = data + sizeof (FrameIndexHeader);
+  index->caps = index->stream_id + stream_id_size;
+  index->records = (const FrameRecord *) (data + records_offset);
+  index->n_frames = n_frames;
+
+  return index;
+
+invalid:
+  g_set_error (err, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+      "%s is not a valid frame index", path);
+  g_mapped_file_unref (mapped);
+
+  return NULL;
+}
+
+void
+gst_validate_frame_index_free (GstValidateFrameIndex * index)
+{
+  g_mapped_file_unref (index->mapped);
+  g_slice_free (GstValidateFrameIndex, index);
+}
+
+const gchar *
+gst_validate_frame_index_get_stream_id (GstValidateFrameIndex * index)
+{
+  return index->stream_id;
+}
+
+/**
+ * gst_validate_frame_index_get_caps:
+ * @index: The #GstValidateFrameIndex
+ *
+ * Returns: (transfer full): The caps of the indexed stream, %NULL if
+ * unknown
+ */
+GstCaps *
+gst_validate_frame_index_get_caps (GstValidateFrameIndex * index)
+{
+  if (*index->caps == '\0')
+    return NULL;
+
+  return gst_caps_from_string (index->caps);
+}
+
+guint
+gst_validate_frame_index_get_n_frames (GstValidateFrameIndex * index)
+{
+  return index->n_frames;
+}
+
+/**
+ * gst_validate_frame_index_get_frame:
+ * @index: The #GstValidateFrameIndex
+ * @n: The number of the frame, in decoding order
+ * @frame: (out): The frame
+ *
+ * Returns: %TRUE if @n is a frame of @index
+ */
+gboolean
+gst_validate_frame_index_get_frame (GstValidateFrameIndex * index, guint n,
+    GstValidateFrame * frame)
+{
+  const FrameRecord *record;
+
+  if (n >= index->n_frames)
+    return FALSE;
+
+  record = &index->records[n];
+  frame->pts = GUINT64_FROM_LE (record->pts);
+  frame->dts = GUINT64_FROM_LE (record->dts);
+  frame->duration = GUINT64_FROM_LE (record->duration);
+  frame->offset = GUINT64_FROM_LE (record->offset);
+  frame->keyframe = ! !(GUINT32_FROM_LE (record->flags) & FRAME_FLAG_KEYFRAME);
+
+  return TRUE;
+}
+
+/* The decoding timestamp when known, frames are sorted on it */
+static inline GstClockTime
+_record_decoding_time (const FrameRecord * record)
+{
+  GstClockTime dts = GUINT64_FROM_LE (record->dts);
+
+  return GST_CLOCK_TIME_IS_VALID (dts) ? dts : GUINT64_FROM_LE (record->pts);
+}
+
+/**
+ * gst_validate_frame_index_find_frame:
+ * @index: The #GstValidateFrameIndex
+ * @position: A presentation time
+ * @keyframe: Whether to look for the keyframe needed to decode that frame
+ * @frame: (out): The frame found
+ *
+ * Looks for the frame displayed at @position, which is the one with the
+ * highest presentation timestamp that is not after @position, or for the
+ * last keyframe before it in decoding order if @keyframe is %TRUE.
+ *
+ * Returns: %TRUE if a frame was found
+ */
+gboolean
+gst_validate_frame_index_find_frame (GstValidateFrameIndex * index,
+    GstClockTime position, gboolean keyframe, GstValidateFrame * frame)
+{
+  guint lo = 0, hi = index->n_frames, i, found = NO_KEYFRAME;
+  GstClockTime best_pts = 0;
+
+  /* First frame decoded after @position, no frame from there can be
+   * displayed at @position as a frame is decoded before being displayed */
+  while (lo < hi) {
+    guint mid = lo + (hi - lo) / 2;
+
+    if (_record_decoding_time (&index->records[mid]) <= position)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  for (i = lo; i > 0 && lo - i < MAX_REORDER_DEPTH; i--) {
+    GstClockTime pts = GUINT64_FROM_LE (index->records[i - 1].pts);
+
+    if (GST_CLOCK_TIME_IS_VALID (pts) && pts <= position &&
+        (found == NO_KEYFRAME || pts > best_pts)) {
+      found = i - 1;
+      best_pts = pts;
+    }
+  }
+
+  if (found != NO_KEYFRAME && keyframe)
+    found = GUINT32_FROM_LE (index->records[found].keyframe);
+
+  if (found == NO_KEYFRAME)
+    return FALSE;
+
+  return gst_validate_frame_index_get_frame (index, found, frame);
+}
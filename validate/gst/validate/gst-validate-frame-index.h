@@ -0,0 +1,77 @@
+/* GStreamer
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * gst-validate-frame-index.h - Per stream index of the frames of a media
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_VALIDATE_FRAME_INDEX_H__
+#define __GST_VALIDATE_FRAME_INDEX_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstValidateFrameIndex GstValidateFrameIndex;
+typedef struct _GstValidateFrameIndexWriter GstValidateFrameIndexWriter;
+
+/**
+ * GstValidateFrame:
+ * @pts: Presentation timestamp of the frame
+ * @dts: Decoding timestamp of the frame
+ * @duration: Duration of the frame
+ * @offset: Offset of the frame, in bytes in the file when the demuxer
+ * provides it
+ * @keyframe: Whether the frame can be decoded on its own
+ *
+ * A frame of a #GstValidateFrameIndex.
+ */
+typedef struct
+{
+  GstClockTime pts;
+  GstClockTime dts;
+  GstClockTime duration;
+  guint64 offset;
+  gboolean keyframe;
+} GstValidateFrame;
+
+GstValidateFrameIndexWriter * gst_validate_frame_index_writer_new   (const gchar * path,
+                                                                     const gchar * stream_id,
+                                                                     GstCaps * caps,
+                                                                     GError ** err);
+void     gst_validate_frame_index_writer_add_buffer (GstValidateFrameIndexWriter * writer,
+                                                     GstBuffer * buffer);
+gboolean gst_validate_frame_index_writer_close      (GstValidateFrameIndexWriter * writer,
+                                                     GError ** err);
+
+GstValidateFrameIndex * gst_validate_frame_index_load (const gchar * path,
+                                                       GError ** err);
+void          gst_validate_frame_index_free          (GstValidateFrameIndex * index);
+const gchar * gst_validate_frame_index_get_stream_id (GstValidateFrameIndex * index);
+GstCaps *     gst_validate_frame_index_get_caps      (GstValidateFrameIndex * index);
+guint         gst_validate_frame_index_get_n_frames  (GstValidateFrameIndex * index);
+gboolean      gst_validate_frame_index_get_frame     (GstValidateFrameIndex * index,
+                                                      guint n,
+                                                      GstValidateFrame * frame);
+gboolean      gst_validate_frame_index_find_frame    (GstValidateFrameIndex * index,
+                                                      GstClockTime position,
+                                                      gboolean keyframe,
+                                                      GstValidateFrame * frame);
+
+G_END_DECLS
+
+#endif /* __GST_VALIDATE_FRAME_INDEX_H__ */
@@ -0,0 +1,44 @@
+/* GStreamer
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * gst-validate-histogram-private.h - Latency distributions
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Not installed, only shared with the tools built in this tree */
+
+#ifndef __GST_VALIDATE_HISTOGRAM_PRIVATE_H__
+#define __GST_VALIDATE_HISTOGRAM_PRIVATE_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstValidateHistogram GstValidateHistogram;
+
+GstValidateHistogram * gst_validate_histogram_new (void);
+void gst_validate_histogram_free                  (GstValidateHistogram * histogram);
+void gst_validate_histogram_add                   (GstValidateHistogram * histogram,
+                                                   GstClockTime value);
+guint gst_validate_histogram_get_count            (GstValidateHistogram * histogram);
+GstClockTime gst_validate_histogram_get_percentile (GstValidateHistogram * histogram,
+                                                    gdouble percentile);
+gchar * gst_validate_histogram_to_string          (GstValidateHistogram * histogram);
+
+G_END_DECLS
+
+#endif /* __GST_VALIDATE_HISTOGRAM_PRIVATE_H__ */
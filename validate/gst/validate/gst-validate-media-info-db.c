@@ -0,0 +1,482 @@
+/* GStreamer
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * gst-validate-media-info-db.c - Database of the media info of a corpus
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <string.h>
+#include <glib/gstdio.h>
+
+#include "gst-validate-media-info-db.h"
+#include "gst-validate-internal.h"
+#include "gst-validate-utils.h"
+
+/* A media info database file is made of:
+ *
+ *  - a MediaInfoDBHeader
+ *  - n_records MediaInfoDBRecord of record_size bytes, sorted by uri
+ *  - a table of NUL terminated strings, the records referencing them by
+ *    their offset in the table, starting with the empty string
+ *
+ * All the numbers are little endian. The file is mapped as is when loaded,
+ * listing the media of a corpus does not need to parse any of their media
+ * info files. The launcher has its own reader of that format, in
+ * tools/launcher/mediainfodb.py, both have to be kept in sync.
+ */
+#define MEDIA_INFO_DB_MAGIC "GVMD"
+#define MEDIA_INFO_DB_VERSION 2
+
+#define RECORD_FLAG_SEEKABLE (1 << 0)
+#define RECORD_FLAG_IS_IMAGE (1 << 1)
+#define RECORD_FLAG_PASSED   (1 << 2)
+
+typedef struct
+{
+  gchar magic[4];
+  guint32 version;
+  guint32 n_records;
+  /* Records can grow in later versions, readers skip what they do not
+   * know about */
+  guint32 record_size;
+  guint64 strings_offset;
+  guint64 strings_size;
+} MediaInfoDBHeader;
+
+typedef struct
+{
+  /* Offsets in the string table */
+  guint32 uri;
+  guint32 media_info_path;
+  guint32 caps;
+  guint32 flags;
+  guint64 duration;
+  guint64 file_size;
+  gint64 media_info_mtime;
+} MediaInfoDBRecord;
+
+struct _GstValidateMediaInfoDB
+{
+  GMappedFile *mapped;
+  const gchar *records;
+  guint n_records;
+  gsize record_size;
+  const gchar *strings;
+  gsize strings_size;
+};
+
+typedef struct
+{
+  gchar *uri;
+  gchar *media_info_path;
+  gchar *caps;
+  guint32 flags;
+  guint64 duration;
+  guint64 file_size;
+  gint64 media_info_mtime;
+} WriterEntry;
+
+struct _GstValidateMediaInfoDBWriter
+{
+  gchar *path;
+
+  GMutex lock;
+  /* uri -> WriterEntry */
+  GHashTable *entries;
+};
+
+static void
+_writer_entry_free (WriterEntry * entry)
+{
+  g_free (entry->uri);
+  g_free (entry->media_info_path);
+  g_free (entry->caps);
+  g_slice_free (WriterEntry, entry);
+}
+
+static guint32
+_flags_from_entry (GstValidateMediaInfoDBEntry * entry)
+{
+  return (entry->seekable ? RECORD_FLAG_SEEKABLE : 0) |
+      (entry->is_image ? RECORD_FLAG_IS_IMAGE : 0) |
+      (entry->passed ? RECORD_FLAG_PASSED : 0);
+}
+
+/**
+ * gst_validate_media_info_db_writer_new:
+ * @path: Where the database is
+ *
+ * The entries of the database already in @path, if any, are kept unless
+ * they are replaced with gst_validate_media_info_db_writer_add(), so that
+ * a database can be updated without checking the whole corpus again.
+ *
+ * Returns: A new #GstValidateMediaInfoDBWriter
+ */
+GstValidateMediaInfoDBWriter *
+gst_validate_media_info_db_writer_new (const gchar * path)
+{
+  guint i;
+  GError *err = NULL;
+  GstValidateMediaInfoDB *db;
+  GstValidateMediaInfoDBWriter *writer =
+      g_slice_new0 (GstValidateMediaInfoDBWriter);
+
+  writer->path = g_strdup (path);
+  g_mutex_init (&writer->lock);
+  writer->entries = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+      (GDestroyNotify) _writer_entry_free);
+
+  if (!g_file_test (path, G_FILE_TEST_EXISTS))
+    return writer;
+
+  if (!(db = gst_validate_media_info_db_load (path, &err))) {
+    GST_WARNING ("Could not load %s, rewriting it: %s", path, err->message);
+    g_clear_error (&err);
+    return writer;
+  }
+
+  for (i = 0; i < db->n_records; i++) {
+    GstValidateMediaInfoDBEntry dbentry;
+    WriterEntry *entry;
+
+    if (!gst_validate_media_info_db_get_entry (db, i, &dbentry))
+      continue;
+
+    entry = g_slice_new0 (WriterEntry);
+    entry->uri = g_strdup (dbentry.uri);
+    entry->media_info_path = g_strdup (dbentry.media_info_path);
+    entry->caps = g_strdup (dbentry.caps);
+    entry->flags = _flags_from_entry (&dbentry);
+    entry->duration = dbentry.duration;
+    entry->file_size = dbentry.file_size;
+    entry->media_info_mtime = dbentry.media_info_mtime;
+    g_hash_table_replace (writer->entries, entry->uri, entry);
+  }
+  gst_validate_media_info_db_free (db);
+
+  return writer;
+}
+
+/**
+ * gst_validate_media_info_db_writer_add:
+ * @writer: The #GstValidateMediaInfoDBWriter
+ * @mi: The #GstValidateMediaInfo of a media
+ * @media_info_path: Where @mi was saved
+ *
+ * Adds the summary of @mi to the database, replacing the previous entry of
+ * the same uri. Can be called from any thread.
+ */
+void
+gst_validate_media_info_db_writer_add (GstValidateMediaInfoDBWriter * writer,
+    GstValidateMediaInfo * mi, const gchar * media_info_path)
+{
+  GStatBuf statbuf;
+  WriterEntry *entry;
+
+  g_return_if_fail (mi->uri != NULL);
+
+  entry = g_slice_new0 (WriterEntry);
+  entry->uri = g_strdup (mi->uri);
+  if (g_path_is_absolute (media_info_path)) {
+    entry->media_info_path = g_strdup (media_info_path);
+  } else {
+    gchar *cdir = g_get_current_dir ();
+
+    entry->media_info_path = g_build_filename (cdir, media_info_path, NULL);
+    g_free (cdir);
+  }
+  entry->caps = gst_validate_media_info_get_caps_string (mi);
+  entry->flags = (mi->seekable ? RECORD_FLAG_SEEKABLE : 0) |
+      (mi->is_image ? RECORD_FLAG_IS_IMAGE : 0) |
+      (!mi->playback_error && !mi->reverse_playback_error
+      && !mi->track_switch_error ? RECORD_FLAG_PASSED : 0);
+  entry->duration = mi->duration;
+  entry->file_size = mi->file_size;
+  if (g_stat (entry->media_info_path, &statbuf) == 0)
+    entry->media_info_mtime = gst_validate_utils_get_mtime (&statbuf);
+
+  g_mutex_lock (&writer->lock);
+  g_hash_table_replace (writer->entries, entry->uri, entry);
+  g_mutex_unlock (&writer->lock);
+}
+
+static gint
+_compare_entries (WriterEntry ** a, WriterEntry ** b)
+{
+  return strcmp ((*a)->uri, (*b)->uri);
+}
+
+static guint32
+_add_string (GByteArray * strings, GHashTable * offsets, const gchar * str)
+{
+  gpointer offset;
+
+  if (str == NULL || *str == '\0')
+    return 0;
+
+  /* Many media share the same caps */
+  if (g_hash_table_lookup_extended (offsets, str, NULL, &offset))
+    return GPOINTER_TO_UINT (offset);
+
+  offset = GUINT_TO_POINTER (strings->len);
+  g_byte_array_append (strings, (const guint8 *) str, strlen (str) + 1);
+  g_hash_table_insert (offsets, (gpointer) str, offset);
+
+  return GPOINTER_TO_UINT (offset);
+}
+
+/**
+ * gst_validate_media_info_db_writer_close:
+ * @writer: (transfer full): The #GstValidateMediaInfoDBWriter
+ * @err: Return location for a #GError or %NULL
+ *
+ * Writes the database and frees @writer. The database is replaced at
+ * once, readers never see a partially written file.
+ *
+ * Returns: %TRUE if the database was written
+ */
+gboolean
+gst_validate_media_info_db_writer_close (GstValidateMediaInfoDBWriter *
+    writer, GError ** err)
+{
+  guint i;
+  gboolean ret;
+  GHashTableIter iter;
+  WriterEntry *entry;
+  MediaInfoDBHeader header;
+  GPtrArray *sorted = g_ptr_array_new ();
+  GByteArray *data = g_byte_array_new ();
+  GByteArray *strings = g_byte_array_new ();
+  GHashTable *offsets = g_hash_table_new (g_str_hash, g_str_equal);
+
+  g_hash_table_iter_init (&iter, writer->entries);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) & entry))
+    g_ptr_array_add (sorted, entry);
+  g_ptr_array_sort (sorted, (GCompareFunc) _compare_entries);
+
+  g_byte_array_append (strings, (const guint8 *) "", 1);
+  g_byte_array_set_size (data, sizeof (header) +
+      sorted->len * sizeof (MediaInfoDBRecord));
+  for (i = 0; i < sorted->len; i++) {
+    MediaInfoDBRecord record;
+
+    entry = g_ptr_array_index (sorted, i);
+    record.uri = GUINT32_TO_LE (_add_string (strings, offsets, entry->uri));
+    record.media_info_path = GUINT32_TO_LE (_add_string (strings, offsets,
+            entry->media_info_path));
+    record.caps = GUINT32_TO_LE (_add_string (strings, offsets,
+            entry->caps));
+    record.flags = GUINT32_TO_LE (entry->flags);
+    record.duration = GUINT64_TO_LE (entry->duration);
+    record.file_size = GUINT64_TO_LE (entry->file_size);
+    record.media_info_mtime = GINT64_TO_LE (entry->media_info_mtime);
+    memcpy (data->data + sizeof (header) + i * sizeof (record), &record,
+        sizeof (record));
+  }
+
+  memcpy (header.magic, MEDIA_INFO_DB_MAGIC, sizeof (header.magic));
+  header.version = GUINT32_TO_LE (MEDIA_INFO_DB_VERSION);
+  header.n_records = GUINT32_TO_LE (sorted->len);
+  header.record_size = GUINT32_TO_LE (sizeof (MediaInfoDBRecord));
+  header.strings_offset = GUINT64_TO_LE (data->len);
+  header.strings_size = GUINT64_TO_LE (strings->len);
+  memcpy (data->data, &header, sizeof (header));
+  g_byte_array_append (data, strings->data, strings->len);
+
+  ret = g_file_set_contents (writer->path, (const gchar *) data->data,
+      data->len, err);
+
+  g_hash_table_unref (offsets);
+  g_byte_array_unref (strings);
+  g_byte_array_unref (data);
+  g_ptr_array_unref (sorted);
+  g_hash_table_unref (writer->entries);
+  g_mutex_clear (&writer->lock);
+  g_free (writer->path);
+  g_slice_free (GstValidateMediaInfoDBWriter, writer);
+
+  return ret;
+}
+
+/**
+ * gst_validate_media_info_db_load:
+ * @path: The database to load
+ * @err: Return location for a #GError or %NULL
+ *
+ * Maps a database written by a #GstValidateMediaInfoDBWriter, the entries
+ * are only read when looked up.
+ *
+ * Returns: The #GstValidateMediaInfoDB, or %NULL on error
+ */
+GstValidateMediaInfoDB *
+gst_validate_media_info_db_load (const gchar * path, GError ** err)
+{
+  const gchar *data;
+  gsize size;
+  guint32 n_records, record_size;
+  guint64 strings_offset, strings_size;
+  const MediaInfoDBHeader *header;
+  GstValidateMediaInfoDB *db;
+  GMappedFile *mapped = g_mapped_file_new (path, FALSE, err);
+
+  if (mapped == NULL)
+    return NULL;
+
+  data = g_mapped_file_get_contents (mapped);
+  size = g_mapped_file_get_length (mapped);
+  header = (const MediaInfoDBHeader *) data;
+  if (size < sizeof (MediaInfoDBHeader)
+      || memcmp (header->magic, MEDIA_INFO_DB_MAGIC, sizeof (header->magic))
+      || GUINT32_FROM_LE (header->version) != MEDIA_INFO_DB_VERSION)
+    goto invalid;
+
+  n_records = GUINT32_FROM_LE (header->n_records);
+  record_size = GUINT32_FROM_LE (header->record_size);
+  strings_offset = GUINT64_FROM_LE (header->strings_offset);
+  strings_size = GUINT64_FROM_LE (header->strings_size);
+
+  if (record_size < sizeof (MediaInfoDBRecord)
+      || strings_offset < sizeof (MediaInfoDBHeader) || strings_offset > size
+      || strings_size > size - strings_offset
+      || strings_size == 0 || data[strings_offset + strings_size - 1] != '\0'
+      || (strings_offset - sizeof (MediaInfoDBHeader)) / record_size <
+      n_records)
+    goto invalid;
+
+  db = g_slice_new0 (GstValidateMediaInfoDB);
+  db->mapped = mapped;
+  db->records = data + sizeof (MediaInfoDBHeader);
+  db->n_records = n_records;
+  db->record_size = record_size;
+  db->strings = data + strings_offset;
+  db->strings_size = strings_size;
+
+  return db;
+
+invalid:
+  g_set_error (err, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+      "%s is not a valid media info database", path);
+  g_mapped_file_unref (mapped);
+
+  return NULL;
+}
+
+void
+gst_validate_media_info_db_free (GstValidateMediaInfoDB * db)
+{
+  g_mapped_file_unref (db->mapped);
+  g_slice_free (GstValidateMediaInfoDB, db);
+}
+
+guint
+gst_validate_media_info_db_get_n_entries (GstValidateMediaInfoDB * db)
+{
+  return db->n_records;
+}
+
+static const gchar *
+_get_string (GstValidateMediaInfoDB * db, guint32 offset)
+{
+  offset = GUINT32_FROM_LE (offset);
+
+  /* The table ends with a NUL, any offset in it is a valid string */
+  return offset < db->strings_size ? db->strings + offset : NULL;
+}
+
+static void
+_read_record (GstValidateMediaInfoDB * db, guint n, MediaInfoDBRecord * record)
+{
+  /* Records are not necessarily aligned when they grew */
+  memcpy (record, db->records + (gsize) n * db->record_size,
+      sizeof (MediaInfoDBRecord));
+}
+
+/**
+ * gst_validate_media_info_db_get_entry:
+ * @db: The #GstValidateMediaInfoDB
+ * @n: The number of the entry, entries are sorted by uri
+ * @entry: (out): Return location for the entry
+ *
+ * Returns: %TRUE if @entry was filled
+ */
+gboolean
+gst_validate_media_info_db_get_entry (GstValidateMediaInfoDB * db, guint n,
+    GstValidateMediaInfoDBEntry * entry)
+{
+  guint32 flags;
+  MediaInfoDBRecord record;
+
+  if (n >= db->n_records)
+    return FALSE;
+
+  _read_record (db, n, &record);
+  entry->uri = _get_string (db, record.uri);
+  entry->media_info_path = _get_string (db, record.media_info_path);
+  entry->caps = _get_string (db, record.caps);
+  if (!entry->uri || !entry->media_info_path || !entry->caps)
+    return FALSE;
+
+  flags = GUINT32_FROM_LE (record.flags);
+  entry->seekable = (flags & RECORD_FLAG_SEEKABLE) != 0;
+  entry->is_image = (flags & RECORD_FLAG_IS_IMAGE) != 0;
+  entry->passed = (flags & RECORD_FLAG_PASSED) != 0;
+  entry->duration = GUINT64_FROM_LE (record.duration);
+  entry->file_size = GUINT64_FROM_LE (record.file_size);
+  entry->media_info_mtime = GINT64_FROM_LE (record.media_info_mtime);
+
+  return TRUE;
+}
+
+/**
+ * gst_validate_media_info_db_lookup:
+ * @db: The #GstValidateMediaInfoDB
+ * @uri: The uri to look for
+ * @entry: (out): Return location for the entry of @uri
+ *
+ * Returns: %TRUE if @db has an entry for @uri
+ */
+gboolean
+gst_validate_media_info_db_lookup (GstValidateMediaInfoDB * db,
+    const gchar * uri, GstValidateMediaInfoDBEntry * entry)
+{
+  guint low = 0, high = db->n_records;
+
+  while (low < high) {
+    guint mid = low + (high - low) / 2;
+    MediaInfoDBRecord record;
+    const gchar *mid_uri;
+    gint cmp;
+
+    _read_record (db, mid, &record);
+    if (!(mid_uri = _get_string (db, record.uri)))
+      return FALSE;
+
+    cmp = strcmp (uri, mid_uri);
+    if (cmp == 0)
+      return gst_validate_media_info_db_get_entry (db, mid, entry);
+    else if (cmp < 0)
+      high = mid;
+    else
+      low = mid + 1;
+  }
+
+  return FALSE;
+}
@@ -0,0 +1,84 @@
+/* GStreamer
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * gst-validate-media-info-db.h - Database of the media info of a corpus
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_VALIDATE_MEDIA_INFO_DB_H__
+#define __GST_VALIDATE_MEDIA_INFO_DB_H__
+
+#include <gst/gst.h>
+
+#include "gst-validate-media-info.h"
+
+G_BEGIN_DECLS
+
+typedef struct _GstValidateMediaInfoDB GstValidateMediaInfoDB;
+typedef struct _GstValidateMediaInfoDBWriter GstValidateMediaInfoDBWriter;
+
+/**
+ * GstValidateMediaInfoDBEntry:
+ * @uri: The uri of the media
+ * @media_info_path: Path of the media info file the entry was made from
+ * @caps: The caps of the media, as a string
+ * @duration: The duration of the media
+ * @file_size: The size of the media file
+ * @seekable: Whether the media is seekable
+ * @is_image: Whether the media is an image
+ * @passed: Whether all the playback checks passed
+ * @media_info_mtime: Modification time of the media info file when the
+ * entry was made, in nanoseconds, to know whether the entry is still up to
+ * date
+ *
+ * The summary of a #GstValidateMediaInfo stored in a
+ * #GstValidateMediaInfoDB. The strings belong to the database.
+ */
+typedef struct
+{
+  const gchar *uri;
+  const gchar *media_info_path;
+  const gchar *caps;
+  GstClockTime duration;
+  guint64 file_size;
+  gboolean seekable;
+  gboolean is_image;
+  gboolean passed;
+  gint64 media_info_mtime;
+} GstValidateMediaInfoDBEntry;
+
+GstValidateMediaInfoDBWriter * gst_validate_media_info_db_writer_new (const gchar * path);
+void     gst_validate_media_info_db_writer_add   (GstValidateMediaInfoDBWriter * writer,
+                                                  GstValidateMediaInfo * mi,
+                                                  const gchar * media_info_path);
+gboolean gst_validate_media_info_db_writer_close (GstValidateMediaInfoDBWriter * writer,
+                                                  GError ** err);
+
+GstValidateMediaInfoDB * gst_validate_media_info_db_load (const gchar * path,
+                                                          GError ** err);
+void     gst_validate_media_info_db_free          (GstValidateMediaInfoDB * db);
+guint    gst_validate_media_info_db_get_n_entries (GstValidateMediaInfoDB * db);
+gboolean gst_validate_media_info_db_get_entry     (GstValidateMediaInfoDB * db,
+                                                   guint n,
+                                                   GstValidateMediaInfoDBEntry * entry);
+gboolean gst_validate_media_info_db_lookup        (GstValidateMediaInfoDB * db,
+                                                   const gchar * uri,
+                                                   GstValidateMediaInfoDBEntry * entry);
+
+G_END_DECLS
+
+#endif /* __GST_VALIDATE_MEDIA_INFO_DB_H__ */
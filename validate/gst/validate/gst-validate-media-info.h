@@ -29,6 +29,7 @@ G_BEGIN_DECLS
 
 typedef struct _GstValidateMediaInfo GstValidateMediaInfo;
 typedef struct _GstValidateStreamInfo GstValidateStreamInfo;
+typedef struct _GstValidateFrameFingerprints GstValidateFrameFingerprints;
 
 /**
  * GstValidateMediaInfo:
@@ -59,6 +60,28 @@ struct _GstValidateMediaInfo {
   gboolean discover_only;
 
   GstValidateStreamInfo *stream_info;
+
+  /* Number of positions the playback checks were run at, 0 when
+   * the whole file was played */
+  guint sample_count;
+  /* Duration played at each of those positions */
+  GstClockTime sample_window;
+
+  /* Hash of the file, the plugins, gst-validate and the checks run the
+   * results were produced with, NULL if it could not be computed or if
+   * the checks did not all pass */
+  gchar *fingerprint;
+
+  /* File names of the frame indexes of the streams, relative to the
+   * media info file, NULL if none were written */
+  gchar **frame_indexes;
+
+  /* Whether the frames decoded by the forward playback check should be
+   * fingerprinted, only done when the whole file is played */
+  gboolean fingerprint_frames;
+  /* Hash and perceptual signature of each decoded audio and video frame,
+   * saved next to the media info file, NULL if not computed */
+  GstValidateFrameFingerprints *frame_fingerprints;
 };
 
 void gst_validate_media_info_init (GstValidateMediaInfo * mi);
@@ -71,9 +94,20 @@ GstValidateMediaInfo * gst_validate_media_info_load (const gchar * path, GError
 
 gboolean gst_validate_media_info_inspect_uri (GstValidateMediaInfo * mi, const gchar * uri,
         gboolean discover_only, GError ** err);
+gboolean gst_validate_media_info_inspect_uri_full (GstValidateMediaInfo * mi, const gchar * uri,
+        GstDiscoverer * discoverer, gboolean discover_only, guint max_parallel_checks,
+        GError ** err);
+
+gboolean gst_validate_media_info_reuse_results (GstValidateMediaInfo * mi, const gchar * uri,
+        gboolean discover_only, const gchar * path);
+
+gboolean gst_validate_media_info_write_frame_indexes (GstValidateMediaInfo * mi,
+        const gchar * prefix, GError ** err);
 
 gboolean gst_validate_media_info_compare (GstValidateMediaInfo * expected, GstValidateMediaInfo * extracted);
 
+gchar * gst_validate_media_info_get_caps_string (GstValidateMediaInfo * mi);
+
 G_END_DECLS
 
 #endif /* __GST_VALIDATE_MEDIA_INFO_H__ */
@@ -0,0 +1,265 @@
+/* GStreamer
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * gst-validate-progress.c - Binary progress record for the launcher
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <errno.h>
+#include <string.h>
+#include <glib/gstdio.h>
+
+#ifdef G_OS_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#include "gst-validate-progress.h"
+#include "gst-validate-report.h"
+#include "gst-validate-internal.h"
+
+/* The tools write their progress to a file of a single fixed size record,
+ * mapped in memory, that the launcher polls instead of parsing the
+ * position lines of their output (see tools/launcher/progress.py, both
+ * have to be kept in sync).
+ *
+ * All the numbers are little endian. The record is protected by a sequence
+ * counter: it is odd while the record is being written, readers retry
+ * until they read the same even value before and after the record.
+ */
+#define PROGRESS_MAGIC "GVPR"
+#define PROGRESS_VERSION 1
+
+typedef struct
+{
+  gchar magic[4];
+  guint32 version;
+  volatile guint32 sequence;
+  /* GstState of the pipeline */
+  guint32 state;
+  /* In nanoseconds, -1 when unknown */
+  gint64 position;
+  gint64 duration;
+  /* Bits of the playback rate, a double */
+  guint64 rate;
+  /* 100 when not buffering */
+  gint32 buffering;
+  guint32 n_issues;
+  guint32 n_criticals;
+  guint32 reserved[3];
+} ProgressRecord;
+
+struct _GstValidateProgress
+{
+  GMutex lock;
+  ProgressRecord *record;
+  guint32 sequence;
+
+  GstValidateRunner *runner;
+  gulong report_added_id;
+  guint n_issues;
+  guint n_criticals;
+};
+
+#define PROGRESS_UPDATE_START(progress) G_STMT_START {                  \
+  g_mutex_lock (&progress->lock);                                       \
+  g_atomic_int_set ((volatile gint *) &progress->record->sequence,      \
+      GUINT32_TO_LE (++progress->sequence));                            \
+} G_STMT_END
+
+#define PROGRESS_UPDATE_END(progress) G_STMT_START {                    \
+  g_atomic_int_set ((volatile gint *) &progress->record->sequence,      \
+      GUINT32_TO_LE (++progress->sequence));                            \
+  g_mutex_unlock (&progress->lock);                                     \
+} G_STMT_END
+
+static guint64
+_rate_to_le (gdouble rate)
+{
+  union
+  {
+    gdouble d;
+    guint64 i;
+  } bits;
+
+  bits.d = rate;
+
+  return GUINT64_TO_LE (bits.i);
+}
+
+/**
+ * gst_validate_progress_new:
+ * @path: The file to write the progress record to
+ * @err: Location of the error, if any
+ *
+ * Creates @path, truncating it, and maps it so that the progress can be
+ * updated without any system call.
+ *
+ * Returns: The progress writer, or %NULL on error
+ */
+GstValidateProgress *
+gst_validate_progress_new (const gchar * path, GError ** err)
+{
+#ifdef G_OS_UNIX
+  gint fd;
+  ProgressRecord *record;
+  GstValidateProgress *progress;
+
+  fd = g_open (path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0 || ftruncate (fd, sizeof (ProgressRecord)) < 0) {
+    g_set_error (err, G_FILE_ERROR, g_file_error_from_errno (errno),
+        "Could not create %s: %s", path, g_strerror (errno));
+    if (fd >= 0)
+      close (fd);
+
+    return NULL;
+  }
+
+  record = mmap (NULL, sizeof (ProgressRecord), PROT_READ | PROT_WRITE,
+      MAP_SHARED, fd, 0);
+  close (fd);
+  if (record == MAP_FAILED) {
+    g_set_error (err, G_FILE_ERROR, g_file_error_from_errno (errno),
+        "Could not map %s: %s", path, g_strerror (errno));
+
+    return NULL;
+  }
+
+  progress = g_slice_new0 (GstValidateProgress);
+  g_mutex_init (&progress->lock);
+  progress->record = record;
+
+  PROGRESS_UPDATE_START (progress);
+  memcpy (record->magic, PROGRESS_MAGIC, 4);
+  record->version = GUINT32_TO_LE (PROGRESS_VERSION);
+  record->state = GUINT32_TO_LE (GST_STATE_NULL);
+  record->position = record->duration = GINT64_TO_LE (-1);
+  record->rate = _rate_to_le (1.0);
+  record->buffering = GINT32_TO_LE (100);
+  PROGRESS_UPDATE_END (progress);
+
+  return progress;
+#else
+  g_set_error (err, G_FILE_ERROR, G_FILE_ERROR_NOSYS,
+      "Progress files are not supported on this platform");
+
+  return NULL;
+#endif
+}
+
+/**
+ * gst_validate_progress_new_from_env:
+ *
+ * Returns: A progress writer for the file set in the
+ * GST_VALIDATE_PROGRESS_FILE environment variable, %NULL if it is not set
+ * or the file can not be written
+ */
+GstValidateProgress *
+gst_validate_progress_new_from_env (void)
+{
+  GError *err = NULL;
+  GstValidateProgress *progress;
+  const gchar *path = g_getenv ("GST_VALIDATE_PROGRESS_FILE");
+
+  if (path == NULL || *path == '\0')
+    return NULL;
+
+  progress = gst_validate_progress_new (path, &err);
+  if (progress == NULL) {
+    GST_WARNING ("Not writing the progress: %s", err->message);
+    g_error_free (err);
+  }
+
+  return progress;
+}
+
+void
+gst_validate_progress_free (GstValidateProgress * progress)
+{
+  if (progress->runner) {
+    g_signal_handler_disconnect (progress->runner, progress->report_added_id);
+    g_object_unref (progress->runner);
+  }
+
+#ifdef G_OS_UNIX
+  munmap (progress->record, sizeof (ProgressRecord));
+#endif
+  g_mutex_clear (&progress->lock);
+  g_slice_free (GstValidateProgress, progress);
+}
+
+/* Can be called from any thread */
+static void
+_report_added_cb (GstValidateRunner * runner, GstValidateReport * report,
+    GstValidateProgress * progress)
+{
+  PROGRESS_UPDATE_START (progress);
+  progress->record->n_issues = GUINT32_TO_LE (++progress->n_issues);
+  if (report->level == GST_VALIDATE_REPORT_LEVEL_CRITICAL)
+    progress->record->n_criticals = GUINT32_TO_LE (++progress->n_criticals);
+  PROGRESS_UPDATE_END (progress);
+}
+
+/**
+ * gst_validate_progress_set_runner:
+ * @progress: The progress writer
+ * @runner: The runner whose issues are counted in the progress record
+ */
+void
+gst_validate_progress_set_runner (GstValidateProgress * progress,
+    GstValidateRunner * runner)
+{
+  g_return_if_fail (progress->runner == NULL);
+
+  progress->runner = g_object_ref (runner);
+  progress->report_added_id = g_signal_connect (runner, "report-added",
+      G_CALLBACK (_report_added_cb), progress);
+}
+
+void
+gst_validate_progress_set_position (GstValidateProgress * progress,
+    gint64 position, gint64 duration, gdouble rate)
+{
+  PROGRESS_UPDATE_START (progress);
+  progress->record->position = GINT64_TO_LE (position);
+  progress->record->duration = GINT64_TO_LE (duration);
+  progress->record->rate = _rate_to_le (rate);
+  PROGRESS_UPDATE_END (progress);
+}
+
+void
+gst_validate_progress_set_state (GstValidateProgress * progress,
+    GstState state)
+{
+  PROGRESS_UPDATE_START (progress);
+  progress->record->state = GUINT32_TO_LE (state);
+  PROGRESS_UPDATE_END (progress);
+}
+
+void
+gst_validate_progress_set_buffering (GstValidateProgress * progress,
+    gint percent)
+{
+  PROGRESS_UPDATE_START (progress);
+  progress->record->buffering = GINT32_TO_LE (percent);
+  PROGRESS_UPDATE_END (progress);
+}
@@ -0,0 +1,50 @@
+/* GStreamer
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * gst-validate-progress.h - Binary progress record for the launcher
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_VALIDATE_PROGRESS_H__
+#define __GST_VALIDATE_PROGRESS_H__
+
+#include <gst/gst.h>
+
+#include <gst/validate/gst-validate-runner.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstValidateProgress GstValidateProgress;
+
+GstValidateProgress * gst_validate_progress_new          (const gchar * path,
+                                                          GError ** err);
+GstValidateProgress * gst_validate_progress_new_from_env (void);
+void gst_validate_progress_free          (GstValidateProgress * progress);
+void gst_validate_progress_set_runner    (GstValidateProgress * progress,
+                                          GstValidateRunner * runner);
+void gst_validate_progress_set_position  (GstValidateProgress * progress,
+                                          gint64 position,
+                                          gint64 duration,
+                                          gdouble rate);
+void gst_validate_progress_set_state     (GstValidateProgress * progress,
+                                          GstState state);
+void gst_validate_progress_set_buffering (GstValidateProgress * progress,
+                                          gint percent);
+
+G_END_DECLS
+
+#endif /* __GST_VALIDATE_PROGRESS_H__ */
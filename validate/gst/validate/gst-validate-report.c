@@ -168,11 +168,30 @@ gst_validate_report_load_issues (void)
       _("received an unexpected flush stop event"), NULL);
   REGISTER_VALIDATE_ISSUE (WARNING, EVENT_CAPS_DUPLICATE,
       _("received the same caps twice"), NULL);
+  REGISTER_VALIDATE_ISSUE (CRITICAL, EVENT_KEY_UNIT_LATENCY_OVER_BUDGET,
+      _("key units came too late after being requested"),
+      _("the running time between a force key unit event and the key frame "
+          "it caused went over the budget for the given percentile of the "
+          "requests"));
 
   REGISTER_VALIDATE_ISSUE (CRITICAL, EVENT_SEEK_NOT_HANDLED,
       _("seek event wasn't handled"), NULL);
   REGISTER_VALIDATE_ISSUE (CRITICAL, EVENT_SEEK_RESULT_POSITION_WRONG,
       _("position after a seek is wrong"), NULL);
+  REGISTER_VALIDATE_ISSUE (CRITICAL, EVENT_SEEK_LATENCY_OVER_BUDGET,
+      _("seek took longer than the scenario's max-seek-latency"),
+      _("the time between sending a seek and the pipeline prerolling again "
+          "went over the budget set in the scenario description"));
+  REGISTER_VALIDATE_ISSUE (CRITICAL, EVENT_SEEK_ACCURACY_OVER_BUDGET,
+      _("first buffer after a seek is too far from the requested position"),
+      _("the distance between the requested seek position and the stream "
+          "time of the first buffer reaching a sink went over the "
+          "max-seek-accuracy budget set in the scenario description"));
+  REGISTER_VALIDATE_ISSUE (CRITICAL, EVENT_SEEK_WRONG_FRAME,
+      _("first buffer after a seek is not the expected frame"),
+      _("the first buffer reaching a sink after a seek does not belong to "
+          "the frame the seek should land on according to the frame index "
+          "of the stream"));
 
   REGISTER_VALIDATE_ISSUE (CRITICAL, STATE_CHANGE_FAILURE,
       _("state change failed"), NULL);
@@ -195,12 +214,26 @@ gst_validate_report_load_issues (void)
       _("an error occured while starting playback of the test file"), NULL);
   REGISTER_VALIDATE_ISSUE (CRITICAL, FILE_PLAYBACK_ERROR,
       _("an error during playback of the file"), NULL);
+  REGISTER_VALIDATE_ISSUE (CRITICAL, FILE_KEY_FRAMES_INCORRECT,
+      _("resulting file streams don't start with a key frame"),
+      _("a stream of the resulting file can not be decoded from its start, "
+          "its first frame or all of them are delta units"));
 
   REGISTER_VALIDATE_ISSUE (CRITICAL, ALLOCATION_FAILURE,
       _("a memory allocation failed during Validate run"), NULL);
   REGISTER_VALIDATE_ISSUE (CRITICAL, MISSING_PLUGIN,
       _("a gstreamer plugin is missing and prevented Validate from running"),
       NULL);
+  REGISTER_VALIDATE_ISSUE (CRITICAL, MEMORY_GROWTH_OVER_BUDGET,
+      _("resident memory kept growing faster than allowed"),
+      _("the resident set size of the process grew faster than "
+          "GST_VALIDATE_MAX_MEMORY_GROWTH KiB per minute over the last "
+          "sampling window, which usually means something is leaking"));
+  REGISTER_VALIDATE_ISSUE (CRITICAL, REALTIME_FACTOR_UNDER_BUDGET,
+      _("a stream was encoded slower than the minimum realtime factor"),
+      _("the duration of the media encoded in a stream divided by the time "
+          "it took to encode it is lower than the minimum realtime factor "
+          "that was requested"));
   REGISTER_VALIDATE_ISSUE (WARNING, QUERY_POSITION_SUPERIOR_DURATION,
       _("Query position reported a value superior than what query duration "
           "returned"), NULL);
@@ -282,6 +315,8 @@ gst_validate_report_area_get_name (GstValidateReportArea area)
       return "file-check";
     case GST_VALIDATE_AREA_RUN_ERROR:
       return "run-error";
+    case GST_VALIDATE_AREA_RESOURCES:
+      return "resources";
     case GST_VALIDATE_AREA_OTHER:
       return "other";
     case GST_VALIDATE_AREA_SCENARIO:
@@ -60,6 +60,7 @@ typedef enum {
   GST_VALIDATE_AREA_FILE_CHECK,
   GST_VALIDATE_AREA_SCENARIO,
   GST_VALIDATE_AREA_RUN_ERROR,
+  GST_VALIDATE_AREA_RESOURCES,
   GST_VALIDATE_AREA_OTHER=100,
 } GstValidateReportArea;
 
@@ -88,9 +89,13 @@ typedef enum {
 #define GST_VALIDATE_ISSUE_ID_EVENT_FLUSH_START_UNEXPECTED          (((GstValidateIssueId) GST_VALIDATE_AREA_EVENT) << GST_VALIDATE_ISSUE_ID_SHIFT | 6)
 #define GST_VALIDATE_ISSUE_ID_EVENT_FLUSH_STOP_UNEXPECTED           (((GstValidateIssueId) GST_VALIDATE_AREA_EVENT) << GST_VALIDATE_ISSUE_ID_SHIFT | 7)
 #define GST_VALIDATE_ISSUE_ID_EVENT_CAPS_DUPLICATE                  (((GstValidateIssueId) GST_VALIDATE_AREA_EVENT) << GST_VALIDATE_ISSUE_ID_SHIFT | 8)
+#define GST_VALIDATE_ISSUE_ID_EVENT_KEY_UNIT_LATENCY_OVER_BUDGET     (((GstValidateIssueId) GST_VALIDATE_AREA_EVENT) << GST_VALIDATE_ISSUE_ID_SHIFT | 9)
 
 #define GST_VALIDATE_ISSUE_ID_EVENT_SEEK_NOT_HANDLED           (((GstValidateIssueId) GST_VALIDATE_AREA_SEEK) << GST_VALIDATE_ISSUE_ID_SHIFT | 1)
 #define GST_VALIDATE_ISSUE_ID_EVENT_SEEK_RESULT_POSITION_WRONG (((GstValidateIssueId) GST_VALIDATE_AREA_SEEK) << GST_VALIDATE_ISSUE_ID_SHIFT | 2)
+#define GST_VALIDATE_ISSUE_ID_EVENT_SEEK_LATENCY_OVER_BUDGET  (((GstValidateIssueId) GST_VALIDATE_AREA_SEEK) << GST_VALIDATE_ISSUE_ID_SHIFT | 3)
+#define GST_VALIDATE_ISSUE_ID_EVENT_SEEK_ACCURACY_OVER_BUDGET (((GstValidateIssueId) GST_VALIDATE_AREA_SEEK) << GST_VALIDATE_ISSUE_ID_SHIFT | 4)
+#define GST_VALIDATE_ISSUE_ID_EVENT_SEEK_WRONG_FRAME           (((GstValidateIssueId) GST_VALIDATE_AREA_SEEK) << GST_VALIDATE_ISSUE_ID_SHIFT | 5)
 
 #define GST_VALIDATE_ISSUE_ID_STATE_CHANGE_FAILURE (((GstValidateIssueId) GST_VALIDATE_AREA_STATE) << GST_VALIDATE_ISSUE_ID_SHIFT | 1)
 
@@ -103,10 +108,14 @@ typedef enum {
 #define GST_VALIDATE_ISSUE_ID_FILE_CHECK_FAILURE  (((GstValidateIssueId) GST_VALIDATE_AREA_FILE_CHECK) << GST_VALIDATE_ISSUE_ID_SHIFT | 7)
 #define GST_VALIDATE_ISSUE_ID_FILE_PLAYBACK_START_FAILURE (((GstValidateIssueId) GST_VALIDATE_AREA_FILE_CHECK) << GST_VALIDATE_ISSUE_ID_SHIFT | 8)
 #define GST_VALIDATE_ISSUE_ID_FILE_PLAYBACK_ERROR (((GstValidateIssueId) GST_VALIDATE_AREA_FILE_CHECK) << GST_VALIDATE_ISSUE_ID_SHIFT | 9)
+#define GST_VALIDATE_ISSUE_ID_FILE_KEY_FRAMES_INCORRECT (((GstValidateIssueId) GST_VALIDATE_AREA_FILE_CHECK) << GST_VALIDATE_ISSUE_ID_SHIFT | 10)
 
 #define GST_VALIDATE_ISSUE_ID_ALLOCATION_FAILURE (((GstValidateIssueId) GST_VALIDATE_AREA_RUN_ERROR) << GST_VALIDATE_ISSUE_ID_SHIFT | 1)
 #define GST_VALIDATE_ISSUE_ID_MISSING_PLUGIN     (((GstValidateIssueId) GST_VALIDATE_AREA_RUN_ERROR) << GST_VALIDATE_ISSUE_ID_SHIFT | 2)
 
+#define GST_VALIDATE_ISSUE_ID_MEMORY_GROWTH_OVER_BUDGET (((GstValidateIssueId) GST_VALIDATE_AREA_RESOURCES) << GST_VALIDATE_ISSUE_ID_SHIFT | 1)
+#define GST_VALIDATE_ISSUE_ID_REALTIME_FACTOR_UNDER_BUDGET (((GstValidateIssueId) GST_VALIDATE_AREA_RESOURCES) << GST_VALIDATE_ISSUE_ID_SHIFT | 2)
+
 #define GST_VALIDATE_ISSUE_ID_QUERY_POSITION_SUPERIOR_DURATION (((GstValidateIssueId) GST_VALIDATE_AREA_QUERY) << GST_VALIDATE_ISSUE_ID_SHIFT | 1)
 #define GST_VALIDATE_ISSUE_ID_QUERY_POSITION_OUT_OF_SEGMENT    (((GstValidateIssueId) GST_VALIDATE_AREA_QUERY) << GST_VALIDATE_ISSUE_ID_SHIFT | 2)
 
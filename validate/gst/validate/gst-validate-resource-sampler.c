@@ -0,0 +1,700 @@
+/* GStreamer
+ *
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * gst-validate-resource-sampler.c - Process resource usage sampler
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/**
+ * SECTION:gst-validate-resource-sampler
+ * @short_description: Samples the resource usage of a Validate run
+ *
+ * The sampler runs in its own thread and periodically records the
+ * resident memory, CPU time, number of open file descriptors and the
+ * CPU time of every thread of the process. Only the latest samples are
+ * kept, in a ring buffer, while the peak and mean figures are tracked
+ * for the whole run.
+ *
+ * It is disabled by default, and enabled and configured through the
+ * environment:
+ *
+ *  - GST_VALIDATE_SAMPLING_INTERVAL: the time between two samples, in
+ *    milliseconds (0 disables the sampler)
+ *  - GST_VALIDATE_MAX_MEMORY_GROWTH: the maximum resident memory growth,
+ *    in KiB per minute, tolerated over the last minute of the run. A
+ *    #GST_VALIDATE_ISSUE_ID_MEMORY_GROWTH_OVER_BUDGET issue is reported
+ *    when it is exceeded. Setting it enables the sampler, every 500
+ *    milliseconds if GST_VALIDATE_SAMPLING_INTERVAL is not set.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <string.h>
+#include <stdlib.h>
+
+#ifdef G_OS_UNIX
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#endif
+
+#include "gst-validate-internal.h"
+#include "gst-validate-reporter.h"
+#include "gst-validate-resource-sampler.h"
+
+#define GST_VALIDATE_RESOURCE_SAMPLER_GET_PRIVATE(o) \
+  (G_TYPE_INSTANCE_GET_PRIVATE ((o), GST_TYPE_VALIDATE_RESOURCE_SAMPLER, \
+                                GstValidateResourceSamplerPrivate))
+
+#define DEFAULT_SAMPLING_INTERVAL 500   /* ms */
+#define RING_SIZE 2048
+
+/* The memory growth is the slope of the resident memory over the last
+ * GROWTH_WINDOW of the run, ignoring the start up allocations */
+#define GROWTH_WARMUP (5 * G_USEC_PER_SEC)
+#define GROWTH_WINDOW (60 * G_USEC_PER_SEC)
+#define GROWTH_MIN_SPAN (30 * G_USEC_PER_SEC)
+
+#define N_BUSIEST_THREADS 5
+
+enum
+{
+  PROP_0,
+  PROP_RUNNER,
+  PROP_LAST
+};
+
+typedef struct
+{
+  gint64 timestamp;             /* monotonic time, in usec */
+  guint64 rss;                  /* in bytes */
+  guint64 cpu_time;             /* user + system, in usec */
+  guint n_fds;
+  guint n_threads;
+} Sample;
+
+typedef struct
+{
+  gchar *name;
+  guint64 cpu_time;             /* user + system, in usec */
+} ThreadUsage;
+
+struct _GstValidateResourceSamplerPrivate
+{
+  GMutex lock;
+  GCond cond;
+  GThread *thread;
+  gboolean running;
+
+  gint64 interval;              /* in usec */
+  gint64 max_growth;            /* in bytes per minute, 0 means no check */
+  gboolean growth_reported;
+
+  Sample *ring;
+  guint ring_pos;               /* where the next sample goes */
+  guint n_samples;              /* samples taken since the start */
+
+  gint64 start_time;
+  guint64 start_cpu_time;
+  guint64 rss_peak;
+  guint64 rss_sum;
+  gdouble cpu_peak;             /* in percent of one core */
+  guint fds_peak;
+  guint threads_peak;
+
+  /* thread id (string) -> ThreadUsage, threads that exited are kept */
+  GHashTable *threads;
+};
+
+G_DEFINE_TYPE_WITH_CODE (GstValidateResourceSampler,
+    gst_validate_resource_sampler, G_TYPE_OBJECT,
+    G_IMPLEMENT_INTERFACE (GST_TYPE_VALIDATE_REPORTER, NULL));
+
+static void
+_thread_usage_free (ThreadUsage * usage)
+{
+  g_free (usage->name);
+  g_slice_free (ThreadUsage, usage);
+}
+
+#ifdef linux
+static gboolean
+_read_proc_stat (const gchar * path, gchar ** name, guint64 * cpu_time)
+{
+  gchar *contents, *open, *close, **fields;
+  gboolean ret = FALSE;
+  static glong clk_tck = 0;
+
+  if (!g_file_get_contents (path, &contents, NULL, NULL))
+    return FALSE;
+
+  if (clk_tck <= 0)
+    clk_tck = sysconf (_SC_CLK_TCK);
+
+  /* The name is between parentheses and can itself contain spaces and
+   * parentheses, the fixed fields start after the last ')' */
+  open = strchr (contents, '(');
+  close = strrchr (contents, ')');
+  if (open && close && close > open && clk_tck > 0) {
+    fields = g_strsplit (close + 2, " ", -1);
+
+    /* fields[0] is the state (field 3 in proc(5)), utime and stime are
+     * fields 14 and 15 */
+    if (g_strv_length (fields) > 12) {
+      *cpu_time = (g_ascii_strtoull (fields[11], NULL, 10) +
+          g_ascii_strtoull (fields[12], NULL, 10)) * G_USEC_PER_SEC / clk_tck;
+      *name = g_strndup (open + 1, close - open - 1);
+      ret = TRUE;
+    }
+    g_strfreev (fields);
+  }
+  g_free (contents);
+
+  return ret;
+}
+
+static guint
+_count_dir_entries (const gchar * path)
+{
+  GDir *dir = g_dir_open (path, 0, NULL);
+  guint n = 0;
+
+  if (dir == NULL)
+    return 0;
+
+  while (g_dir_read_name (dir))
+    n++;
+  g_dir_close (dir);
+
+  return n;
+}
+#endif
+
+static guint64
+_get_resident_memory (void)
+{
+#ifdef linux
+  gchar *contents, **fields;
+  guint64 rss = 0;
+
+  if (!g_file_get_contents ("/proc/self/statm", &contents, NULL, NULL))
+    return 0;
+
+  fields = g_strsplit (contents, " ", -1);
+  if (g_strv_length (fields) > 1)
+    rss = g_ascii_strtoull (fields[1], NULL, 10) * sysconf (_SC_PAGESIZE);
+  g_strfreev (fields);
+  g_free (contents);
+
+  return rss;
+#elif defined (G_OS_UNIX)
+  struct rusage usage;
+
+  /* Only the peak is available here */
+  if (getrusage (RUSAGE_SELF, &usage) != 0)
+    return 0;
+
+  return (guint64) usage.ru_maxrss * 1024;
+#else
+  return 0;
+#endif
+}
+
+static guint64
+_get_cpu_time (void)
+{
+#ifdef G_OS_UNIX
+  struct rusage usage;
+
+  if (getrusage (RUSAGE_SELF, &usage) != 0)
+    return 0;
+
+  return (guint64) (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) *
+      G_USEC_PER_SEC + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+#else
+  return 0;
+#endif
+}
+
+/* Must be called with the lock taken */
+static guint
+_update_threads (GstValidateResourceSamplerPrivate * priv)
+{
+  guint n_threads = 0;
+#ifdef linux
+  const gchar *tid;
+  GDir *dir = g_dir_open ("/proc/self/task", 0, NULL);
+
+  if (dir == NULL)
+    return 0;
+
+  while ((tid = g_dir_read_name (dir))) {
+    gchar *path, *name;
+    guint64 cpu_time;
+    ThreadUsage *usage;
+
+    n_threads++;
+
+    path = g_build_filename ("/proc/self/task", tid, "stat", NULL);
+    if (_read_proc_stat (path, &name, &cpu_time)) {
+      usage = g_hash_table_lookup (priv->threads, tid);
+      if (usage == NULL) {
+        usage = g_slice_new0 (ThreadUsage);
+        g_hash_table_insert (priv->threads, g_strdup (tid), usage);
+      }
+
+      g_free (usage->name);
+      usage->name = name;
+      usage->cpu_time = cpu_time;
+    }
+    g_free (path);
+  }
+  g_dir_close (dir);
+#endif
+
+  return n_threads;
+}
+
+/* Least squares slope of the resident memory over the last GROWTH_WINDOW,
+ * in bytes per minute. Must be called with the lock taken */
+static gboolean
+_compute_memory_growth (GstValidateResourceSamplerPrivate * priv,
+    gdouble * growth)
+{
+  guint i, n = MIN (priv->n_samples, RING_SIZE), count = 0;
+  gdouble sx = 0, sy = 0, sxx = 0, sxy = 0, x, y, denom;
+  Sample *last, *first = NULL;
+
+  if (n < 3)
+    return FALSE;
+
+  last = &priv->ring[(priv->ring_pos + RING_SIZE - 1) % RING_SIZE];
+  for (i = 0; i < n; i++) {
+    Sample *s = &priv->ring[(priv->ring_pos + RING_SIZE - n + i) % RING_SIZE];
+
+    if (s->timestamp < priv->start_time + GROWTH_WARMUP ||
+        s->timestamp < last->timestamp - GROWTH_WINDOW)
+      continue;
+
+    if (first == NULL)
+      first = s;
+
+    x = (gdouble) (s->timestamp - first->timestamp) / (60 * G_USEC_PER_SEC);
+    y = (gdouble) s->rss - (gdouble) first->rss;
+    sx += x;
+    sy += y;
+    sxx += x * x;
+    sxy += x * y;
+    count++;
+  }
+
+  if (count < 3 || last->timestamp - first->timestamp < GROWTH_MIN_SPAN)
+    return FALSE;
+
+  denom = count * sxx - sx * sx;
+  if (denom <= 0)
+    return FALSE;
+
+  *growth = (count * sxy - sx * sy) / denom;
+
+  return TRUE;
+}
+
+/* Returns TRUE if the memory growth budget has just been exceeded, must be
+ * called with the lock taken */
+static gboolean
+_check_memory_growth (GstValidateResourceSamplerPrivate * priv,
+    gdouble * growth)
+{
+  if (priv->max_growth <= 0 || priv->growth_reported)
+    return FALSE;
+
+  if (!_compute_memory_growth (priv, growth) || *growth <= priv->max_growth)
+    return FALSE;
+
+  priv->growth_reported = TRUE;
+
+  return TRUE;
+}
+
+static void
+_report_memory_growth (GstValidateResourceSampler * sampler, gdouble growth)
+{
+  GST_VALIDATE_REPORT (sampler, MEMORY_GROWTH_OVER_BUDGET,
+      "Resident memory grew by %.0f KiB per minute (max %" G_GINT64_FORMAT
+      " KiB per minute)", growth / 1024, sampler->priv->max_growth / 1024);
+}
+
+static void
+_take_sample (GstValidateResourceSampler * sampler)
+{
+  Sample sample, *prev;
+  gdouble growth = 0;
+  gboolean report;
+  GstValidateResourceSamplerPrivate *priv = sampler->priv;
+
+  sample.timestamp = g_get_monotonic_time ();
+  sample.rss = _get_resident_memory ();
+  sample.cpu_time = _get_cpu_time ();
+#ifdef linux
+  /* Do not count the descriptor used to list the directory */
+  sample.n_fds = _count_dir_entries ("/proc/self/fd");
+  if (sample.n_fds > 0)
+    sample.n_fds--;
+#else
+  sample.n_fds = 0;
+#endif
+
+  g_mutex_lock (&priv->lock);
+  sample.n_threads = _update_threads (priv);
+
+  if (priv->n_samples > 0) {
+    prev = &priv->ring[(priv->ring_pos + RING_SIZE - 1) % RING_SIZE];
+
+    if (sample.timestamp > prev->timestamp)
+      priv->cpu_peak = MAX (priv->cpu_peak,
+          100.0 * (sample.cpu_time - prev->cpu_time) /
+          (sample.timestamp - prev->timestamp));
+  }
+
+  priv->ring[priv->ring_pos] = sample;
+  priv->ring_pos = (priv->ring_pos + 1) % RING_SIZE;
+  priv->n_samples++;
+
+  priv->rss_peak = MAX (priv->rss_peak, sample.rss);
+  priv->rss_sum += sample.rss;
+  priv->fds_peak = MAX (priv->fds_peak, sample.n_fds);
+  priv->threads_peak = MAX (priv->threads_peak, sample.n_threads);
+
+  report = _check_memory_growth (priv, &growth);
+  g_mutex_unlock (&priv->lock);
+
+  if (report)
+    _report_memory_growth (sampler, growth);
+}
+
+static gpointer
+_sampler_thread_func (GstValidateResourceSampler * sampler)
+{
+  gint64 end_time;
+  GstValidateResourceSamplerPrivate *priv = sampler->priv;
+
+  g_mutex_lock (&priv->lock);
+  while (priv->running) {
+    g_mutex_unlock (&priv->lock);
+    _take_sample (sampler);
+    g_mutex_lock (&priv->lock);
+
+    end_time = g_get_monotonic_time () + priv->interval;
+    while (priv->running && g_cond_wait_until (&priv->cond, &priv->lock,
+            end_time));
+  }
+  g_mutex_unlock (&priv->lock);
+
+  return NULL;
+}
+
+/**
+ * gst_validate_resource_sampler_start:
+ * @sampler: The #GstValidateResourceSampler to start
+ *
+ * Starts the sampling thread, does nothing if sampling has been disabled
+ * through GST_VALIDATE_SAMPLING_INTERVAL.
+ *
+ * Returns: %TRUE if the sampler is running
+ */
+gboolean
+gst_validate_resource_sampler_start (GstValidateResourceSampler * sampler)
+{
+  GstValidateResourceSamplerPrivate *priv = sampler->priv;
+
+  g_return_val_if_fail (GST_IS_VALIDATE_RESOURCE_SAMPLER (sampler), FALSE);
+
+  if (priv->interval <= 0)
+    return FALSE;
+
+  g_mutex_lock (&priv->lock);
+  if (priv->running) {
+    g_mutex_unlock (&priv->lock);
+    return TRUE;
+  }
+
+  priv->running = TRUE;
+  priv->growth_reported = FALSE;
+  priv->start_time = g_get_monotonic_time ();
+  priv->start_cpu_time = _get_cpu_time ();
+  g_mutex_unlock (&priv->lock);
+
+  priv->thread = g_thread_new ("validate-sampler",
+      (GThreadFunc) _sampler_thread_func, sampler);
+
+  return TRUE;
+}
+
+/**
+ * gst_validate_resource_sampler_stop:
+ * @sampler: The #GstValidateResourceSampler to stop
+ *
+ * Stops the sampling thread and checks the memory growth one last time.
+ */
+void
+gst_validate_resource_sampler_stop (GstValidateResourceSampler * sampler)
+{
+  gdouble growth = 0;
+  gboolean report;
+  GstValidateResourceSamplerPrivate *priv = sampler->priv;
+
+  g_return_if_fail (GST_IS_VALIDATE_RESOURCE_SAMPLER (sampler));
+
+  g_mutex_lock (&priv->lock);
+  if (!priv->running) {
+    g_mutex_unlock (&priv->lock);
+    return;
+  }
+  priv->running = FALSE;
+  g_cond_signal (&priv->cond);
+  g_mutex_unlock (&priv->lock);
+
+  g_thread_join (priv->thread);
+  priv->thread = NULL;
+
+  /* Make sure the end of the run is accounted for */
+  _take_sample (sampler);
+
+  g_mutex_lock (&priv->lock);
+  report = _check_memory_growth (priv, &growth);
+  g_mutex_unlock (&priv->lock);
+
+  if (report)
+    _report_memory_growth (sampler, growth);
+}
+
+static gint
+_compare_thread_usage (ThreadUsage ** a, ThreadUsage ** b)
+{
+  if ((*a)->cpu_time == (*b)->cpu_time)
+    return 0;
+
+  return (*a)->cpu_time > (*b)->cpu_time ? -1 : 1;
+}
+
+/**
+ * gst_validate_resource_sampler_print:
+ * @sampler: The #GstValidateResourceSampler to print the summary of
+ *
+ * Prints the peak and mean resource usage figures recorded so far.
+ */
+void
+gst_validate_resource_sampler_print (GstValidateResourceSampler * sampler)
+{
+  guint i;
+  gdouble growth, duration;
+  Sample *last;
+  GPtrArray *threads;
+  GHashTableIter iter;
+  gpointer usage;
+  GstValidateResourceSamplerPrivate *priv = sampler->priv;
+
+  g_return_if_fail (GST_IS_VALIDATE_RESOURCE_SAMPLER (sampler));
+
+  g_mutex_lock (&priv->lock);
+  if (priv->n_samples == 0) {
+    g_mutex_unlock (&priv->lock);
+    return;
+  }
+
+  last = &priv->ring[(priv->ring_pos + RING_SIZE - 1) % RING_SIZE];
+  duration = (gdouble) (last->timestamp - priv->start_time) / G_USEC_PER_SEC;
+
+  g_print ("\nResource usage over %.1f s (%u samples):\n", duration,
+      priv->n_samples);
+  g_print ("  resident memory: peak %.1f MiB, mean %.1f MiB",
+      priv->rss_peak / (1024.0 * 1024.0),
+      priv->rss_sum / (1024.0 * 1024.0) / priv->n_samples);
+  if (_compute_memory_growth (priv, &growth))
+    g_print (", growth %.0f KiB/min", growth / 1024);
+  g_print ("\n");
+
+  g_print ("  cpu: %.2f s", (gdouble) (last->cpu_time - priv->start_cpu_time) /
+      G_USEC_PER_SEC);
+  if (duration > 0)
+    g_print (", mean %.1f %%, peak %.1f %%",
+        100.0 * (last->cpu_time - priv->start_cpu_time) /
+        (last->timestamp - priv->start_time), priv->cpu_peak);
+  g_print ("\n");
+
+#ifdef linux
+  g_print ("  file descriptors: peak %u\n", priv->fds_peak);
+  g_print ("  threads: peak %u\n", priv->threads_peak);
+
+  threads = g_ptr_array_new ();
+  g_hash_table_iter_init (&iter, priv->threads);
+  while (g_hash_table_iter_next (&iter, NULL, &usage))
+    g_ptr_array_add (threads, usage);
+  g_ptr_array_sort (threads, (GCompareFunc) _compare_thread_usage);
+
+  if (threads->len)
+    g_print ("  busiest threads:\n");
+  for (i = 0; i < MIN (threads->len, N_BUSIEST_THREADS); i++) {
+    ThreadUsage *tusage = g_ptr_array_index (threads, i);
+
+    g_print ("    %-16s %.2f s\n", tusage->name,
+        (gdouble) tusage->cpu_time / G_USEC_PER_SEC);
+  }
+  g_ptr_array_unref (threads);
+#endif
+
+  g_mutex_unlock (&priv->lock);
+}
+
+static void
+gst_validate_resource_sampler_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  switch (prop_id) {
+    case PROP_RUNNER:
+      /* we assume the runner is valid as long as this sampler is,
+       * no ref taken */
+      gst_validate_reporter_set_runner (GST_VALIDATE_REPORTER (object),
+          g_value_get_object (value));
+      break;
+    default:
+      break;
+  }
+}
+
+static void
+gst_validate_resource_sampler_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  switch (prop_id) {
+    case PROP_RUNNER:
+      g_value_set_object (value,
+          gst_validate_reporter_get_runner (GST_VALIDATE_REPORTER (object)));
+      break;
+    default:
+      break;
+  }
+}
+
+static void
+gst_validate_resource_sampler_dispose (GObject * object)
+{
+  gst_validate_resource_sampler_stop (GST_VALIDATE_RESOURCE_SAMPLER (object));
+
+  G_OBJECT_CLASS (gst_validate_resource_sampler_parent_class)->dispose
+      (object);
+}
+
+static void
+gst_validate_resource_sampler_finalize (GObject * object)
+{
+  GstValidateResourceSamplerPrivate *priv =
+      GST_VALIDATE_RESOURCE_SAMPLER (object)->priv;
+
+  g_free (priv->ring);
+  g_hash_table_unref (priv->threads);
+  g_mutex_clear (&priv->lock);
+  g_cond_clear (&priv->cond);
+
+  G_OBJECT_CLASS (gst_validate_resource_sampler_parent_class)->finalize
+      (object);
+}
+
+static void
+gst_validate_resource_sampler_class_init (GstValidateResourceSamplerClass *
+    klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  g_type_class_add_private (klass, sizeof (GstValidateResourceSamplerPrivate));
+
+  object_class->dispose = gst_validate_resource_sampler_dispose;
+  object_class->finalize = gst_validate_resource_sampler_finalize;
+
+  object_class->get_property = gst_validate_resource_sampler_get_property;
+  object_class->set_property = gst_validate_resource_sampler_set_property;
+
+  g_object_class_install_property (object_class, PROP_RUNNER,
+      g_param_spec_object ("validate-runner", "VALIDATE Runner",
+          "The Validate runner to " "report errors to",
+          GST_TYPE_VALIDATE_RUNNER,
+          G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE));
+}
+
+static void
+gst_validate_resource_sampler_init (GstValidateResourceSampler * sampler)
+{
+  const gchar *var;
+  GstValidateResourceSamplerPrivate *priv = sampler->priv =
+      GST_VALIDATE_RESOURCE_SAMPLER_GET_PRIVATE (sampler);
+
+  g_mutex_init (&priv->lock);
+  g_cond_init (&priv->cond);
+
+  priv->ring = g_new0 (Sample, RING_SIZE);
+  priv->threads = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+      (GDestroyNotify) _thread_usage_free);
+
+  var = g_getenv ("GST_VALIDATE_SAMPLING_INTERVAL");
+  priv->interval = (var && *var ? g_ascii_strtoll (var, NULL, 10) :
+      DEFAULT_SAMPLING_INTERVAL) * 1000;
+
+  var = g_getenv ("GST_VALIDATE_MAX_MEMORY_GROWTH");
+  if (var && *var)
+    priv->max_growth = g_ascii_strtoll (var, NULL, 10) * 1024;
+}
+
+/**
+ * gst_validate_resource_sampler_is_enabled:
+ *
+ * Returns: %TRUE if the environment asks for the resource usage to be
+ * sampled
+ */
+gboolean
+gst_validate_resource_sampler_is_enabled (void)
+{
+  const gchar *interval = g_getenv ("GST_VALIDATE_SAMPLING_INTERVAL");
+  const gchar *max_growth = g_getenv ("GST_VALIDATE_MAX_MEMORY_GROWTH");
+
+  if (interval && *interval)
+    return g_ascii_strtoll (interval, NULL, 10) > 0;
+
+  return max_growth && *max_growth;
+}
+
+/**
+ * gst_validate_resource_sampler_new:
+ * @runner: The #GstValidateRunner to report issues to
+ *
+ * Returns: A new #GstValidateResourceSampler, not started yet
+ */
+GstValidateResourceSampler *
+gst_validate_resource_sampler_new (GstValidateRunner * runner)
+{
+  GstValidateResourceSampler *sampler =
+      g_object_new (GST_TYPE_VALIDATE_RESOURCE_SAMPLER, "validate-runner",
+      runner, NULL);
+
+  gst_validate_reporter_set_name (GST_VALIDATE_REPORTER (sampler),
+      g_strdup ("resource-sampler"));
+
+  return sampler;
+}
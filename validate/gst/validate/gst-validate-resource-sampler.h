@@ -0,0 +1,77 @@
+/* GStreamer
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * gst-validate-resource-sampler.h - Process resource usage sampler
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_VALIDATE_RESOURCE_SAMPLER_H__
+#define __GST_VALIDATE_RESOURCE_SAMPLER_H__
+
+#include <glib.h>
+#include <glib-object.h>
+
+#include <gst/validate/gst-validate-runner.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_VALIDATE_RESOURCE_SAMPLER            (gst_validate_resource_sampler_get_type ())
+#define GST_VALIDATE_RESOURCE_SAMPLER(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), GST_TYPE_VALIDATE_RESOURCE_SAMPLER, GstValidateResourceSampler))
+#define GST_VALIDATE_RESOURCE_SAMPLER_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), GST_TYPE_VALIDATE_RESOURCE_SAMPLER, GstValidateResourceSamplerClass))
+#define GST_IS_VALIDATE_RESOURCE_SAMPLER(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GST_TYPE_VALIDATE_RESOURCE_SAMPLER))
+#define GST_IS_VALIDATE_RESOURCE_SAMPLER_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), GST_TYPE_VALIDATE_RESOURCE_SAMPLER))
+#define GST_VALIDATE_RESOURCE_SAMPLER_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), GST_TYPE_VALIDATE_RESOURCE_SAMPLER, GstValidateResourceSamplerClass))
+
+typedef struct _GstValidateResourceSampler        GstValidateResourceSampler;
+typedef struct _GstValidateResourceSamplerClass   GstValidateResourceSamplerClass;
+typedef struct _GstValidateResourceSamplerPrivate GstValidateResourceSamplerPrivate;
+
+/**
+ * GstValidateResourceSampler:
+ *
+ * Samples the resource usage of the current process (resident memory, CPU
+ * time, per thread CPU time and open file descriptors) from a dedicated
+ * thread and keeps the latest samples in a ring buffer.
+ */
+struct _GstValidateResourceSampler
+{
+  GObject          object;
+
+  /*< private >*/
+  GstValidateResourceSamplerPrivate *priv;
+};
+
+/**
+ * GstValidateResourceSamplerClass:
+ * @parent_class: parent
+ */
+struct _GstValidateResourceSamplerClass
+{
+  GObjectClass     parent_class;
+};
+
+GType gst_validate_resource_sampler_get_type (void);
+
+gboolean                     gst_validate_resource_sampler_is_enabled (void);
+GstValidateResourceSampler * gst_validate_resource_sampler_new   (GstValidateRunner * runner);
+gboolean                     gst_validate_resource_sampler_start (GstValidateResourceSampler * sampler);
+void                         gst_validate_resource_sampler_stop  (GstValidateResourceSampler * sampler);
+void                         gst_validate_resource_sampler_print (GstValidateResourceSampler * sampler);
+
+G_END_DECLS
+
+#endif /* __GST_VALIDATE_RESOURCE_SAMPLER_H__ */
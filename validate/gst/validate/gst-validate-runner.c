@@ -30,6 +30,7 @@
 #include "gst-validate-monitor-factory.h"
 #include "gst-validate-override-registry.h"
 #include "gst-validate-runner.h"
+#include "gst-validate-resource-sampler.h"
 
 /**
  * SECTION:gst-validate-runner
@@ -51,17 +52,37 @@ enum
 
 static guint _signals[LAST_SIGNAL] = { 0 };
 
+/* The resource usage is process wide, only the first runner alive samples
+ * it, when enabled, so that running several pipelines in a process, each
+ * with its own runner, does not multiply the sampling threads */
+static gint _sampler_taken = FALSE;
+
 static void
 gst_validate_runner_dispose (GObject * object)
 {
   GstValidateRunner *runner = GST_VALIDATE_RUNNER_CAST (object);
 
+  if (runner->sampler) {
+    g_object_unref (runner->sampler);
+    runner->sampler = NULL;
+    g_atomic_int_set (&_sampler_taken, FALSE);
+  }
+
   g_slist_free_full (runner->reports,
       (GDestroyNotify) gst_validate_report_unref);
+  runner->reports = NULL;
 
   G_OBJECT_CLASS (parent_class)->dispose (object);
 }
 
+static void
+gst_validate_runner_finalize (GObject * object)
+{
+  g_mutex_clear (&GST_VALIDATE_RUNNER_CAST (object)->mutex);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
 static void
 gst_validate_runner_class_init (GstValidateRunnerClass * klass)
 {
@@ -70,6 +91,7 @@ gst_validate_runner_class_init (GstValidateRunnerClass * klass)
   gobject_class = G_OBJECT_CLASS (klass);
 
   gobject_class->dispose = gst_validate_runner_dispose;
+  gobject_class->finalize = gst_validate_runner_finalize;
 
   _signals[REPORT_ADDED_SIGNAL] =
       g_signal_new ("report-added", G_TYPE_FROM_CLASS (klass),
@@ -81,6 +103,13 @@ static void
 gst_validate_runner_init (GstValidateRunner * runner)
 {
   runner->setup = FALSE;
+  g_mutex_init (&runner->mutex);
+
+  if (gst_validate_resource_sampler_is_enabled () &&
+      g_atomic_int_compare_and_exchange (&_sampler_taken, FALSE, TRUE)) {
+    runner->sampler = gst_validate_resource_sampler_new (runner);
+    gst_validate_resource_sampler_start (runner->sampler);
+  }
 }
 
 /**
@@ -96,7 +125,9 @@ void
 gst_validate_runner_add_report (GstValidateRunner * runner,
     GstValidateReport * report)
 {
+  GST_VALIDATE_RUNNER_LOCK (runner);
   runner->reports = g_slist_prepend (runner->reports, report);
+  GST_VALIDATE_RUNNER_UNLOCK (runner);
 
   g_signal_emit (runner, _signals[REPORT_ADDED_SIGNAL], 0, report);
 }
@@ -104,15 +135,30 @@ gst_validate_runner_add_report (GstValidateRunner * runner,
 guint
 gst_validate_runner_get_reports_count (GstValidateRunner * runner)
 {
+  guint count;
+
   g_return_val_if_fail (runner != NULL, 0);
-  return g_slist_length (runner->reports);
+
+  GST_VALIDATE_RUNNER_LOCK (runner);
+  count = g_slist_length (runner->reports);
+  GST_VALIDATE_RUNNER_UNLOCK (runner);
+
+  return count;
 }
 
+/**
+ * gst_validate_runner_get_reports:
+ * @runner: A #GstValidateRunner
+ *
+ * The returned list is only safe to use once the pipelines reporting to
+ * @runner are not running anymore, otherwise use
+ * gst_validate_runner_get_reports_count() or the "report-added" signal.
+ *
+ * Returns: (transfer none) (element-type GstValidateReport): The reports
+ */
 GSList *
 gst_validate_runner_get_reports (GstValidateRunner * runner)
 {
-  /* TODO should we need locking or put in htte docs to always call this
-   * after pipeline ends? */
   return runner->reports;
 }
 
@@ -123,7 +169,14 @@ gst_validate_runner_printf (GstValidateRunner * runner)
   guint count = 0;
   int ret = 0;
 
-  for (tmp = gst_validate_runner_get_reports (runner); tmp; tmp = tmp->next) {
+  /* Stopping the sampler might add a last report */
+  if (runner->sampler) {
+    gst_validate_resource_sampler_stop (runner->sampler);
+    gst_validate_resource_sampler_print (runner->sampler);
+  }
+
+  GST_VALIDATE_RUNNER_LOCK (runner);
+  for (tmp = runner->reports; tmp; tmp = tmp->next) {
     GstValidateReport *report = tmp->data;
 
     gst_validate_report_printf (report);
@@ -134,6 +187,7 @@ gst_validate_runner_printf (GstValidateRunner * runner)
     }
     count++;
   }
+  GST_VALIDATE_RUNNER_UNLOCK (runner);
   g_print ("Pipeline finished, issues found: %u\n", count);
   return ret;
 }
@@ -41,6 +41,9 @@ G_BEGIN_DECLS
 #define GST_VALIDATE_RUNNER_CAST(obj)                 ((GstValidateRunner*)(obj))
 #define GST_VALIDATE_RUNNER_CLASS_CAST(klass)         ((GstValidateRunnerClass*)(klass))
 
+#define GST_VALIDATE_RUNNER_LOCK(r)   g_mutex_lock (&GST_VALIDATE_RUNNER_CAST(r)->mutex)
+#define GST_VALIDATE_RUNNER_UNLOCK(r) g_mutex_unlock (&GST_VALIDATE_RUNNER_CAST(r)->mutex)
+
 /* TODO hide this to be opaque? */
 /**
  * GstValidateRunner:
@@ -56,6 +59,10 @@ struct _GstValidateRunner {
 
   /*< private >*/
   GSList *reports;
+  struct _GstValidateResourceSampler *sampler;
+  /* Protects @reports, reports can come from any streaming thread and
+   * several pipelines can share a runner */
+  GMutex mutex;
 };
 
 /**
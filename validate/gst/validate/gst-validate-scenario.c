@@ -25,12 +25,7 @@
 #include "config.h"
 #endif
 
-#ifdef linux
 #include <glib/gstdio.h>
-#else
-#include <sys/time.h>
-#include <sys/resource.h>
-#endif
 
 #include <gst/gst.h>
 #include <gio/gio.h>
@@ -41,6 +36,10 @@
 #include "gst-validate-reporter.h"
 #include "gst-validate-report.h"
 #include "gst-validate-utils.h"
+#include "gst-validate-histogram-private.h"
+#include "gst-validate-stepped-clock.h"
+#include "gst-validate-media-info.h"
+#include "gst-validate-frame-index.h"
 
 #define GST_VALIDATE_SCENARIO_GET_PRIVATE(o) \
   (G_TYPE_INSTANCE_GET_PRIVATE ((o), GST_TYPE_VALIDATE_SCENARIO, GstValidateScenarioPrivate))
@@ -48,8 +47,48 @@
 #define GST_VALIDATE_SCENARIO_SUFFIX ".scenario"
 #define GST_VALIDATE_SCENARIO_DIRECTORY "validate-scenario"
 
+/* Compiled scenarios are cached in the user cache directory, next to the
+ * GStreamer registry. They are serialized GVariants of the following format:
+ *
+ *   (format version, scenario file mtime (in nanoseconds), scenario file size,
+ *    is-config,
+ *    [(action type, action name, playback_time, playback_time expression,
+ *      action structure string)])
+ *
+ * A playback_time of -1 means that it is either missing or an expression that
+ * has to be evaluated once the pipeline has prerolled. */
+#define GST_VALIDATE_SCENARIO_COMPILED_SUFFIX ".compiled"
+#define GST_VALIDATE_SCENARIO_COMPILED_VERSION 2
+#define GST_VALIDATE_SCENARIO_COMPILED_ACTIONS_FORMAT "a(ssdss)"
+#define GST_VALIDATE_SCENARIO_COMPILED_FORMAT \
+  "(uxxb" GST_VALIDATE_SCENARIO_COMPILED_ACTIONS_FORMAT ")"
+
+/* Each scenario directory gets an index in the same cache directory so that
+ * listing scenarios does not need to open every single scenario file:
+ *
+ *   (format version, directory mtime,
+ *    [(scenario name, scenario file mtime, scenario file size, is-config,
+ *      {description field: serialized value}, [(action type, action name)])])
+ *
+ * Only the entries of the scenario files that changed since the index was
+ * written are rebuilt, and the list of files is only read again when the
+ * directory itself changed. The mtimes are in nanoseconds, -1 when they were
+ * too recent to be trusted (see gst_validate_utils_mtime_is_recent()) so
+ * that they are checked again next time. */
+#define GST_VALIDATE_SCENARIO_INDEX_SUFFIX ".index"
+#define GST_VALIDATE_SCENARIO_INDEX_VERSION 2
+#define GST_VALIDATE_SCENARIO_INDEX_ENTRY_FORMAT "(sxxba{ss}a(ss))"
+#define GST_VALIDATE_SCENARIO_INDEX_FORMAT \
+  "(uxa" GST_VALIDATE_SCENARIO_INDEX_ENTRY_FORMAT ")"
+
 #define DEFAULT_SEEK_TOLERANCE (0.1 * GST_SECOND)       /* tolerance seek interval
                                                            TODO make it overridable  */
+
+#define POSITION_TICK_INTERVAL 50       /* ms */
+
+/* How long no new clock wait must have been scheduled before the stepped
+ * clock is advanced in accelerated mode, see _step_clock */
+#define ACCELERATED_SETTLE_TIME (2 * GST_MSECOND)
 enum
 {
   PROP_0,
@@ -65,6 +104,16 @@ static GRegex *clean_action_str;
 G_DEFINE_TYPE_WITH_CODE (GstValidateScenario, gst_validate_scenario,
     G_TYPE_OBJECT, G_IMPLEMENT_INTERFACE (GST_TYPE_VALIDATE_REPORTER, NULL));
 
+typedef struct _SeekStats SeekStats;
+
+typedef struct
+{
+  guint id;
+  GstClockTime deadline;
+  GstClockTime interval;
+  GSourceFunc func;
+} ScenarioTimeout;
+
 typedef struct _GstValidateActionType
 {
   GstValidateExecuteAction execute;
@@ -77,7 +126,8 @@ struct _GstValidateScenarioPrivate
 {
   GstValidateRunner *runner;
 
-  GList *actions;
+  /* Binary min-heap of the pending actions, see _actions_heap_push */
+  GPtrArray *actions;
   /*  List of action that need parsing when reaching ASYNC_DONE
    *  most probably to be able to query duration */
   GList *needs_parsing;
@@ -91,13 +141,81 @@ struct _GstValidateScenarioPrivate
   guint num_actions;
 
   guint get_pos_id;
+
+  SeekStats *seek_stats;
+
+  /* Values of the expression variables, queried at each position tick
+   * and invalidated once an action was executed, as it can seek or change
+   * the state, and when the pipeline changes state or completes a seek.
+   * They are queried again when needed, see _set_variable_func */
+  gboolean duration_cached;
+  gdouble duration;
+  gboolean position_cached;
+  gdouble position;
+
+  /* Accelerated mode, the pipeline runs on a stepped clock and the
+   * timeouts are measured on it, see _step_clock */
+  GstClock *clock;
+  guint step_id;
+  gint64 last_step;
+  /* ScenarioTimeout sorted by deadline */
+  GList *timeouts;
+  guint last_timeout_id;
+  /* The timeout being fired, NULL if it got removed meanwhile */
+  ScenarioTimeout *firing_timeout;
+};
+
+/* Seek latency and accuracy measurements. Shared between the scenario and
+ * the pad probes that look for the first buffer after a seek on each sink,
+ * which can outlive the scenario, hence the refcounting. */
+struct _SeekStats
+{
+  gint refcount;
+  GMutex lock;
+
+  /* NULL once the scenario has been disposed */
+  GstValidateScenario *scenario;
+
+  /* The seek being measured, @started until its ASYNC_DONE */
+  guint32 seqnum;
+  gboolean started;
+  GstClockTime sent_time;
+  GstClockTime target;
+  gdouble rate;
+  GstSeekFlags flags;
+
+  /* stream id -> GstValidateFrameIndex of the media being played, NULL if
+   * unknown, see _load_frame_indexes */
+  GHashTable *frame_indexes;
+
+  /* Budgets, GST_CLOCK_TIME_NONE meaning no budget */
+  GstClockTime max_latency;
+  GstClockTime max_accuracy;
+
+  /* send_event -> ASYNC_DONE */
+  GstValidateHistogram *latency;
+  /* sink name -> SinkSeekStats */
+  GHashTable *sinks;
+  gboolean printed;
 };
 
-typedef struct KeyFileGroupName
+typedef struct
 {
-  GKeyFile *kf;
-  gchar *group_name;
-} KeyFileGroupName;
+  /* send_event -> first buffer */
+  GstValidateHistogram *first_buffer;
+  /* |requested position - first buffer stream time| */
+  GstValidateHistogram *accuracy;
+} SinkSeekStats;
+
+typedef struct
+{
+  SeekStats *stats;
+  gchar *sink_name;
+  guint32 seqnum;
+  gboolean flushed;
+  gboolean has_segment;
+  GstSegment segment;
+} SeekProbe;
 
 GType _gst_validate_action_type;
 static GType gst_validate_action_get_type (void);
@@ -110,13 +228,15 @@ _action_copy (GstValidateAction * act)
 {
   GstValidateAction *copy = gst_validate_action_new ();
 
+  copy->type = act->type;
+  copy->name = act->name;
   if (act->structure) {
     copy->structure = gst_structure_copy (act->structure);
-    copy->type = gst_structure_get_name (copy->structure);
-    if (!(act->name = gst_structure_get_string (copy->structure, "name")))
-      act->name = "";
+    if (!(copy->name = gst_structure_get_string (copy->structure, "name")))
+      copy->name = "";
   }
 
+  copy->structure_string = g_strdup (act->structure_string);
   copy->action_number = act->action_number;
   copy->playback_time = act->playback_time;
 
@@ -128,6 +248,9 @@ _action_free (GstValidateAction * action)
 {
   if (action->structure)
     gst_structure_free (action->structure);
+  g_free (action->structure_string);
+  if (action->expressions)
+    g_hash_table_unref (action->expressions);
 }
 
 static void
@@ -149,6 +272,28 @@ gst_validate_action_new (void)
   return action;
 }
 
+/* Actions coming from a compiled scenario only get their structure parsed
+ * right before they are needed */
+static gboolean
+_action_ensure_structure (GstValidateAction * action)
+{
+  if (action->structure)
+    return TRUE;
+
+  action->structure = gst_structure_from_string (action->structure_string,
+      NULL);
+  if (action->structure == NULL) {
+    GST_ERROR ("Could not parse action %s", action->structure_string);
+
+    return FALSE;
+  }
+
+  if (!(action->name = gst_structure_get_string (action->structure, "name")))
+    action->name = "";
+
+  return TRUE;
+}
+
 static void
 gst_validate_action_print (GstValidateAction * action, const gchar * format,
     ...)
@@ -171,31 +316,59 @@ gst_validate_action_print (GstValidateAction * action, const gchar * format,
   g_string_free (string, TRUE);
 }
 
+static void
+_cache_duration (GstValidateScenario * scenario, gint64 duration)
+{
+  scenario->priv->duration = ((double) (duration / GST_SECOND));
+  scenario->priv->duration_cached = TRUE;
+}
+
+static void
+_cache_position (GstValidateScenario * scenario, gint64 position)
+{
+  scenario->priv->position = ((double) position / GST_SECOND);
+  scenario->priv->position_cached = TRUE;
+}
+
+static void
+_invalidate_variables (GstValidateScenario * scenario)
+{
+  scenario->priv->duration_cached = FALSE;
+  scenario->priv->position_cached = FALSE;
+}
+
 static gboolean
 _set_variable_func (const gchar * name, double *value, gpointer user_data)
 {
   GstValidateScenario *scenario = GST_VALIDATE_SCENARIO (user_data);
+  GstValidateScenarioPrivate *priv = scenario->priv;
 
   if (!g_strcmp0 (name, "duration")) {
     gint64 duration;
 
-    if (!gst_element_query_duration (scenario->pipeline,
-            GST_FORMAT_TIME, &duration)) {
-      GST_WARNING_OBJECT (scenario, "Could not query duration");
-      return FALSE;
+    if (!priv->duration_cached) {
+      if (!gst_element_query_duration (scenario->pipeline,
+              GST_FORMAT_TIME, &duration)) {
+        GST_WARNING_OBJECT (scenario, "Could not query duration");
+        return FALSE;
+      }
+      _cache_duration (scenario, duration);
     }
-    *value = ((double) (duration / GST_SECOND));
+    *value = priv->duration;
 
     return TRUE;
   } else if (!g_strcmp0 (name, "position")) {
     gint64 position;
 
-    if (!gst_element_query_position (scenario->pipeline,
-            GST_FORMAT_TIME, &position)) {
-      GST_WARNING_OBJECT (scenario, "Could not query position");
-      return FALSE;
+    if (!priv->position_cached) {
+      if (!gst_element_query_position (scenario->pipeline,
+              GST_FORMAT_TIME, &position)) {
+        GST_WARNING_OBJECT (scenario, "Could not query position");
+        return FALSE;
+      }
+      _cache_position (scenario, position);
     }
-    *value = ((double) position / GST_SECOND);
+    *value = priv->position;
 
     return TRUE;
   }
@@ -203,6 +376,48 @@ _set_variable_func (const gchar * name, double *value, gpointer user_data)
   return FALSE;
 }
 
+/* The expressions of an action are compiled the first time they are
+ * evaluated and kept around, repeated actions and expressions evaluated
+ * once prerolled then do not need to be parsed again */
+static gboolean
+_action_evaluate_expression (GstValidateScenario * scenario,
+    GstValidateAction * action, const gchar * name, const gchar * strval,
+    gdouble * val)
+{
+  gchar *error = NULL;
+  GstValidateExpression *expression = NULL;
+
+  if (action->expressions)
+    expression = g_hash_table_lookup (action->expressions, name);
+  else
+    action->expressions = g_hash_table_new_full (g_str_hash, g_str_equal,
+        g_free, (GDestroyNotify) gst_validate_expression_free);
+
+  if (expression == NULL) {
+    expression = gst_validate_expression_compile (strval, &error);
+
+    if (expression == NULL) {
+      GST_WARNING ("Error while parsing %s: %s", strval, error);
+      g_free (error);
+
+      return FALSE;
+    }
+
+    g_hash_table_insert (action->expressions, g_strdup (name), expression);
+  }
+
+  *val = gst_validate_expression_evaluate (expression, _set_variable_func,
+      scenario, &error);
+  if (error) {
+    GST_WARNING ("Error while evaluating %s: %s", strval, error);
+    g_free (error);
+
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
 gboolean
 gst_validate_action_get_clocktime (GstValidateScenario * scenario,
     GstValidateAction * action, const gchar * name, GstClockTime * retval)
@@ -211,22 +426,13 @@ gst_validate_action_get_clocktime (GstValidateScenario * scenario,
   const gchar *strval;
 
   if (!gst_structure_get_double (action->structure, name, &val)) {
-    gchar *error = NULL;
-
     if (!(strval = gst_structure_get_string (action->structure, name))) {
       GST_WARNING_OBJECT (scenario, "Could not find %s", name);
       return FALSE;
     }
-    val =
-        gst_validate_utils_parse_expression (strval, _set_variable_func,
-        scenario, &error);
-
-    if (error) {
-      GST_WARNING ("Error while parsing %s: %s", strval, error);
-      g_free (error);
 
+    if (!_action_evaluate_expression (scenario, action, name, strval, &val))
       return FALSE;
-    }
   }
 
   if (val == -1.0)
@@ -237,6 +443,412 @@ gst_validate_action_get_clocktime (GstValidateScenario * scenario,
   return TRUE;
 }
 
+static void
+_sink_seek_stats_free (SinkSeekStats * sink_stats)
+{
+  gst_validate_histogram_free (sink_stats->first_buffer);
+  gst_validate_histogram_free (sink_stats->accuracy);
+  g_slice_free (SinkSeekStats, sink_stats);
+}
+
+/* The frame indexes written by gst-validate-media-check --frame-index
+ * for the media being played, found from its media info file set in
+ * GST_VALIDATE_MEDIA_INFO */
+static GHashTable *
+_load_frame_indexes (void)
+{
+  guint i;
+  gchar *dir;
+  GError *err = NULL;
+  GHashTable *indexes = NULL;
+  GstValidateMediaInfo *mi;
+  const gchar *path = g_getenv ("GST_VALIDATE_MEDIA_INFO");
+
+  if (path == NULL)
+    return NULL;
+
+  mi = gst_validate_media_info_load (path, &err);
+  if (err) {
+    GST_WARNING ("Could not load media info %s: %s", path, err->message);
+    g_clear_error (&err);
+    if (mi)
+      gst_validate_media_info_free (mi);
+
+    return NULL;
+  }
+
+  if (mi->frame_indexes == NULL) {
+    gst_validate_media_info_free (mi);
+
+    return NULL;
+  }
+
+  /* The keys belong to the indexes */
+  indexes = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+      (GDestroyNotify) gst_validate_frame_index_free);
+  dir = g_path_get_dirname (path);
+  for (i = 0; mi->frame_indexes[i]; i++) {
+    gchar *index_path = g_build_filename (dir, mi->frame_indexes[i], NULL);
+    GstValidateFrameIndex *index =
+        gst_validate_frame_index_load (index_path, &err);
+
+    if (index) {
+      g_hash_table_replace (indexes,
+          (gpointer) gst_validate_frame_index_get_stream_id (index), index);
+    } else {
+      GST_WARNING ("Could not load frame index %s: %s", index_path,
+          err->message);
+      g_clear_error (&err);
+    }
+    g_free (index_path);
+  }
+  g_free (dir);
+  gst_validate_media_info_free (mi);
+
+  return indexes;
+}
+
+static SeekStats *
+_seek_stats_new (GstValidateScenario * scenario)
+{
+  SeekStats *stats = g_slice_new0 (SeekStats);
+
+  stats->refcount = 1;
+  g_mutex_init (&stats->lock);
+  stats->scenario = scenario;
+  stats->max_latency = GST_CLOCK_TIME_NONE;
+  stats->max_accuracy = GST_CLOCK_TIME_NONE;
+  stats->latency = gst_validate_histogram_new ();
+  stats->sinks = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+      (GDestroyNotify) _sink_seek_stats_free);
+  stats->frame_indexes = _load_frame_indexes ();
+
+  return stats;
+}
+
+static SeekStats *
+_seek_stats_ref (SeekStats * stats)
+{
+  g_atomic_int_inc (&stats->refcount);
+
+  return stats;
+}
+
+static void
+_seek_stats_unref (SeekStats * stats)
+{
+  if (!g_atomic_int_dec_and_test (&stats->refcount))
+    return;
+
+  gst_validate_histogram_free (stats->latency);
+  g_hash_table_unref (stats->sinks);
+  if (stats->frame_indexes)
+    g_hash_table_unref (stats->frame_indexes);
+  g_mutex_clear (&stats->lock);
+  g_slice_free (SeekStats, stats);
+}
+
+/* Must be called with the stats lock */
+static SinkSeekStats *
+_seek_stats_get_sink (SeekStats * stats, const gchar * sink_name)
+{
+  SinkSeekStats *sink_stats = g_hash_table_lookup (stats->sinks, sink_name);
+
+  if (sink_stats == NULL) {
+    sink_stats = g_slice_new0 (SinkSeekStats);
+    sink_stats->first_buffer = gst_validate_histogram_new ();
+    sink_stats->accuracy = gst_validate_histogram_new ();
+    g_hash_table_insert (stats->sinks, g_strdup (sink_name), sink_stats);
+  }
+
+  return sink_stats;
+}
+
+static void
+_seek_probe_free (SeekProbe * probe)
+{
+  _seek_stats_unref (probe->stats);
+  g_free (probe->sink_name);
+  g_slice_free (SeekProbe, probe);
+}
+
+/* Checks that the first buffer after a forward seek belongs to the frame
+ * the seek should land on, must be called with the stats lock */
+static gboolean
+_seek_stats_check_frame (SeekStats * stats, GstPad * pad, GstBuffer * buffer,
+    GstValidateFrame * expected)
+{
+  gchar *stream_id;
+  GstClockTime end;
+  GstValidateFrameIndex *index = NULL;
+  gboolean keyframe = (stats->flags & GST_SEEK_FLAG_KEY_UNIT) &&
+      !(stats->flags & GST_SEEK_FLAG_ACCURATE);
+
+  if (stats->frame_indexes == NULL || stats->rate < 0 ||
+      !GST_CLOCK_TIME_IS_VALID (stats->target) ||
+      !GST_BUFFER_PTS_IS_VALID (buffer) ||
+      (keyframe && (stats->flags & GST_SEEK_FLAG_SNAP_AFTER)))
+    return TRUE;
+
+  if ((stream_id = gst_pad_get_stream_id (pad))) {
+    index = g_hash_table_lookup (stats->frame_indexes, stream_id);
+    g_free (stream_id);
+  }
+
+  if (index == NULL || !gst_validate_frame_index_find_frame (index,
+          stats->target, keyframe, expected))
+    return TRUE;
+
+  /* Decoders clip the first frame to the segment after accurate seeks */
+  end = expected->pts;
+  if (GST_CLOCK_TIME_IS_VALID (expected->duration))
+    end += expected->duration;
+
+  return GST_BUFFER_PTS (buffer) >= expected->pts &&
+      GST_BUFFER_PTS (buffer) <= end;
+}
+
+static GstPadProbeReturn
+_seek_probe_cb (GstPad * pad, GstPadProbeInfo * info, SeekProbe * probe)
+{
+  GstBuffer *buffer;
+  GstValidateFrame expected;
+  gboolean wrong_frame;
+  SinkSeekStats *sink_stats;
+  SeekStats *stats = probe->stats;
+  GstValidateScenario *scenario = NULL;
+  GstClockTime latency, accuracy = GST_CLOCK_TIME_NONE, max_accuracy;
+
+  g_mutex_lock (&stats->lock);
+  /* The scenario is gone or a newer seek is being measured */
+  if (stats->scenario == NULL || stats->seqnum != probe->seqnum) {
+    g_mutex_unlock (&stats->lock);
+
+    return GST_PAD_PROBE_REMOVE;
+  }
+
+  if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM) {
+    GstEvent *event = GST_PAD_PROBE_INFO_EVENT (info);
+
+    if (GST_EVENT_TYPE (event) == GST_EVENT_FLUSH_STOP) {
+      probe->flushed = TRUE;
+    } else if (GST_EVENT_TYPE (event) == GST_EVENT_SEGMENT &&
+        (probe->flushed || GST_EVENT_SEQNUM (event) == probe->seqnum)) {
+      gst_event_copy_segment (event, &probe->segment);
+      probe->has_segment = TRUE;
+    }
+    g_mutex_unlock (&stats->lock);
+
+    return GST_PAD_PROBE_OK;
+  }
+
+  /* Buffers still flowing from before the seek */
+  if (!probe->has_segment) {
+    g_mutex_unlock (&stats->lock);
+
+    return GST_PAD_PROBE_OK;
+  }
+
+  buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+  latency = gst_util_get_timestamp () - stats->sent_time;
+  sink_stats = _seek_stats_get_sink (stats, probe->sink_name);
+  gst_validate_histogram_add (sink_stats->first_buffer, latency);
+
+  if (GST_CLOCK_TIME_IS_VALID (stats->target) &&
+      GST_BUFFER_PTS_IS_VALID (buffer) &&
+      probe->segment.format == GST_FORMAT_TIME) {
+    gint64 stream_time = (gint64) probe->segment.time +
+        (gint64) GST_BUFFER_PTS (buffer) - (gint64) probe->segment.start;
+
+    accuracy = ABS (stream_time - (gint64) stats->target);
+    gst_validate_histogram_add (sink_stats->accuracy, accuracy);
+  }
+
+  wrong_frame = !_seek_stats_check_frame (stats, pad, buffer, &expected);
+
+  max_accuracy = stats->max_accuracy;
+  if ((GST_CLOCK_TIME_IS_VALID (accuracy) &&
+          GST_CLOCK_TIME_IS_VALID (max_accuracy) &&
+          accuracy > max_accuracy) || wrong_frame)
+    scenario = g_object_ref (stats->scenario);
+  g_mutex_unlock (&stats->lock);
+
+  GST_DEBUG_OBJECT (pad, "First buffer after seek %u after %" GST_TIME_FORMAT
+      ", %" GST_TIME_FORMAT " away from the requested position", probe->seqnum,
+      GST_TIME_ARGS (latency), GST_TIME_ARGS (accuracy));
+
+  if (wrong_frame) {
+    GST_VALIDATE_REPORT (scenario, EVENT_SEEK_WRONG_FRAME,
+        "First buffer on %s after seek has pts %" GST_TIME_FORMAT
+        ", expected the %sframe at %" GST_TIME_FORMAT " (dts %"
+        GST_TIME_FORMAT ", offset %" G_GUINT64_FORMAT ")", probe->sink_name,
+        GST_TIME_ARGS (GST_BUFFER_PTS (buffer)),
+        expected.keyframe ? "key" : "", GST_TIME_ARGS (expected.pts),
+        GST_TIME_ARGS (expected.dts), expected.offset);
+  }
+
+  if (scenario && GST_CLOCK_TIME_IS_VALID (accuracy) &&
+      GST_CLOCK_TIME_IS_VALID (max_accuracy) && accuracy > max_accuracy) {
+    GST_VALIDATE_REPORT (scenario, EVENT_SEEK_ACCURACY_OVER_BUDGET,
+        "First buffer on %s after seek is %" GST_TIME_FORMAT
+        " away from the requested position, budget is %" GST_TIME_FORMAT,
+        probe->sink_name, GST_TIME_ARGS (accuracy),
+        GST_TIME_ARGS (max_accuracy));
+  }
+
+  if (scenario)
+    g_object_unref (scenario);
+
+  return GST_PAD_PROBE_REMOVE;
+}
+
+static gboolean
+_is_leaf_sink (GValue * velement, gpointer udata)
+{
+  GstElement *element = g_value_get_object (velement);
+
+  if (GST_OBJECT_FLAG_IS_SET (element, GST_ELEMENT_FLAG_SINK) &&
+      !GST_IS_BIN (element))
+    return 0;
+
+  return !0;
+}
+
+static void
+_seek_stats_add_sink_probe (const GValue * velement, SeekStats * stats)
+{
+  SeekProbe *probe;
+  GstElement *sink = g_value_get_object (velement);
+  GstPad *pad = gst_element_get_static_pad (sink, "sink");
+
+  if (pad == NULL)
+    return;
+
+  probe = g_slice_new0 (SeekProbe);
+  probe->stats = _seek_stats_ref (stats);
+  probe->sink_name = gst_object_get_name (GST_OBJECT (sink));
+  probe->seqnum = stats->seqnum;
+  gst_segment_init (&probe->segment, GST_FORMAT_UNDEFINED);
+
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER |
+      GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM |
+#if GST_CHECK_VERSION (1, 2, 0)
+      GST_PAD_PROBE_TYPE_EVENT_FLUSH |
+#endif
+      0, (GstPadProbeCallback) _seek_probe_cb, probe,
+      (GDestroyNotify) _seek_probe_free);
+  gst_object_unref (pad);
+}
+
+/* Starts measuring @seek, called right before it is sent */
+static void
+_seek_stats_start (SeekStats * stats, GstElement * pipeline, GstEvent * seek,
+    GstClockTime target)
+{
+  GstIterator *sinks;
+
+  g_mutex_lock (&stats->lock);
+  stats->seqnum = GST_EVENT_SEQNUM (seek);
+  stats->target = target;
+  gst_event_parse_seek (seek, &stats->rate, NULL, &stats->flags, NULL, NULL,
+      NULL, NULL);
+  g_mutex_unlock (&stats->lock);
+
+  if (!GST_IS_BIN (pipeline))
+    goto done;
+
+  sinks = gst_iterator_filter (gst_bin_iterate_recurse (GST_BIN (pipeline)),
+      (GCompareFunc) _is_leaf_sink, NULL);
+  gst_iterator_foreach (sinks,
+      (GstIteratorForeachFunction) _seek_stats_add_sink_probe, stats);
+  gst_iterator_free (sinks);
+
+done:
+  g_mutex_lock (&stats->lock);
+  stats->sent_time = gst_util_get_timestamp ();
+  stats->started = TRUE;
+  g_mutex_unlock (&stats->lock);
+}
+
+/* The seek could not be sent, do not wait for its first buffers */
+static void
+_seek_stats_cancel (SeekStats * stats)
+{
+  g_mutex_lock (&stats->lock);
+  stats->seqnum = 0;
+  stats->started = FALSE;
+  g_mutex_unlock (&stats->lock);
+}
+
+static void
+_seek_stats_async_done (SeekStats * stats)
+{
+  GstValidateScenario *scenario;
+  GstClockTime latency, max_latency;
+
+  g_mutex_lock (&stats->lock);
+  /* Seeks that were not measured, like non TIME ones */
+  if (!stats->started) {
+    g_mutex_unlock (&stats->lock);
+
+    return;
+  }
+
+  stats->started = FALSE;
+  scenario = stats->scenario;
+  latency = gst_util_get_timestamp () - stats->sent_time;
+  gst_validate_histogram_add (stats->latency, latency);
+  max_latency = stats->max_latency;
+  g_mutex_unlock (&stats->lock);
+
+  GST_DEBUG_OBJECT (scenario, "Seek done after %" GST_TIME_FORMAT,
+      GST_TIME_ARGS (latency));
+
+  if (GST_CLOCK_TIME_IS_VALID (max_latency) && latency > max_latency) {
+    GST_VALIDATE_REPORT (scenario, EVENT_SEEK_LATENCY_OVER_BUDGET,
+        "Seek took %" GST_TIME_FORMAT " to complete, budget is %"
+        GST_TIME_FORMAT, GST_TIME_ARGS (latency), GST_TIME_ARGS (max_latency));
+  }
+}
+
+static void
+_seek_stats_print (SeekStats * stats, const gchar * scenario_name)
+{
+  gchar *str;
+  GHashTableIter iter;
+  const gchar *sink_name;
+  SinkSeekStats *sink_stats;
+
+  g_mutex_lock (&stats->lock);
+  if (stats->printed || gst_validate_histogram_get_count (stats->latency) == 0) {
+    g_mutex_unlock (&stats->lock);
+
+    return;
+  }
+  stats->printed = TRUE;
+
+  g_print ("\n==== Seek statistics for scenario %s ====\n", scenario_name);
+
+  str = gst_validate_histogram_to_string (stats->latency);
+  g_print ("  Seek latency (seek sent -> ASYNC_DONE):\n    %s\n", str);
+  g_free (str);
+
+  g_hash_table_iter_init (&iter, stats->sinks);
+  while (g_hash_table_iter_next (&iter, (gpointer *) & sink_name,
+          (gpointer *) & sink_stats)) {
+    str = gst_validate_histogram_to_string (sink_stats->first_buffer);
+    g_print ("  %s: first buffer latency (seek sent -> first buffer):\n"
+        "    %s\n", sink_name, str);
+    g_free (str);
+
+    str = gst_validate_histogram_to_string (sink_stats->accuracy);
+    g_print ("  %s: accuracy (requested position -> first buffer):\n"
+        "    %s\n", sink_name, str);
+    g_free (str);
+  }
+  g_mutex_unlock (&stats->lock);
+}
+
 static gboolean
 _execute_seek (GstValidateScenario * scenario, GstValidateAction * action)
 {
@@ -282,10 +894,17 @@ _execute_seek (GstValidateScenario * scenario, GstValidateAction * action)
   seek = gst_event_new_seek (rate, format, flags, start_type, start,
       stop_type, stop);
   gst_event_ref (seek);
+
+  if (format == GST_FORMAT_TIME)
+    _seek_stats_start (priv->seek_stats, scenario->pipeline, seek,
+        rate < 0 && stop_type == GST_SEEK_TYPE_SET ? stop : start_type ==
+        GST_SEEK_TYPE_SET ? start : GST_CLOCK_TIME_NONE);
+
   if (gst_element_send_event (scenario->pipeline, seek)) {
     gst_event_replace (&priv->last_seek, seek);
     priv->seek_flags = flags;
   } else {
+    _seek_stats_cancel (priv->seek_stats);
     GST_VALIDATE_REPORT (scenario, EVENT_SEEK_NOT_HANDLED,
         "Could not execute seek: '(position %" GST_TIME_FORMAT
         "), %s (num %u, missing repeat: %i), seeking to: %" GST_TIME_FORMAT
@@ -300,6 +919,97 @@ _execute_seek (GstValidateScenario * scenario, GstValidateAction * action)
   return ret;
 }
 
+static void
+_scenario_timeout_free (ScenarioTimeout * timeout)
+{
+  g_slice_free (ScenarioTimeout, timeout);
+}
+
+static gint
+_compare_timeouts (ScenarioTimeout * a, ScenarioTimeout * b)
+{
+  if (a->deadline < b->deadline)
+    return -1;
+  else if (a->deadline == b->deadline)
+    return 0;
+
+  return 1;
+}
+
+/* Calls @func every @interval milliseconds until it returns FALSE. In
+ * accelerated mode, the interval is measured on the pipeline clock and
+ * @func is called from _step_clock */
+static guint
+_scenario_add_timeout (GstValidateScenario * scenario, guint interval,
+    GSourceFunc func)
+{
+  ScenarioTimeout *timeout;
+  GstValidateScenarioPrivate *priv = scenario->priv;
+
+  if (priv->clock == NULL)
+    return g_timeout_add (interval, func, scenario);
+
+  timeout = g_slice_new0 (ScenarioTimeout);
+  timeout->id = ++priv->last_timeout_id;
+  timeout->interval = interval * GST_MSECOND;
+  timeout->deadline = gst_clock_get_time (priv->clock) + timeout->interval;
+  timeout->func = func;
+  priv->timeouts = g_list_insert_sorted (priv->timeouts, timeout,
+      (GCompareFunc) _compare_timeouts);
+
+  return timeout->id;
+}
+
+static void
+_scenario_remove_timeout (GstValidateScenario * scenario, guint id)
+{
+  GList *tmp;
+  GstValidateScenarioPrivate *priv = scenario->priv;
+
+  if (priv->clock == NULL) {
+    g_source_remove (id);
+    return;
+  }
+
+  if (priv->firing_timeout && priv->firing_timeout->id == id) {
+    priv->firing_timeout = NULL;
+    return;
+  }
+
+  for (tmp = priv->timeouts; tmp; tmp = tmp->next) {
+    ScenarioTimeout *timeout = tmp->data;
+
+    if (timeout->id == id) {
+      priv->timeouts = g_list_delete_link (priv->timeouts, tmp);
+      _scenario_timeout_free (timeout);
+      return;
+    }
+  }
+}
+
+static void
+_scenario_fire_timeouts (GstValidateScenario * scenario)
+{
+  GstValidateScenarioPrivate *priv = scenario->priv;
+  GstClockTime now = gst_clock_get_time (priv->clock);
+
+  while (priv->timeouts &&
+      ((ScenarioTimeout *) priv->timeouts->data)->deadline <= now) {
+    ScenarioTimeout *timeout = priv->timeouts->data;
+
+    priv->timeouts = g_list_delete_link (priv->timeouts, priv->timeouts);
+    priv->firing_timeout = timeout;
+    if (timeout->func (scenario) && priv->firing_timeout == timeout) {
+      timeout->deadline = now + timeout->interval;
+      priv->timeouts = g_list_insert_sorted (priv->timeouts, timeout,
+          (GCompareFunc) _compare_timeouts);
+    } else {
+      _scenario_timeout_free (timeout);
+    }
+    priv->firing_timeout = NULL;
+  }
+}
+
 static gboolean
 _pause_action_restore_playing (GstValidateScenario * scenario)
 {
@@ -338,8 +1048,8 @@ _execute_pause (GstValidateScenario * scenario, GstValidateAction * action)
     return FALSE;
   }
   if (duration)
-    g_timeout_add (duration * 1000,
-        (GSourceFunc) _pause_action_restore_playing, scenario);
+    _scenario_add_timeout (scenario, duration * 1000,
+        (GSourceFunc) _pause_action_restore_playing);
 
   return TRUE;
 }
@@ -584,54 +1294,83 @@ _set_rank (GstValidateScenario * scenario, GstValidateAction * action)
   return TRUE;
 }
 
-#ifdef linux
-typedef struct {
-      unsigned long size,resident,share,text,lib,data,dt;
-} statm_t;
-#endif
+static gint
+_compare_actions (GstValidateAction * a, GstValidateAction * b)
+{
+  if (a->action_number < b->action_number)
+    return -1;
+  else if (a->action_number == b->action_number)
+    return 0;
 
-static unsigned long
-get_resident_memory_usage(void) {
-#ifdef linux
-  FILE *proc_file;
-  statm_t result;
-  const gchar *statm_path = "/proc/self/statm";
-  proc_file = g_fopen(statm_path, "r");
+  return 1;
+}
 
-  if (!proc_file)
-    return 0;
-  if (7 != fscanf(proc_file,"%ld %ld %ld %ld %ld %ld %ld",
-                  &result.size,
-                  &result.resident,
-                  &result.share,
-                  &result.text,
-                  &result.lib,
-                  &result.data,
-                  &result.dt)) {
-    fclose(proc_file);
-    return 0;
-  } else {
-    fclose(proc_file);
-    return result.resident;
+/* The pending actions are kept in a binary min-heap ordered by action
+ * number (that is the order in which they appear in the scenario file), so
+ * that the next action to execute is always at index 0 and actions whose
+ * playback_time can only be computed once prerolled are merged back in
+ * O(log n). */
+static void
+_actions_heap_push (GPtrArray * heap, GstValidateAction * action)
+{
+  guint i, parent;
+
+  g_ptr_array_add (heap, action);
+  for (i = heap->len - 1; i > 0; i = parent) {
+    parent = (i - 1) / 2;
+
+    if (_compare_actions (g_ptr_array_index (heap, parent), action) <= 0)
+      break;
+
+    heap->pdata[i] = heap->pdata[parent];
   }
+  heap->pdata[i] = action;
+}
 
-#else
-  struct rusage* memory = g_malloc(sizeof(struct rusage));
-  errno = 0;
-  getrusage(RUSAGE_SELF, memory);
-  if(errno == EFAULT)
-    return 0;
-  else if(errno == EINVAL)
-    return 0;
+static GstValidateAction *
+_actions_heap_peek (GPtrArray * heap)
+{
+  if (heap->len == 0)
+    return NULL;
 
-  return (memory->ru_idrss);
-#endif
+  return g_ptr_array_index (heap, 0);
+}
+
+static GstValidateAction *
+_actions_heap_pop (GPtrArray * heap)
+{
+  guint i, child;
+  GstValidateAction *top, *last;
+
+  if (heap->len == 0)
+    return NULL;
+
+  top = g_ptr_array_index (heap, 0);
+  last = g_ptr_array_index (heap, heap->len - 1);
+  g_ptr_array_set_size (heap, heap->len - 1);
+
+  if (heap->len == 0)
+    return top;
+
+  for (i = 0; (child = 2 * i + 1) < heap->len; i = child) {
+    if (child + 1 < heap->len &&
+        _compare_actions (g_ptr_array_index (heap, child + 1),
+            g_ptr_array_index (heap, child)) < 0)
+      child++;
+
+    if (_compare_actions (last, g_ptr_array_index (heap, child)) <= 0)
+      break;
+
+    heap->pdata[i] = heap->pdata[child];
+  }
+  heap->pdata[i] = last;
+
+  return top;
 }
 
 static gboolean
 get_position (GstValidateScenario * scenario)
 {
-  GList *tmp;
   GstQuery *query;
   gdouble rate = 1.0;
   GstValidateAction *act = NULL;
@@ -646,12 +1385,16 @@ get_position (GstValidateScenario * scenario)
     gst_query_parse_segment (query, &rate, NULL, NULL, NULL);
 
   gst_query_unref (query);
-  if (scenario->priv->actions)
-    act = scenario->priv->actions->data;
-  gst_element_query_position (pipeline, format, &position);
+  act = _actions_heap_peek (priv->actions);
+
+  /* The action executed during this tick reuses the values queried here */
+  _invalidate_variables (scenario);
+  if (gst_element_query_position (pipeline, format, &position))
+    _cache_position (scenario, position);
 
   format = GST_FORMAT_TIME;
-  gst_element_query_duration (pipeline, format, &duration);
+  if (gst_element_query_duration (pipeline, format, &duration))
+    _cache_duration (scenario, duration);
 
   if (position > duration) {
     GST_VALIDATE_REPORT (scenario,
@@ -662,7 +1405,6 @@ get_position (GstValidateScenario * scenario)
     return TRUE;
   }
 
-  GST_INFO("memory usage is : %ld", get_resident_memory_usage());
   GST_LOG ("Current position: %" GST_TIME_FORMAT, GST_TIME_ARGS (position));
 
   /* Check if playback is within seek segment */
@@ -690,18 +1432,22 @@ get_position (GstValidateScenario * scenario)
       return TRUE;
 
     type = g_hash_table_lookup (action_types_table, act->type);
+    if (!_action_ensure_structure (act)) {
+      gst_mini_object_unref (GST_MINI_OBJECT (_actions_heap_pop
+              (priv->actions)));
+
+      return TRUE;
+    }
 
     if (act->repeat == -1 &&
         !gst_structure_get_int (act->structure, "repeat", &act->repeat)) {
-      gchar *error = NULL;
+      gdouble repeat;
       const gchar *repeat_expr = gst_structure_get_string (act->structure,
           "repeat");
 
-      if (repeat_expr) {
-        act->repeat =
-            gst_validate_utils_parse_expression (repeat_expr,
-            _set_variable_func, scenario, &error);
-      }
+      if (repeat_expr && _action_evaluate_expression (scenario, act, "repeat",
+              repeat_expr, &repeat))
+        act->repeat = repeat;
     }
 
     GST_DEBUG_OBJECT (scenario, "Executing %" GST_PTR_FORMAT
@@ -709,14 +1455,13 @@ get_position (GstValidateScenario * scenario)
     if (!type->execute (scenario, act))
       GST_WARNING_OBJECT (scenario, "Could not execute %" GST_PTR_FORMAT,
           act->structure);
+    _invalidate_variables (scenario);
 
     if (act->repeat > 0) {
       act->repeat--;
     } else {
-      tmp = priv->actions;
-      priv->actions = g_list_remove_link (priv->actions, tmp);
-      gst_mini_object_unref (GST_MINI_OBJECT (act));
-      g_list_free (tmp);
+      gst_mini_object_unref (GST_MINI_OBJECT (_actions_heap_pop
+              (priv->actions)));
     }
   }
 
@@ -747,25 +1492,23 @@ gst_validate_scenario_update_segment_from_seek (GstValidateScenario * scenario,
   }
 }
 
-static gint
-_compare_actions (GstValidateAction * a, GstValidateAction * b)
-{
-  if (a->action_number < b->action_number)
-    return -1;
-  else if (a->action_number == b->action_number)
-    return 0;
-
-  return 1;
-}
-
 static gboolean
 message_cb (GstBus * bus, GstMessage * message, GstValidateScenario * scenario)
 {
   GstValidateScenarioPrivate *priv = scenario->priv;
 
   switch (GST_MESSAGE_TYPE (message)) {
+    case GST_MESSAGE_STATE_CHANGED:
+      if (GST_MESSAGE_SRC (message) == (GstObject *) scenario->pipeline)
+        _invalidate_variables (scenario);
+      break;
     case GST_MESSAGE_ASYNC_DONE:
+      /* A seek or a state change completed, the duration is most probably
+       * known now */
+      _invalidate_variables (scenario);
+
       if (priv->last_seek) {
+        _seek_stats_async_done (priv->seek_stats);
         gst_validate_scenario_update_segment_from_seek (scenario,
             priv->last_seek);
         gst_event_replace (&priv->last_seek, NULL);
@@ -777,18 +1520,16 @@ message_cb (GstBus * bus, GstMessage * message, GstValidateScenario * scenario)
         for (tmp = priv->needs_parsing; tmp; tmp = tmp->next) {
           GstValidateAction *action = tmp->data;
 
-          if (!gst_validate_action_get_clocktime (scenario, action,
+          if (!_action_ensure_structure (action) ||
+              !gst_validate_action_get_clocktime (scenario, action,
                   "playback_time", &action->playback_time)) {
-            gchar *str = gst_structure_to_string (action->structure);
-
-            g_error ("Could not parse playback_time on structure: %s", str);
-            g_free (str);
+            g_error ("Could not parse playback_time on structure: %s",
+                action->structure_string);
 
             return FALSE;
           }
 
-          priv->actions = g_list_insert_sorted (priv->actions, action,
-              (GCompareFunc) _compare_actions);
+          _actions_heap_push (priv->actions, action);
         }
 
         g_list_free (priv->needs_parsing);
@@ -797,28 +1538,31 @@ message_cb (GstBus * bus, GstMessage * message, GstValidateScenario * scenario)
 
       if (priv->get_pos_id == 0) {
         get_position (scenario);
-        priv->get_pos_id =
-            g_timeout_add (50, (GSourceFunc) get_position, scenario);
+        priv->get_pos_id = _scenario_add_timeout (scenario,
+            POSITION_TICK_INTERVAL, (GSourceFunc) get_position);
       }
       break;
     case GST_MESSAGE_ERROR:
     case GST_MESSAGE_EOS:
     {
-      if (scenario->priv->actions) {
-        GList *tmp;
-        guint nb_actions = 0;
+      _seek_stats_print (priv->seek_stats,
+          gst_validate_reporter_get_name (GST_VALIDATE_REPORTER (scenario)));
+
+      if (priv->actions->len) {
+        guint i, nb_actions = 0;
         gchar *actions = g_strdup (""), *tmpconcat;
 
-        for (tmp = scenario->priv->actions; tmp; tmp = tmp->next) {
-          GstValidateAction *action = ((GstValidateAction *) tmp->data);
+        for (i = 0; i < priv->actions->len; i++) {
+          GstValidateAction *action = g_ptr_array_index (priv->actions, i);
           tmpconcat = actions;
 
-          if (g_strcmp0 (action->name, "eos"))
+          if (!_action_ensure_structure (action) ||
+              g_strcmp0 (action->name, "eos"))
             continue;
 
           nb_actions++;
           actions = g_strdup_printf ("%s\n%*s%s",
-              actions, 20, "", gst_structure_to_string (action->structure));
+              actions, 20, "", action->structure_string);
           g_free (tmpconcat);
 
         }
@@ -843,14 +1587,63 @@ _pipeline_freed_cb (GstValidateScenario * scenario,
   GstValidateScenarioPrivate *priv = scenario->priv;
 
   if (priv->get_pos_id) {
-    g_source_remove (priv->get_pos_id);
+    _scenario_remove_timeout (scenario, priv->get_pos_id);
     priv->get_pos_id = 0;
   }
+  if (priv->step_id) {
+    g_source_remove (priv->step_id);
+    priv->step_id = 0;
+  }
   scenario->pipeline = NULL;
 
   GST_DEBUG_OBJECT (scenario, "pipeline was freed");
 }
 
+/* Drives the pipeline clock in accelerated mode: it is moved straight to
+ * the earliest time a sink (or a scenario timeout) is waiting for. When
+ * nothing waits on the clock while playing, a streaming thread might still
+ * be about to, so the clock then only advances at the real time rate */
+static gboolean
+_step_clock (GstValidateScenario * scenario)
+{
+  GstState state, pending;
+  GstClockTime now, next, target;
+  GstValidateScenarioPrivate *priv = scenario->priv;
+  GstValidateSteppedClock *clock = GST_VALIDATE_STEPPED_CLOCK (priv->clock);
+  gint64 wall_now = g_get_monotonic_time ();
+
+  if (scenario->pipeline == NULL) {
+    priv->step_id = 0;
+    return FALSE;
+  }
+
+  now = gst_clock_get_time (priv->clock);
+  if (gst_validate_stepped_clock_get_next_entry (clock,
+          ACCELERATED_SETTLE_TIME, &next)) {
+    target = next;
+  } else {
+    GST_OBJECT_LOCK (scenario->pipeline);
+    state = GST_STATE (scenario->pipeline);
+    pending = GST_STATE_PENDING (scenario->pipeline);
+    GST_OBJECT_UNLOCK (scenario->pipeline);
+
+    /* Nothing can be synchronised on the clock, jump to the next timeout */
+    if (state != GST_STATE_PLAYING && pending != GST_STATE_PLAYING)
+      target = GST_CLOCK_TIME_NONE;
+    else
+      target = now + (wall_now - priv->last_step) * GST_USECOND;
+  }
+  priv->last_step = wall_now;
+
+  if (priv->timeouts)
+    target = MIN (target, ((ScenarioTimeout *) priv->timeouts->data)->deadline);
+
+  gst_validate_stepped_clock_advance (clock, target);
+  _scenario_fire_timeouts (scenario);
+
+  return TRUE;
+}
+
 static gchar **
 _scenario_file_get_lines (GFile * file)
 {
@@ -917,14 +1710,19 @@ _scenario_get_lines (const gchar * scenario_file)
   return lines;
 }
 
-static GList *
-_scenario_lines_get_strutures (gchar ** lines)
+static GVariant *
+_scenario_lines_compile (gchar ** lines, gint64 mtime, gint64 size)
 {
   gint i;
-  GList *structures = NULL;
+  gboolean is_config = FALSE;
+  GVariantBuilder actions;
 
+  g_variant_builder_init (&actions,
+      G_VARIANT_TYPE (GST_VALIDATE_SCENARIO_COMPILED_ACTIONS_FORMAT));
   for (i = 0; lines[i]; i++) {
     GstStructure *structure;
+    gdouble playback_time = -1.0;
+    const gchar *type, *name, *str_playback_time = NULL;
 
     if (g_strcmp0 (lines[i], "") == 0)
       continue;
@@ -932,78 +1730,209 @@ _scenario_lines_get_strutures (gchar ** lines)
     structure = gst_structure_from_string (lines[i], NULL);
     if (structure == NULL) {
       GST_ERROR ("Could not parse action %s", lines[i]);
-      goto failed;
+      g_variant_builder_clear (&actions);
+
+      return NULL;
     }
 
-    structures = g_list_append (structures, structure);
+    type = gst_structure_get_name (structure);
+    if (!g_strcmp0 (type, "description"))
+      gst_structure_get_boolean (structure, "is-config", &is_config);
+
+    if (!gst_structure_get_double (structure, "playback_time", &playback_time))
+      str_playback_time = gst_structure_get_string (structure, "playback_time");
+
+    if (!(name = gst_structure_get_string (structure, "name")))
+      name = "";
+
+    g_variant_builder_add (&actions, "(ssdss)", type, name, playback_time,
+        str_playback_time ? str_playback_time : "", lines[i]);
+    gst_structure_free (structure);
   }
 
-done:
-  if (lines)
-    g_strfreev (lines);
+  return g_variant_ref_sink (g_variant_new (GST_VALIDATE_SCENARIO_COMPILED_FORMAT,
+          GST_VALIDATE_SCENARIO_COMPILED_VERSION, mtime, size, is_config,
+          &actions));
+}
 
-  return structures;
+/* Returns the path of the file caching the @suffix data about @path */
+static gchar *
+_scenario_get_cache_path (const gchar * path, const gchar * suffix)
+{
+  gchar *abspath, *checksum, *filename, *cache_path;
 
-failed:
-  if (structures)
-    g_list_free_full (structures, (GDestroyNotify) gst_structure_free);
-  structures = NULL;
+  if (g_path_is_absolute (path)) {
+    abspath = g_strdup (path);
+  } else {
+    gchar *cwd = g_get_current_dir ();
 
-  goto done;
+    abspath = g_build_filename (cwd, path, NULL);
+    g_free (cwd);
+  }
+
+  checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA1, abspath, -1);
+  filename = g_strconcat (checksum, suffix, NULL);
+  cache_path = g_build_filename (g_get_user_cache_dir (),
+      "gstreamer-" GST_API_VERSION, GST_VALIDATE_SCENARIO_DIRECTORY, filename,
+      NULL);
+
+  g_free (filename);
+  g_free (checksum);
+  g_free (abspath);
+
+  return cache_path;
 }
 
-static GList *
-_scenario_get_structures (const gchar * scenario_file)
+static GVariant *
+_scenario_cache_load (const gchar * cache_path, const gchar * format)
 {
-  gchar **lines;
+  GMappedFile *mapped;
+
+  mapped = g_mapped_file_new (cache_path, FALSE, NULL);
+  if (mapped == NULL)
+    return NULL;
 
-  lines = _scenario_get_lines (scenario_file);
+  if (g_mapped_file_get_length (mapped) == 0) {
+    g_mapped_file_unref (mapped);
 
-  if (lines == NULL)
     return NULL;
+  }
 
-  return _scenario_lines_get_strutures (lines);
+  return g_variant_ref_sink (g_variant_new_from_data (G_VARIANT_TYPE (format),
+          g_mapped_file_get_contents (mapped),
+          g_mapped_file_get_length (mapped), FALSE,
+          (GDestroyNotify) g_mapped_file_unref, mapped));
 }
 
-static GList *
-_scenario_file_get_structures (GFile * scenario_file)
+static void
+_scenario_cache_save (const gchar * cache_path, GVariant * data)
 {
-  gchar **lines;
+  GError *err = NULL;
+  gchar *dir = g_path_get_dirname (cache_path);
 
-  lines = _scenario_file_get_lines (scenario_file);
+  if (g_mkdir_with_parents (dir, 0755) != 0) {
+    GST_INFO ("Could not create %s, not caching %s", dir, cache_path);
+  } else if (!g_file_set_contents (cache_path, g_variant_get_data (data),
+          g_variant_get_size (data), &err)) {
+    GST_INFO ("Could not save %s: %s", cache_path, err->message);
+    g_clear_error (&err);
+  }
+
+  g_free (dir);
+}
 
-  if (lines == NULL)
+static GVariant *
+_scenario_load_compiled (const gchar * compiled_path, gint64 mtime,
+    gint64 size)
+{
+  guint version;
+  GVariant *compiled;
+  gint64 compiled_mtime, compiled_size;
+
+  compiled = _scenario_cache_load (compiled_path,
+      GST_VALIDATE_SCENARIO_COMPILED_FORMAT);
+  if (compiled == NULL)
+    return NULL;
+
+  g_variant_get_child (compiled, 0, "u", &version);
+  g_variant_get_child (compiled, 1, "x", &compiled_mtime);
+  g_variant_get_child (compiled, 2, "x", &compiled_size);
+  if (version != GST_VALIDATE_SCENARIO_COMPILED_VERSION ||
+      compiled_mtime != mtime || compiled_size != size) {
+    GST_DEBUG ("%s is outdated", compiled_path);
+    g_variant_unref (compiled);
+
+    return NULL;
+  }
+
+  return compiled;
+}
+
+/* Returns the compiled form of @scenario_file, from the cache if it is
+ * up to date with the scenario file, compiling and caching it otherwise */
+static GVariant *
+_scenario_get_compiled (const gchar * scenario_file)
+{
+  gint64 mtime;
+  GStatBuf statbuf;
+  GVariant *compiled;
+  gchar **lines, *compiled_path;
+
+  GST_DEBUG ("Trying to load %s", scenario_file);
+  if (g_stat (scenario_file, &statbuf) != 0 || !S_ISREG (statbuf.st_mode))
     return NULL;
 
-  return _scenario_lines_get_strutures (lines);
+  mtime = gst_validate_utils_get_mtime (&statbuf);
+  compiled_path = _scenario_get_cache_path (scenario_file,
+      GST_VALIDATE_SCENARIO_COMPILED_SUFFIX);
+  compiled = _scenario_load_compiled (compiled_path, mtime, statbuf.st_size);
+
+  if (compiled == NULL && (lines = _scenario_get_lines (scenario_file))) {
+    GST_DEBUG ("Compiling %s into %s", scenario_file, compiled_path);
+
+    compiled = _scenario_lines_compile (lines, mtime, statbuf.st_size);
+    g_strfreev (lines);
+
+    /* The file could still be edited without its mtime changing */
+    if (compiled && !gst_validate_utils_mtime_is_recent (mtime))
+      _scenario_cache_save (compiled_path, compiled);
+  }
+
+  g_free (compiled_path);
+
+  return compiled;
+}
+
+static void
+_scenario_parse_description (GstValidateScenario * scenario,
+    const gchar * structure_string)
+{
+  gdouble max_latency, max_accuracy;
+  GstValidateScenarioPrivate *priv = scenario->priv;
+  GstStructure *desc = gst_structure_from_string (structure_string, NULL);
+
+  if (desc == NULL)
+    return;
+
+  g_mutex_lock (&priv->seek_stats->lock);
+  if (gst_structure_get_double (desc, "max-seek-latency", &max_latency))
+    priv->seek_stats->max_latency = max_latency * GST_SECOND;
+
+  if (gst_structure_get_double (desc, "max-seek-accuracy", &max_accuracy))
+    priv->seek_stats->max_accuracy = max_accuracy * GST_SECOND;
+  g_mutex_unlock (&priv->seek_stats->lock);
+
+  gst_structure_free (desc);
 }
 
 static gboolean
 _load_scenario_file (GstValidateScenario * scenario,
     const gchar * scenario_file, gboolean * is_config)
 {
+  GVariantIter iter;
+  gdouble playback_time;
   gboolean ret = TRUE;
-  GList *structures, *tmp;
+  GVariant *compiled, *actions = NULL;
+  const gchar *type, *name, *str_playback_time, *structure_string;
   GstValidateScenarioPrivate *priv = scenario->priv;
 
   *is_config = FALSE;
 
-  structures = _scenario_get_structures (scenario_file);
-  if (structures == NULL)
+  compiled = _scenario_get_compiled (scenario_file);
+  if (compiled == NULL)
     goto failed;
 
-  for (tmp = structures; tmp; tmp = tmp->next) {
-    gdouble playback_time;
+  g_variant_get_child (compiled, 3, "b", is_config);
+  actions = g_variant_get_child_value (compiled, 4);
+
+  g_variant_iter_init (&iter, actions);
+  while (g_variant_iter_next (&iter, "(&s&sd&s&s)", &type, &name,
+          &playback_time, &str_playback_time, &structure_string)) {
     GstValidateAction *action;
     GstValidateActionType *action_type;
-    const gchar *type, *str_playback_time = NULL;
-
-    GstStructure *structure = tmp->data;
-
 
-    type = gst_structure_get_name (structure);
     if (!g_strcmp0 (type, "description")) {
-      gst_structure_get_boolean (structure, "is-config", is_config);
+      _scenario_parse_description (scenario, structure_string);
       continue;
     } else if (!(action_type = g_hash_table_lookup (action_types_table, type))) {
       GST_ERROR_OBJECT (scenario, "We do not handle action types %s", type);
@@ -1011,24 +1940,14 @@ _load_scenario_file (GstValidateScenario * scenario,
     }
 
     action = gst_validate_action_new ();
-    action->type = type;
+    action->type = g_intern_string (type);
+    action->name = "";
     action->repeat = -1;
-    if (gst_structure_get_double (structure, "playback_time", &playback_time)) {
-      action->playback_time = playback_time * GST_SECOND;
-    } else if ((str_playback_time =
-            gst_structure_get_string (structure, "playback_time"))) {
-      priv->needs_parsing = g_list_append (priv->needs_parsing, action);
-    } else
-      GST_WARNING_OBJECT (scenario,
-          "No playback time for action %" GST_PTR_FORMAT, structure);
-
-    if (!(action->name = gst_structure_get_string (structure, "name")))
-      action->name = "";
-
-    action->structure = structure;
+    action->structure_string = g_strdup (structure_string);
 
     if (action_type->is_config) {
-      ret = action_type->execute (scenario, action);
+      ret = _action_ensure_structure (action) &&
+          action_type->execute (scenario, action);
       gst_mini_object_unref (GST_MINI_OBJECT (action));
 
       if (ret == FALSE)
@@ -1038,21 +1957,29 @@ _load_scenario_file (GstValidateScenario * scenario,
     }
 
     action->action_number = priv->num_actions++;
-    if (str_playback_time == NULL)
-      priv->actions = g_list_append (priv->actions, action);
+    if (playback_time >= 0) {
+      action->playback_time = playback_time * GST_SECOND;
+    } else if (g_strcmp0 (str_playback_time, "") == 0) {
+      GST_WARNING_OBJECT (scenario,
+          "No playback time for action %s", structure_string);
+    } else {
+      priv->needs_parsing = g_list_prepend (priv->needs_parsing, action);
+      continue;
+    }
+
+    _actions_heap_push (priv->actions, action);
   }
 
 done:
-  if (structures)
-    g_list_free (structures);
+  if (actions)
+    g_variant_unref (actions);
+  if (compiled)
+    g_variant_unref (compiled);
 
   return ret;
 
 failed:
   ret = FALSE;
-  if (structures)
-    g_list_free_full (structures, (GDestroyNotify) gst_structure_free);
-  structures = NULL;
 
   goto done;
 }
@@ -1226,6 +2153,8 @@ gst_validate_scenario_init (GstValidateScenario * scenario)
   GstValidateScenarioPrivate *priv = scenario->priv =
       GST_VALIDATE_SCENARIO_GET_PRIVATE (scenario);
 
+  priv->actions = g_ptr_array_new ();
+  priv->seek_stats = _seek_stats_new (scenario);
   priv->seek_pos_tol = DEFAULT_SEEK_TOLERANCE;
   priv->segment_start = 0;
   priv->segment_stop = GST_CLOCK_TIME_NONE;
@@ -1236,11 +2165,30 @@ gst_validate_scenario_dispose (GObject * object)
 {
   GstValidateScenarioPrivate *priv = GST_VALIDATE_SCENARIO (object)->priv;
 
+  if (priv->seek_stats) {
+    g_mutex_lock (&priv->seek_stats->lock);
+    priv->seek_stats->scenario = NULL;
+    g_mutex_unlock (&priv->seek_stats->lock);
+    _seek_stats_unref (priv->seek_stats);
+    priv->seek_stats = NULL;
+  }
+
   if (priv->last_seek)
     gst_event_unref (priv->last_seek);
   if (GST_VALIDATE_SCENARIO (object)->pipeline)
     gst_object_unref (GST_VALIDATE_SCENARIO (object)->pipeline);
-  g_list_free_full (priv->actions, (GDestroyNotify) gst_mini_object_unref);
+  if (priv->step_id) {
+    g_source_remove (priv->step_id);
+    priv->step_id = 0;
+  }
+  if (priv->clock) {
+    g_list_free_full (priv->timeouts, (GDestroyNotify) _scenario_timeout_free);
+    priv->timeouts = NULL;
+    gst_object_unref (priv->clock);
+    priv->clock = NULL;
+  }
+  g_ptr_array_foreach (priv->actions, (GFunc) gst_mini_object_unref, NULL);
+  g_ptr_array_set_size (priv->actions, 0);
 
 
   G_OBJECT_CLASS (gst_validate_scenario_parent_class)->dispose (object);
@@ -1249,9 +2197,21 @@ gst_validate_scenario_dispose (GObject * object)
 static void
 gst_validate_scenario_finalize (GObject * object)
 {
+  GstValidateScenarioPrivate *priv = GST_VALIDATE_SCENARIO (object)->priv;
+
+  g_ptr_array_unref (priv->actions);
+
   G_OBJECT_CLASS (gst_validate_scenario_parent_class)->finalize (object);
 }
 
+static gboolean
+_accelerated_mode_enabled (void)
+{
+  const gchar *accelerated = g_getenv ("GST_VALIDATE_ACCELERATED");
+
+  return accelerated && *accelerated && g_strcmp0 (accelerated, "0");
+}
+
 GstValidateScenario *
 gst_validate_scenario_factory_create (GstValidateRunner *
     runner, GstElement * pipeline, const gchar * scenario_name)
@@ -1274,6 +2234,15 @@ gst_validate_scenario_factory_create (GstValidateRunner *
   gst_validate_reporter_set_name (GST_VALIDATE_REPORTER (scenario),
       g_strdup (scenario_name));
 
+  if (_accelerated_mode_enabled () && GST_IS_PIPELINE (pipeline)) {
+    GstValidateScenarioPrivate *priv = scenario->priv;
+
+    priv->clock = gst_validate_stepped_clock_new ();
+    gst_pipeline_use_clock (GST_PIPELINE (pipeline), priv->clock);
+    priv->last_step = g_get_monotonic_time ();
+    priv->step_id = g_timeout_add (1, (GSourceFunc) _step_clock, scenario);
+  }
+
   bus = gst_element_get_bus (pipeline);
   gst_bus_add_signal_watch (bus);
   g_signal_connect (bus, "message", (GCallback) message_cb, scenario);
@@ -1288,66 +2257,230 @@ gst_validate_scenario_factory_create (GstValidateRunner *
 }
 
 static gboolean
-_add_description (GQuark field_id, const GValue * value, KeyFileGroupName * kfg)
+_add_description (GQuark field_id, const GValue * value,
+    GVariantBuilder * description)
 {
   gchar *tmp = gst_value_serialize (value);
+  gchar *compressed = g_strcompress (tmp);
 
-  g_key_file_set_string (kfg->kf, kfg->group_name,
-      g_quark_to_string (field_id), g_strcompress (tmp));
+  g_variant_builder_add (description, "{ss}", g_quark_to_string (field_id),
+      compressed);
 
+  g_free (compressed);
   g_free (tmp);
 
   return TRUE;
 }
 
-
-static void
-_list_scenarios_in_dir (GFile * dir, GKeyFile * kf)
+static GVariant *
+_scenario_index_entry_new (const gchar * name, const gchar * scenario_file,
+    GStatBuf * statbuf)
 {
-  GFileEnumerator *fenum;
-  GFileInfo *info;
+  gint64 mtime;
+  GVariantIter iter;
+  GVariant *compiled, *actions;
+  GVariantBuilder description, headers;
+  gboolean is_config = FALSE, has_description = FALSE;
+  const gchar *type, *action_name, *structure_string;
+
+  g_variant_builder_init (&description, G_VARIANT_TYPE ("a{ss}"));
+  g_variant_builder_init (&headers, G_VARIANT_TYPE ("a(ss)"));
+
+  if ((compiled = _scenario_get_compiled (scenario_file))) {
+    g_variant_get_child (compiled, 3, "b", &is_config);
+    actions = g_variant_get_child_value (compiled, 4);
+
+    g_variant_iter_init (&iter, actions);
+    while (g_variant_iter_next (&iter, "(&s&sd&s&s)", &type, &action_name,
+            NULL, NULL, &structure_string)) {
+      if (g_strcmp0 (type, "description")) {
+        g_variant_builder_add (&headers, "(ss)", type, action_name);
+      } else if (!has_description) {
+        GstStructure *desc = gst_structure_from_string (structure_string,
+            NULL);
+
+        if (desc) {
+          gst_structure_foreach (desc,
+              (GstStructureForeachFunc) _add_description, &description);
+          gst_structure_free (desc);
+        }
+        has_description = TRUE;
+      }
+    }
 
-  fenum = g_file_enumerate_children (dir, G_FILE_ATTRIBUTE_STANDARD_NAME,
-      G_FILE_QUERY_INFO_NONE, NULL, NULL);
+    g_variant_unref (actions);
+    g_variant_unref (compiled);
+  }
 
-  if (fenum == NULL)
-    return;
+  mtime = gst_validate_utils_get_mtime (statbuf);
+  if (gst_validate_utils_mtime_is_recent (mtime))
+    mtime = -1;
 
-  for (info = g_file_enumerator_next_file (fenum, NULL, NULL);
-      info; info = g_file_enumerator_next_file (fenum, NULL, NULL)) {
-    if (g_str_has_suffix (g_file_info_get_name (info),
-            GST_VALIDATE_SCENARIO_SUFFIX)) {
-      gchar **name = g_strsplit (g_file_info_get_name (info),
-          GST_VALIDATE_SCENARIO_SUFFIX, 0);
+  return g_variant_new (GST_VALIDATE_SCENARIO_INDEX_ENTRY_FORMAT, name,
+      mtime, (gint64) statbuf->st_size, is_config, &description, &headers);
+}
 
+/* Returns the index of the scenarios available in @dirpath, reusing and
+ * updating the cached one */
+static GVariant *
+_scenario_dir_get_index (const gchar * dirpath)
+{
+  guint i;
+  GStatBuf statbuf;
+  GVariantIter iter;
+  gint64 index_mtime = -1, dir_mtime;
+  GVariantBuilder entries;
+  gboolean changed = FALSE;
+  GVariant *index, *cached, *entry;
+  GHashTable *cached_entries;
+  GPtrArray *names = g_ptr_array_new_with_free_func (g_free);
+  gchar *index_path;
+
+  if (g_stat (dirpath, &statbuf) != 0 || !S_ISDIR (statbuf.st_mode)) {
+    g_ptr_array_unref (names);
 
-      GstStructure *desc = NULL;
-      GFile *f = g_file_enumerator_get_child (fenum, info);
-      GList *tmp, *structures = _scenario_file_get_structures (f);
+    return NULL;
+  }
 
-      gst_object_unref (f);
-      for (tmp = structures; tmp; tmp = tmp->next) {
-        if (gst_structure_has_name (tmp->data, "description")) {
-          desc = tmp->data;
-          break;
-        }
+  cached_entries = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+      (GDestroyNotify) g_variant_unref);
+  index_path = _scenario_get_cache_path (dirpath,
+      GST_VALIDATE_SCENARIO_INDEX_SUFFIX);
+  cached = _scenario_cache_load (index_path,
+      GST_VALIDATE_SCENARIO_INDEX_FORMAT);
+  if (cached) {
+    guint version;
+    GVariant *cached_list;
+
+    g_variant_get_child (cached, 0, "u", &version);
+    if (version == GST_VALIDATE_SCENARIO_INDEX_VERSION) {
+      g_variant_get_child (cached, 1, "x", &index_mtime);
+
+      cached_list = g_variant_get_child_value (cached, 2);
+      g_variant_iter_init (&iter, cached_list);
+      while ((entry = g_variant_iter_next_value (&iter))) {
+        const gchar *name;
+
+        g_variant_get_child (entry, 0, "&s", &name);
+        g_hash_table_insert (cached_entries, (gpointer) name, entry);
+        g_ptr_array_add (names, g_strdup (name));
       }
+      g_variant_unref (cached_list);
+    }
+  }
 
-      if (desc) {
-        KeyFileGroupName kfg;
-
-        kfg.group_name = name[0];
-        kfg.kf = kf;
+  /* Files were added or removed, list them again */
+  dir_mtime = gst_validate_utils_get_mtime (&statbuf);
+  if (index_mtime == -1 || index_mtime != dir_mtime) {
+    GDir *dir;
+    const gchar *filename;
+
+    changed = TRUE;
+    g_ptr_array_set_size (names, 0);
+    if ((dir = g_dir_open (dirpath, 0, NULL))) {
+      while ((filename = g_dir_read_name (dir))) {
+        if (g_str_has_suffix (filename, GST_VALIDATE_SCENARIO_SUFFIX))
+          g_ptr_array_add (names, g_strndup (filename, strlen (filename) -
+                  strlen (GST_VALIDATE_SCENARIO_SUFFIX)));
+      }
+      g_dir_close (dir);
+    }
+  }
 
-        gst_structure_foreach (desc,
-            (GstStructureForeachFunc) _add_description, &kfg);
+  g_variant_builder_init (&entries,
+      G_VARIANT_TYPE ("a" GST_VALIDATE_SCENARIO_INDEX_ENTRY_FORMAT));
+  for (i = 0; i < names->len; i++) {
+    GStatBuf filestat;
+    gint64 mtime, size;
+    const gchar *name = g_ptr_array_index (names, i);
+    gchar *lfilename = g_strdup_printf ("%s" GST_VALIDATE_SCENARIO_SUFFIX,
+        name);
+    gchar *scenario_file = g_build_filename (dirpath, lfilename, NULL);
+
+    if (g_stat (scenario_file, &filestat) != 0) {
+      changed = TRUE;
+    } else if ((entry = g_hash_table_lookup (cached_entries, name))) {
+      g_variant_get_child (entry, 1, "x", &mtime);
+      g_variant_get_child (entry, 2, "x", &size);
+
+      if (mtime != -1 && mtime == gst_validate_utils_get_mtime (&filestat) &&
+          size == (gint64) filestat.st_size) {
+        g_variant_builder_add_value (&entries, entry);
       } else {
-        g_key_file_set_string (kf, name[0], "noinfo", "nothing");
+        GST_DEBUG ("Updating %s in the index of %s", name, dirpath);
+        g_variant_builder_add_value (&entries,
+            _scenario_index_entry_new (name, scenario_file, &filestat));
+        changed = TRUE;
       }
-      g_list_free_full (structures, (GDestroyNotify) gst_structure_free);
-      g_strfreev (name);
+    } else {
+      GST_DEBUG ("Adding %s to the index of %s", name, dirpath);
+      g_variant_builder_add_value (&entries,
+          _scenario_index_entry_new (name, scenario_file, &filestat));
+      changed = TRUE;
+    }
+
+    g_free (scenario_file);
+    g_free (lfilename);
+  }
+
+  /* Files could still be added without the directory mtime changing */
+  if (gst_validate_utils_mtime_is_recent (dir_mtime))
+    dir_mtime = -1;
+
+  index = g_variant_ref_sink (g_variant_new (GST_VALIDATE_SCENARIO_INDEX_FORMAT,
+          GST_VALIDATE_SCENARIO_INDEX_VERSION, dir_mtime, &entries));
+  if (changed)
+    _scenario_cache_save (index_path, index);
+
+  g_hash_table_unref (cached_entries);
+  if (cached)
+    g_variant_unref (cached);
+  g_ptr_array_unref (names);
+  g_free (index_path);
+
+  return index;
+}
+
+static void
+_list_scenarios_in_dir (const gchar * dirpath, GKeyFile * kf)
+{
+  GVariantIter iter;
+  const gchar *name;
+  GVariant *index, *entries, *description;
+
+  index = _scenario_dir_get_index (dirpath);
+  if (index == NULL)
+    return;
+
+  entries = g_variant_get_child_value (index, 2);
+  g_variant_iter_init (&iter, entries);
+  while (g_variant_iter_next (&iter, "(&sxxb@a{ss}@a(ss))", &name, NULL,
+          NULL, NULL, &description, NULL)) {
+    gchar *lfilename = g_strdup_printf ("%s" GST_VALIDATE_SCENARIO_SUFFIX,
+        name);
+    gchar *scenario_file = g_build_filename (dirpath, lfilename, NULL);
+
+    if (g_variant_n_children (description)) {
+      GVariantIter desc_iter;
+      const gchar *field, *value;
+
+      g_variant_iter_init (&desc_iter, description);
+      while (g_variant_iter_next (&desc_iter, "{&s&s}", &field, &value))
+        g_key_file_set_string (kf, name, field, value);
+    } else {
+      g_key_file_set_string (kf, name, "noinfo", "nothing");
     }
+
+    /* So that the launcher knows which file its tests depend on */
+    g_key_file_set_string (kf, name, "path", scenario_file);
+
+    g_free (scenario_file);
+    g_free (lfilename);
+    g_variant_unref (description);
   }
+
+  g_variant_unref (entries);
+  g_variant_unref (index);
 }
 
 gboolean
@@ -1364,34 +2497,25 @@ gst_validate_list_scenarios (gchar * output_file)
   gchar *tldir = g_build_filename (g_get_user_data_dir (),
       "gstreamer-" GST_API_VERSION, GST_VALIDATE_SCENARIO_DIRECTORY,
       NULL);
-  GFile *dir = g_file_new_for_path (tldir);
 
   kf = g_key_file_new ();
-  _list_scenarios_in_dir (dir, kf);
-  g_object_unref (dir);
+  _list_scenarios_in_dir (tldir, kf);
   g_free (tldir);
 
   tldir = g_build_filename (GST_DATADIR, "gstreamer-" GST_API_VERSION,
       GST_VALIDATE_SCENARIO_DIRECTORY, NULL);
-  dir = g_file_new_for_path (tldir);
-  _list_scenarios_in_dir (dir, kf);
-  g_object_unref (dir);
+  _list_scenarios_in_dir (tldir, kf);
   g_free (tldir);
 
   if (env_scenariodir) {
     guint i;
 
-    for (i = 0; env_scenariodir[i]; i++) {
-      dir = g_file_new_for_path (env_scenariodir[i]);
-      _list_scenarios_in_dir (dir, kf);
-      g_object_unref (dir);
-    }
+    for (i = 0; env_scenariodir[i]; i++)
+      _list_scenarios_in_dir (env_scenariodir[i], kf);
   }
 
   /* Hack to make it work uninstalled */
-  dir = g_file_new_for_path ("data/");
-  _list_scenarios_in_dir (dir, kf);
-  g_object_unref (dir);
+  _list_scenarios_in_dir ("data/", kf);
 
   result = g_key_file_to_data (kf, &datalength, &err);
   g_print ("All scenarios avalaible:\n%s", result);
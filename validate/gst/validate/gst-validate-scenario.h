@@ -55,6 +55,11 @@ struct _GstValidateAction
   gint repeat;
   GstClockTime playback_time;
   GstStructure *structure;
+
+  /*< private >*/
+  gchar *structure_string;
+  /* field name -> GstValidateExpression */
+  GHashTable *expressions;
 };
 
 struct _GstValidateScenarioClass
@@ -0,0 +1,346 @@
+/* GStreamer
+ *
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * gst-validate-stepped-clock.c - A clock advanced on demand
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/**
+ * SECTION:gst-validate-stepped-clock
+ * @short_description: A clock advanced on demand
+ *
+ * The time of a #GstValidateSteppedClock never moves on its own. Whoever
+ * drives it (the scenario when running in accelerated mode) looks at the
+ * earliest time something is waiting for with
+ * gst_validate_stepped_clock_get_next_entry() and jumps there with
+ * gst_validate_stepped_clock_advance(). Synchronised sinks are then
+ * released in the same order and with the same jitter as with a real
+ * clock, only without sleeping.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include "gst-validate-internal.h"
+#include "gst-validate-stepped-clock.h"
+
+#define GST_VALIDATE_STEPPED_CLOCK_GET_PRIVATE(o) \
+  (G_TYPE_INSTANCE_GET_PRIVATE ((o), GST_TYPE_VALIDATE_STEPPED_CLOCK, \
+                                GstValidateSteppedClockPrivate))
+
+struct _GstValidateSteppedClockPrivate
+{
+  GMutex lock;
+  GCond cond;
+
+  GstClockTime time;
+
+  /* Pending GstClockEntry, sorted by time */
+  GList *entries;
+  /* Monotonic time of the last change of @entries */
+  gint64 last_change;
+};
+
+G_DEFINE_TYPE (GstValidateSteppedClock, gst_validate_stepped_clock,
+    GST_TYPE_CLOCK);
+
+static gint
+_compare_entries (GstClockEntry * a, GstClockEntry * b)
+{
+  if (GST_CLOCK_ENTRY_TIME (a) < GST_CLOCK_ENTRY_TIME (b))
+    return -1;
+  else if (GST_CLOCK_ENTRY_TIME (a) == GST_CLOCK_ENTRY_TIME (b))
+    return 0;
+
+  return 1;
+}
+
+/* Must be called with the lock taken */
+static void
+_add_entry (GstValidateSteppedClockPrivate * priv, GstClockEntry * entry)
+{
+  priv->entries = g_list_insert_sorted (priv->entries,
+      gst_clock_id_ref ((GstClockID) entry), (GCompareFunc) _compare_entries);
+  priv->last_change = g_get_monotonic_time ();
+}
+
+/* Must be called with the lock taken */
+static void
+_remove_entry (GstValidateSteppedClockPrivate * priv, GstClockEntry * entry)
+{
+  GList *link = g_list_find (priv->entries, entry);
+
+  if (link == NULL)
+    return;
+
+  priv->entries = g_list_delete_link (priv->entries, link);
+  priv->last_change = g_get_monotonic_time ();
+  gst_clock_id_unref ((GstClockID) entry);
+}
+
+static GstClockTime
+gst_validate_stepped_clock_get_internal_time (GstClock * clock)
+{
+  GstClockTime time;
+  GstValidateSteppedClockPrivate *priv =
+      GST_VALIDATE_STEPPED_CLOCK (clock)->priv;
+
+  g_mutex_lock (&priv->lock);
+  time = priv->time;
+  g_mutex_unlock (&priv->lock);
+
+  return time;
+}
+
+static GstClockTime
+gst_validate_stepped_clock_get_resolution (GstClock * clock)
+{
+  return 1;
+}
+
+static GstClockReturn
+gst_validate_stepped_clock_wait (GstClock * clock, GstClockEntry * entry,
+    GstClockTimeDiff * jitter)
+{
+  GstClockReturn ret;
+  GstValidateSteppedClockPrivate *priv =
+      GST_VALIDATE_STEPPED_CLOCK (clock)->priv;
+
+  g_mutex_lock (&priv->lock);
+  if (GST_CLOCK_ENTRY_STATUS (entry) == GST_CLOCK_UNSCHEDULED) {
+    g_mutex_unlock (&priv->lock);
+
+    return GST_CLOCK_UNSCHEDULED;
+  }
+
+  if (jitter)
+    *jitter = GST_CLOCK_DIFF (GST_CLOCK_ENTRY_TIME (entry), priv->time);
+
+  /* Same as the system clock, being late is only reported when the time
+   * already passed before starting to wait */
+  if (GST_CLOCK_ENTRY_TIME (entry) <= priv->time) {
+    ret = GST_CLOCK_ENTRY_TIME (entry) == priv->time ? GST_CLOCK_OK :
+        GST_CLOCK_EARLY;
+    GST_CLOCK_ENTRY_STATUS (entry) = ret;
+    g_mutex_unlock (&priv->lock);
+
+    return ret;
+  }
+
+  GST_CLOCK_ENTRY_STATUS (entry) = GST_CLOCK_BUSY;
+  _add_entry (priv, entry);
+  while (GST_CLOCK_ENTRY_STATUS (entry) != GST_CLOCK_UNSCHEDULED &&
+      GST_CLOCK_ENTRY_TIME (entry) > priv->time)
+    g_cond_wait (&priv->cond, &priv->lock);
+  _remove_entry (priv, entry);
+
+  if (jitter)
+    *jitter = GST_CLOCK_DIFF (GST_CLOCK_ENTRY_TIME (entry), priv->time);
+
+  if (GST_CLOCK_ENTRY_STATUS (entry) == GST_CLOCK_UNSCHEDULED)
+    ret = GST_CLOCK_UNSCHEDULED;
+  else
+    ret = GST_CLOCK_OK;
+  GST_CLOCK_ENTRY_STATUS (entry) = ret;
+  g_mutex_unlock (&priv->lock);
+
+  return ret;
+}
+
+static GstClockReturn
+gst_validate_stepped_clock_wait_async (GstClock * clock, GstClockEntry * entry)
+{
+  GstValidateSteppedClockPrivate *priv =
+      GST_VALIDATE_STEPPED_CLOCK (clock)->priv;
+
+  g_mutex_lock (&priv->lock);
+  if (GST_CLOCK_ENTRY_STATUS (entry) == GST_CLOCK_UNSCHEDULED) {
+    g_mutex_unlock (&priv->lock);
+
+    return GST_CLOCK_UNSCHEDULED;
+  }
+
+  /* Fired from gst_validate_stepped_clock_advance() */
+  GST_CLOCK_ENTRY_STATUS (entry) = GST_CLOCK_BUSY;
+  _add_entry (priv, entry);
+  g_mutex_unlock (&priv->lock);
+
+  return GST_CLOCK_OK;
+}
+
+static void
+gst_validate_stepped_clock_unschedule (GstClock * clock, GstClockEntry * entry)
+{
+  GstValidateSteppedClockPrivate *priv =
+      GST_VALIDATE_STEPPED_CLOCK (clock)->priv;
+
+  g_mutex_lock (&priv->lock);
+  GST_CLOCK_ENTRY_STATUS (entry) = GST_CLOCK_UNSCHEDULED;
+
+  /* Synchronous waiters remove their entry themselves once woken up */
+  if (entry->func)
+    _remove_entry (priv, entry);
+  g_cond_broadcast (&priv->cond);
+  g_mutex_unlock (&priv->lock);
+}
+
+/**
+ * gst_validate_stepped_clock_get_next_entry:
+ * @clock: A #GstValidateSteppedClock
+ * @settle: How long, in real time, no new entry must have been scheduled
+ * @time: (out): Return location for the time of the earliest pending entry
+ *
+ * Waiting for @settle gives the streaming threads that are just done
+ * with their previous buffer a chance to schedule their next wait before
+ * the clock is advanced, so that they are not considered late.
+ *
+ * Returns: %TRUE if something is waiting on @clock and no new entry was
+ * scheduled for @settle.
+ */
+gboolean
+gst_validate_stepped_clock_get_next_entry (GstValidateSteppedClock * clock,
+    GstClockTime settle, GstClockTime * time)
+{
+  gboolean ret = FALSE;
+  GstValidateSteppedClockPrivate *priv = clock->priv;
+
+  g_mutex_lock (&priv->lock);
+  if (priv->entries && g_get_monotonic_time () - priv->last_change >=
+      (gint64) GST_TIME_AS_USECONDS (settle)) {
+    *time = GST_CLOCK_ENTRY_TIME ((GstClockEntry *) priv->entries->data);
+    ret = TRUE;
+  }
+  g_mutex_unlock (&priv->lock);
+
+  return ret;
+}
+
+/**
+ * gst_validate_stepped_clock_advance:
+ * @clock: A #GstValidateSteppedClock
+ * @time: The new time of @clock, going backward is not possible
+ *
+ * Wakes up the synchronous waits scheduled up to @time and calls the
+ * callbacks of the asynchronous ones.
+ */
+void
+gst_validate_stepped_clock_advance (GstValidateSteppedClock * clock,
+    GstClockTime time)
+{
+  GList *tmp, *next, *due = NULL;
+  GstValidateSteppedClockPrivate *priv = clock->priv;
+
+  g_mutex_lock (&priv->lock);
+  if (GST_CLOCK_TIME_IS_VALID (time) && time > priv->time)
+    priv->time = time;
+
+  for (tmp = priv->entries; tmp; tmp = next) {
+    GstClockEntry *entry = tmp->data;
+
+    next = tmp->next;
+    if (GST_CLOCK_ENTRY_TIME (entry) > priv->time)
+      break;
+
+    /* The reference is passed to @due */
+    if (entry->func) {
+      priv->entries = g_list_delete_link (priv->entries, tmp);
+      due = g_list_prepend (due, entry);
+    }
+  }
+  g_cond_broadcast (&priv->cond);
+  g_mutex_unlock (&priv->lock);
+
+  /* Callbacks might use the clock, call them without the lock */
+  for (tmp = g_list_reverse (due); tmp; tmp = tmp->next) {
+    GstClockEntry *entry = tmp->data;
+
+    GST_CLOCK_ENTRY_STATUS (entry) = GST_CLOCK_OK;
+    entry->func (GST_CLOCK (clock), GST_CLOCK_ENTRY_TIME (entry),
+        (GstClockID) entry, entry->user_data);
+
+    g_mutex_lock (&priv->lock);
+    if (GST_CLOCK_ENTRY_TYPE (entry) == GST_CLOCK_ENTRY_PERIODIC &&
+        GST_CLOCK_ENTRY_STATUS (entry) != GST_CLOCK_UNSCHEDULED) {
+      GST_CLOCK_ENTRY_TIME (entry) += GST_CLOCK_ENTRY_INTERVAL (entry);
+      GST_CLOCK_ENTRY_STATUS (entry) = GST_CLOCK_BUSY;
+      _add_entry (priv, entry);
+    }
+    g_mutex_unlock (&priv->lock);
+
+    gst_clock_id_unref ((GstClockID) entry);
+  }
+  g_list_free (due);
+}
+
+static void
+gst_validate_stepped_clock_finalize (GObject * object)
+{
+  GstValidateSteppedClockPrivate *priv =
+      GST_VALIDATE_STEPPED_CLOCK (object)->priv;
+
+  g_list_free_full (priv->entries, (GDestroyNotify) gst_clock_id_unref);
+  g_mutex_clear (&priv->lock);
+  g_cond_clear (&priv->cond);
+
+  G_OBJECT_CLASS (gst_validate_stepped_clock_parent_class)->finalize (object);
+}
+
+static void
+gst_validate_stepped_clock_class_init (GstValidateSteppedClockClass * klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  GstClockClass *clock_class = GST_CLOCK_CLASS (klass);
+
+  g_type_class_add_private (klass, sizeof (GstValidateSteppedClockPrivate));
+
+  object_class->finalize = gst_validate_stepped_clock_finalize;
+
+  clock_class->get_internal_time =
+      gst_validate_stepped_clock_get_internal_time;
+  clock_class->get_resolution = gst_validate_stepped_clock_get_resolution;
+  clock_class->wait = gst_validate_stepped_clock_wait;
+  clock_class->wait_async = gst_validate_stepped_clock_wait_async;
+  clock_class->unschedule = gst_validate_stepped_clock_unschedule;
+}
+
+static void
+gst_validate_stepped_clock_init (GstValidateSteppedClock * clock)
+{
+  GstValidateSteppedClockPrivate *priv = clock->priv =
+      GST_VALIDATE_STEPPED_CLOCK_GET_PRIVATE (clock);
+
+  g_mutex_init (&priv->lock);
+  g_cond_init (&priv->cond);
+
+  GST_OBJECT_FLAG_SET (clock, GST_CLOCK_FLAG_CAN_DO_SINGLE_SYNC |
+      GST_CLOCK_FLAG_CAN_DO_SINGLE_ASYNC | GST_CLOCK_FLAG_CAN_DO_PERIODIC_SYNC |
+      GST_CLOCK_FLAG_CAN_DO_PERIODIC_ASYNC);
+}
+
+/**
+ * gst_validate_stepped_clock_new:
+ *
+ * Returns: (transfer full): A new #GstValidateSteppedClock, starting at 0
+ */
+GstClock *
+gst_validate_stepped_clock_new (void)
+{
+  return g_object_new (GST_TYPE_VALIDATE_STEPPED_CLOCK, "name",
+      "validate-stepped-clock", NULL);
+}
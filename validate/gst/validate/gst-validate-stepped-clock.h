@@ -0,0 +1,76 @@
+/* GStreamer
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * gst-validate-stepped-clock.h - A clock advanced on demand
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_VALIDATE_STEPPED_CLOCK_H__
+#define __GST_VALIDATE_STEPPED_CLOCK_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_VALIDATE_STEPPED_CLOCK            (gst_validate_stepped_clock_get_type ())
+#define GST_VALIDATE_STEPPED_CLOCK(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), GST_TYPE_VALIDATE_STEPPED_CLOCK, GstValidateSteppedClock))
+#define GST_VALIDATE_STEPPED_CLOCK_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), GST_TYPE_VALIDATE_STEPPED_CLOCK, GstValidateSteppedClockClass))
+#define GST_IS_VALIDATE_STEPPED_CLOCK(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GST_TYPE_VALIDATE_STEPPED_CLOCK))
+#define GST_IS_VALIDATE_STEPPED_CLOCK_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), GST_TYPE_VALIDATE_STEPPED_CLOCK))
+#define GST_VALIDATE_STEPPED_CLOCK_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), GST_TYPE_VALIDATE_STEPPED_CLOCK, GstValidateSteppedClockClass))
+
+typedef struct _GstValidateSteppedClock        GstValidateSteppedClock;
+typedef struct _GstValidateSteppedClockClass   GstValidateSteppedClockClass;
+typedef struct _GstValidateSteppedClockPrivate GstValidateSteppedClockPrivate;
+
+/**
+ * GstValidateSteppedClock:
+ *
+ * A #GstClock whose time only moves when
+ * gst_validate_stepped_clock_advance() is called, letting the pipeline
+ * run as fast as possible while keeping the synchronisation between its
+ * sinks.
+ */
+struct _GstValidateSteppedClock
+{
+  GstClock          clock;
+
+  /*< private >*/
+  GstValidateSteppedClockPrivate *priv;
+};
+
+/**
+ * GstValidateSteppedClockClass:
+ * @parent_class: parent
+ */
+struct _GstValidateSteppedClockClass
+{
+  GstClockClass     parent_class;
+};
+
+GType      gst_validate_stepped_clock_get_type       (void);
+
+GstClock * gst_validate_stepped_clock_new            (void);
+gboolean   gst_validate_stepped_clock_get_next_entry (GstValidateSteppedClock * clock,
+                                                      GstClockTime settle,
+                                                      GstClockTime * time);
+void       gst_validate_stepped_clock_advance        (GstValidateSteppedClock * clock,
+                                                      GstClockTime time);
+
+G_END_DECLS
+
+#endif /* __GST_VALIDATE_STEPPED_CLOCK_H__ */
@@ -20,6 +20,10 @@
  * Boston, MA 02111-1307, USA.
  */
 
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
 #include<math.h>
 #include<ctype.h>
 #include<stdio.h>
@@ -27,12 +31,57 @@
 #include<stdlib.h>
 
 #include "gst-validate-utils.h"
+#include "gst-validate-histogram-private.h"
 #include <gst/gst.h>
 
 #define PARSER_BOOLEAN_EQUALITY_THRESHOLD (1e-10)
 #define PARSER_MAX_TOKEN_SIZE 256
 #define PARSER_MAX_ARGUMENT_COUNT 10
 
+/* Expressions are compiled once to a small stack based bytecode, so that
+ * evaluating them again (with different variable values) does not need
+ * to go through the parser */
+typedef enum
+{
+  OP_CONSTANT,
+  OP_VARIABLE,
+  OP_NEGATE,
+  OP_ADD,
+  OP_SUBTRACT,
+  OP_MULTIPLY,
+  OP_DIVIDE,
+  OP_POWER,
+  OP_LESS,
+  OP_GREATER,
+  OP_LESS_EQUAL,
+  OP_GREATER_EQUAL,
+  OP_EQUAL,
+  OP_NOT_EQUAL,
+  OP_AND,
+  OP_OR,
+  OP_MIN,
+  OP_MAX
+} ExpressionOp;
+
+typedef struct
+{
+  ExpressionOp op;
+  union
+  {
+    gdouble constant;
+    guint variable;             /* index in GstValidateExpression.variables */
+  } arg;
+} ExpressionInstruction;
+
+struct _GstValidateExpression
+{
+  GArray *code;
+  /* Names of the variables referenced by the expression */
+  GPtrArray *variables;
+  /* Deepest the evaluation stack can get */
+  guint max_depth;
+};
+
 typedef struct
 {
   const gchar *str;
@@ -40,11 +89,13 @@ typedef struct
   gint pos;
   jmp_buf err_jmp_buf;
   const gchar *error;
-  void *user_data;
-  ParseVariableFunc variable_func;
+
+  GstValidateExpression *expression;
+  guint depth;
 } MathParser;
 
-static gdouble _read_power (MathParser * parser);
+static void _read_power (MathParser * parser);
+static void _read_boolean_or (MathParser * parser);
 
 static void
 _error (MathParser * parser, const gchar * err)
@@ -53,6 +104,60 @@ _error (MathParser * parser, const gchar * err)
   longjmp (parser->err_jmp_buf, 1);
 }
 
+static void
+_emit (MathParser * parser, ExpressionOp op)
+{
+  ExpressionInstruction instruction;
+
+  instruction.op = op;
+  instruction.arg.constant = 0.0;
+  g_array_append_val (parser->expression->code, instruction);
+
+  if (op == OP_NEGATE)
+    return;
+
+  /* All the other operations are binary */
+  parser->depth--;
+}
+
+static void
+_emit_constant (MathParser * parser, gdouble value)
+{
+  ExpressionInstruction instruction;
+
+  instruction.op = OP_CONSTANT;
+  instruction.arg.constant = value;
+  g_array_append_val (parser->expression->code, instruction);
+
+  parser->depth++;
+  parser->expression->max_depth =
+      MAX (parser->expression->max_depth, parser->depth);
+}
+
+static void
+_emit_variable (MathParser * parser, const gchar * name)
+{
+  guint i;
+  ExpressionInstruction instruction;
+  GPtrArray *variables = parser->expression->variables;
+
+  for (i = 0; i < variables->len; i++) {
+    if (g_strcmp0 (g_ptr_array_index (variables, i), name) == 0)
+      break;
+  }
+
+  if (i == variables->len)
+    g_ptr_array_add (variables, g_strdup (name));
+
+  instruction.op = OP_VARIABLE;
+  instruction.arg.variable = i;
+  g_array_append_val (parser->expression->code, instruction);
+
+  parser->depth++;
+  parser->expression->max_depth =
+      MAX (parser->expression->max_depth, parser->depth);
+}
+
 static gchar
 _peek (MathParser * parser)
 {
@@ -80,7 +185,7 @@ _next (MathParser * parser)
   return '\0';
 }
 
-static gdouble
+static void
 _read_double (MathParser * parser)
 {
   gchar c, token[PARSER_MAX_TOKEN_SIZE];
@@ -119,70 +224,56 @@ _read_double (MathParser * parser)
   if (pos == 0 || sscanf (token, "%lf", &val) != 1)
     _error (parser, "Failed to read real number");
 
-  return val;
+  _emit_constant (parser, val);
 }
 
-static gdouble
+static void
 _read_term (MathParser * parser)
 {
-  gdouble v0;
   gchar c;
 
-  v0 = _read_power (parser);
+  _read_power (parser);
   c = _peek (parser);
 
   while (c == '*' || c == '/') {
     _next (parser);
-    if (c == '*') {
-      v0 *= _read_power (parser);
-    } else if (c == '/') {
-      v0 /= _read_power (parser);
-    }
+    _read_power (parser);
+    _emit (parser, c == '*' ? OP_MULTIPLY : OP_DIVIDE);
     c = _peek (parser);
   }
-  return v0;
 }
 
-static gdouble
+static void
 _read_expr (MathParser * parser)
 {
-  gdouble v0 = 0.0;
   gchar c;
 
   c = _peek (parser);
   if (c == '+' || c == '-') {
     _next (parser);
-    if (c == '+')
-      v0 += _read_term (parser);
-    else if (c == '-')
-      v0 -= _read_term (parser);
+    _emit_constant (parser, 0.0);
+    _read_term (parser);
+    _emit (parser, c == '+' ? OP_ADD : OP_SUBTRACT);
   } else {
-    v0 = _read_term (parser);
+    _read_term (parser);
   }
 
   c = _peek (parser);
   while (c == '+' || c == '-') {
     _next (parser);
-    if (c == '+') {
-      v0 += _read_term (parser);
-    } else if (c == '-') {
-      v0 -= _read_term (parser);
-    }
+    _read_term (parser);
+    _emit (parser, c == '+' ? OP_ADD : OP_SUBTRACT);
 
     c = _peek (parser);
   }
-
-  return v0;
 }
 
-static gdouble
+static void
 _read_boolean_comparison (MathParser * parser)
 {
   gchar c, oper[] = { '\0', '\0', '\0' };
-  gdouble v0, v1;
-
 
-  v0 = _read_expr (parser);
+  _read_expr (parser);
   c = _peek (parser);
   if (c == '>' || c == '<') {
     oper[0] = _next (parser);
@@ -190,31 +281,28 @@ _read_boolean_comparison (MathParser * parser)
     if (c == '=')
       oper[1] = _next (parser);
 
-
-    v1 = _read_expr (parser);
+    _read_expr (parser);
 
     if (g_strcmp0 (oper, "<") == 0) {
-      v0 = (v0 < v1) ? 1.0 : 0.0;
+      _emit (parser, OP_LESS);
     } else if (g_strcmp0 (oper, ">") == 0) {
-      v0 = (v0 > v1) ? 1.0 : 0.0;
+      _emit (parser, OP_GREATER);
     } else if (g_strcmp0 (oper, "<=") == 0) {
-      v0 = (v0 <= v1) ? 1.0 : 0.0;
+      _emit (parser, OP_LESS_EQUAL);
     } else if (g_strcmp0 (oper, ">=") == 0) {
-      v0 = (v0 >= v1) ? 1.0 : 0.0;
+      _emit (parser, OP_GREATER_EQUAL);
     } else {
       _error (parser, "Unknown operation!");
     }
   }
-  return v0;
 }
 
-static gdouble
+static void
 _read_boolean_equality (MathParser * parser)
 {
   gchar c, oper[] = { '\0', '\0', '\0' };
-  gdouble v0, v1;
 
-  v0 = _read_boolean_comparison (parser);
+  _read_boolean_comparison (parser);
   c = _peek (parser);
   if (c == '=' || c == '!') {
     if (c == '!') {
@@ -222,7 +310,7 @@ _read_boolean_equality (MathParser * parser)
         oper[0] = _next (parser);
         oper[1] = _next (parser);
       } else {
-        return v0;
+        return;
       }
     } else {
       oper[0] = _next (parser);
@@ -231,25 +319,23 @@ _read_boolean_equality (MathParser * parser)
         _error (parser, "Expected a '=' for boolean '==' operator!");
       oper[1] = _next (parser);
     }
-    v1 = _read_boolean_comparison (parser);
+    _read_boolean_comparison (parser);
     if (g_strcmp0 (oper, "==") == 0) {
-      v0 = (fabs (v0 - v1) < PARSER_BOOLEAN_EQUALITY_THRESHOLD) ? 1.0 : 0.0;
+      _emit (parser, OP_EQUAL);
     } else if (g_strcmp0 (oper, "!=") == 0) {
-      v0 = (fabs (v0 - v1) > PARSER_BOOLEAN_EQUALITY_THRESHOLD) ? 1.0 : 0.0;
+      _emit (parser, OP_NOT_EQUAL);
     } else {
       _error (parser, "Unknown operation!");
     }
   }
-  return v0;
 }
 
-static gdouble
+static void
 _read_boolean_and (MathParser * parser)
 {
   gchar c;
-  gdouble v0, v1;
 
-  v0 = _read_boolean_equality (parser);
+  _read_boolean_equality (parser);
 
   c = _peek (parser);
   while (c == '&') {
@@ -260,23 +346,19 @@ _read_boolean_and (MathParser * parser)
       _error (parser, "Expected '&' to follow '&' in logical and operation!");
     _next (parser);
 
-    v1 = _read_boolean_equality (parser);
-    v0 = (fabs (v0) >= PARSER_BOOLEAN_EQUALITY_THRESHOLD
-        && fabs (v1) >= PARSER_BOOLEAN_EQUALITY_THRESHOLD) ? 1.0 : 0.0;
+    _read_boolean_equality (parser);
+    _emit (parser, OP_AND);
 
     c = _peek (parser);
   }
-
-  return v0;
 }
 
-static gdouble
+static void
 _read_boolean_or (MathParser * parser)
 {
   gchar c;
-  gdouble v0, v1;
 
-  v0 = _read_boolean_and (parser);
+  _read_boolean_and (parser);
 
   c = _peek (parser);
   while (c == '|') {
@@ -285,65 +367,56 @@ _read_boolean_or (MathParser * parser)
     if (c != '|')
       _error (parser, "Expected '|' to follow '|' in logical or operation!");
     _next (parser);
-    v1 = _read_boolean_and (parser);
-    v0 = (fabs (v0) >= PARSER_BOOLEAN_EQUALITY_THRESHOLD
-        || fabs (v1) >= PARSER_BOOLEAN_EQUALITY_THRESHOLD) ? 1.0 : 0.0;
+    _read_boolean_and (parser);
+    _emit (parser, OP_OR);
     c = _peek (parser);
   }
-
-  return v0;
 }
 
 static gboolean
 _init (MathParser * parser, const gchar * str,
-    ParseVariableFunc variable_func, void *user_data)
+    GstValidateExpression * expression)
 {
   parser->str = str;
   parser->len = strlen (str) + 1;
   parser->pos = 0;
   parser->error = NULL;
-  parser->user_data = user_data;
-  parser->variable_func = variable_func;
+  parser->expression = expression;
+  parser->depth = 0;
 
   return TRUE;
 }
 
-static gdouble
+static gboolean
 _parse (MathParser * parser)
 {
-  gdouble result = 0.0;
-
   if (!setjmp (parser->err_jmp_buf)) {
-    result = _read_expr (parser);
+    _read_expr (parser);
     if (parser->pos < parser->len - 1) {
       _error (parser,
           "Failed to reach end of input expression, likely malformed input");
     } else
-      return result;
+      return TRUE;
   } else {
-    return sqrt (-1.0);
+    return FALSE;
   }
-  return sqrt (-1.0);
+  return FALSE;
 }
 
-static gdouble
+static void
 _read_argument (MathParser * parser)
 {
   gchar c;
-  gdouble val;
 
-  val = _read_expr (parser);
+  _read_expr (parser);
   c = _peek (parser);
   if (c == ',')
     _next (parser);
-
-  return val;
 }
 
-static gdouble
+static void
 _read_builtin (MathParser * parser)
 {
-  gdouble v0 = 0.0, v1 = 0.0;
   gchar c, token[PARSER_MAX_TOKEN_SIZE];
   gint pos = 0;
 
@@ -358,13 +431,13 @@ _read_builtin (MathParser * parser)
     if (_peek (parser) == '(') {
       _next (parser);
       if (g_strcmp0 (token, "min") == 0) {
-        v0 = _read_argument (parser);
-        v1 = _read_argument (parser);
-        v0 = MIN (v0, v1);
+        _read_argument (parser);
+        _read_argument (parser);
+        _emit (parser, OP_MIN);
       } else if (g_strcmp0 (token, "max") == 0) {
-        v0 = _read_argument (parser);
-        v1 = _read_argument (parser);
-        v0 = MAX (v0, v1);
+        _read_argument (parser);
+        _read_argument (parser);
+        _emit (parser, OP_MAX);
       } else {
         _error (parser, "Tried to call unknown built-in function!");
       }
@@ -372,98 +445,253 @@ _read_builtin (MathParser * parser)
       if (_next (parser) != ')')
         _error (parser, "Expected ')' in built-in call!");
     } else {
-      if (parser->variable_func != NULL
-          && parser->variable_func (token, &v1, parser->user_data)) {
-        v0 = v1;
-      } else {
-        _error (parser, "Could not look up value for variable %s!");
-      }
+      /* Resolved when evaluating */
+      _emit_variable (parser, token);
     }
   } else {
-    v0 = _read_double (parser);
+    _read_double (parser);
   }
-
-  return v0;
 }
 
-static gdouble
+static void
 _read_parenthesis (MathParser * parser)
 {
-  gdouble val;
-
   if (_peek (parser) == '(') {
     _next (parser);
-    val = _read_boolean_or (parser);
+    _read_boolean_or (parser);
     if (_peek (parser) != ')')
       _error (parser, "Expected ')'!");
     _next (parser);
   } else {
-    val = _read_builtin (parser);
+    _read_builtin (parser);
   }
-
-  return val;
 }
 
-static gdouble
+static void
 _read_unary (MathParser * parser)
 {
   gchar c;
-  gdouble v0;
+
   c = _peek (parser);
   if (c == '!') {
     _error (parser, "Expected '+' or '-' for unary expression, got '!'");
   } else if (c == '-') {
     _next (parser);
-    v0 = -_read_parenthesis (parser);
+    _read_parenthesis (parser);
+    _emit (parser, OP_NEGATE);
   } else if (c == '+') {
     _next (parser);
-    v0 = _read_parenthesis (parser);
+    _read_parenthesis (parser);
   } else {
-    v0 = _read_parenthesis (parser);
+    _read_parenthesis (parser);
   }
-  return v0;
 }
 
-static gdouble
+static void
 _read_power (MathParser * parser)
 {
-  gdouble v0, v1 = 1.0, s = 1.0;
+  gboolean negate = FALSE;
 
-  v0 = _read_unary (parser);
+  _read_unary (parser);
 
   while (_peek (parser) == '^') {
     _next (parser);
     if (_peek (parser) == '-') {
       _next (parser);
-      s = -1.0;
+      negate = TRUE;
     }
-    v1 = s * _read_power (parser);
-    v0 = pow (v0, v1);
+    _read_power (parser);
+    if (negate)
+      _emit (parser, OP_NEGATE);
+    _emit (parser, OP_POWER);
   }
-
-  return v0;
 }
 
-gdouble
-gst_validate_utils_parse_expression (const gchar * expr, ParseVariableFunc variable_func,
-    gpointer user_data, gchar ** error)
+/**
+ * gst_validate_expression_compile:
+ * @expr: The expression to compile
+ * @error: (out) (allow-none): Return location for the parsing error message
+ *
+ * Compiles @expr so that it can be evaluated any number of times with
+ * gst_validate_expression_evaluate() without being parsed again. Variables
+ * are only resolved at evaluation time.
+ *
+ * Returns: The compiled expression, or %NULL if @expr could not be parsed
+ */
+GstValidateExpression *
+gst_validate_expression_compile (const gchar * expr, gchar ** error)
 {
-  gdouble val;
   MathParser parser;
+  gboolean ret;
+  GstValidateExpression *expression = g_slice_new0 (GstValidateExpression);
   gchar **spl = g_strsplit (expr, " ", -1);
   gchar *expr_nospace = g_strjoinv ("", spl);
 
-  _init (&parser, expr_nospace, variable_func, user_data);
-  val = _parse (&parser);
+  expression->code = g_array_new (FALSE, FALSE, sizeof (ExpressionInstruction));
+  expression->variables = g_ptr_array_new_with_free_func (g_free);
+
+  _init (&parser, expr_nospace, expression);
+  ret = _parse (&parser);
   g_strfreev (spl);
   g_free (expr_nospace);
 
-  if (error) {
-    if (parser.error)
-      *error = g_strdup (parser.error);
-    else
-      *error = NULL;
+  if (error)
+    *error = ret ? NULL : g_strdup (parser.error);
+
+  if (!ret) {
+    gst_validate_expression_free (expression);
+    return NULL;
   }
+
+  return expression;
+}
+
+void
+gst_validate_expression_free (GstValidateExpression * expression)
+{
+  g_array_free (expression->code, TRUE);
+  g_ptr_array_unref (expression->variables);
+  g_slice_free (GstValidateExpression, expression);
+}
+
+/**
+ * gst_validate_expression_evaluate:
+ * @expression: A #GstValidateExpression
+ * @variable_func: (allow-none): The function used to look up the variables
+ * @user_data: The data passed to @variable_func
+ * @error: (out) (allow-none): Return location for the evaluation error message
+ *
+ * Each variable referenced by @expression is looked up at most once.
+ *
+ * Returns: The value of @expression, NaN on error
+ */
+gdouble
+gst_validate_expression_evaluate (GstValidateExpression * expression,
+    ParseVariableFunc variable_func, gpointer user_data, gchar ** error)
+{
+  guint i, sp = 0, n_variables = expression->variables->len;
+  gdouble *stack = g_newa (gdouble, MAX (expression->max_depth, 1));
+  gdouble *values = g_newa (gdouble, MAX (n_variables, 1));
+  gboolean *resolved = g_newa (gboolean, MAX (n_variables, 1));
+
+  memset (resolved, 0, sizeof (gboolean) * n_variables);
+
+  if (error)
+    *error = NULL;
+
+  for (i = 0; i < expression->code->len; i++) {
+    ExpressionInstruction *instruction =
+        &g_array_index (expression->code, ExpressionInstruction, i);
+    gdouble v0, v1;
+
+    switch (instruction->op) {
+      case OP_CONSTANT:
+        stack[sp++] = instruction->arg.constant;
+        continue;
+      case OP_VARIABLE:
+      {
+        guint var = instruction->arg.variable;
+
+        if (!resolved[var]) {
+          const gchar *name = g_ptr_array_index (expression->variables, var);
+
+          if (variable_func == NULL
+              || !variable_func (name, &values[var], user_data)) {
+            if (error)
+              *error = g_strdup_printf ("Could not look up value for "
+                  "variable %s!", name);
+
+            return sqrt (-1.0);
+          }
+          resolved[var] = TRUE;
+        }
+
+        stack[sp++] = values[var];
+        continue;
+      }
+      case OP_NEGATE:
+        stack[sp - 1] = -stack[sp - 1];
+        continue;
+      default:
+        break;
+    }
+
+    /* Binary operations */
+    v1 = stack[--sp];
+    v0 = stack[sp - 1];
+    switch (instruction->op) {
+      case OP_ADD:
+        v0 += v1;
+        break;
+      case OP_SUBTRACT:
+        v0 -= v1;
+        break;
+      case OP_MULTIPLY:
+        v0 *= v1;
+        break;
+      case OP_DIVIDE:
+        v0 /= v1;
+        break;
+      case OP_POWER:
+        v0 = pow (v0, v1);
+        break;
+      case OP_LESS:
+        v0 = (v0 < v1) ? 1.0 : 0.0;
+        break;
+      case OP_GREATER:
+        v0 = (v0 > v1) ? 1.0 : 0.0;
+        break;
+      case OP_LESS_EQUAL:
+        v0 = (v0 <= v1) ? 1.0 : 0.0;
+        break;
+      case OP_GREATER_EQUAL:
+        v0 = (v0 >= v1) ? 1.0 : 0.0;
+        break;
+      case OP_EQUAL:
+        v0 = (fabs (v0 - v1) < PARSER_BOOLEAN_EQUALITY_THRESHOLD) ? 1.0 : 0.0;
+        break;
+      case OP_NOT_EQUAL:
+        v0 = (fabs (v0 - v1) > PARSER_BOOLEAN_EQUALITY_THRESHOLD) ? 1.0 : 0.0;
+        break;
+      case OP_AND:
+        v0 = (fabs (v0) >= PARSER_BOOLEAN_EQUALITY_THRESHOLD
+            && fabs (v1) >= PARSER_BOOLEAN_EQUALITY_THRESHOLD) ? 1.0 : 0.0;
+        break;
+      case OP_OR:
+        v0 = (fabs (v0) >= PARSER_BOOLEAN_EQUALITY_THRESHOLD
+            || fabs (v1) >= PARSER_BOOLEAN_EQUALITY_THRESHOLD) ? 1.0 : 0.0;
+        break;
+      case OP_MIN:
+        v0 = MIN (v0, v1);
+        break;
+      case OP_MAX:
+        v0 = MAX (v0, v1);
+        break;
+      default:
+        g_assert_not_reached ();
+        break;
+    }
+    stack[sp - 1] = v0;
+  }
+
+  return stack[0];
+}
+
+gdouble
+gst_validate_utils_parse_expression (const gchar * expr, ParseVariableFunc variable_func,
+    gpointer user_data, gchar ** error)
+{
+  gdouble val;
+  GstValidateExpression *expression;
+
+  expression = gst_validate_expression_compile (expr, error);
+  if (expression == NULL)
+    return sqrt (-1.0);
+
+  val = gst_validate_expression_evaluate (expression, variable_func, user_data,
+      error);
+  gst_validate_expression_free (expression);
+
   return val;
 }
 
@@ -499,3 +727,180 @@ gst_validate_utils_enum_from_str (GType type, const gchar * str_enum, guint * en
 
   g_type_class_unref (class);
 }
+
+/* Values are kept so that exact percentiles can be computed, the histogram
+ * itself uses power of two buckets starting at 1 millisecond */
+#define HISTOGRAM_N_BUCKETS 16
+#define HISTOGRAM_BAR_WIDTH 40
+
+struct _GstValidateHistogram
+{
+  GArray *values;
+  gboolean sorted;
+};
+
+GstValidateHistogram *
+gst_validate_histogram_new (void)
+{
+  GstValidateHistogram *histogram = g_slice_new0 (GstValidateHistogram);
+
+  histogram->values = g_array_new (FALSE, FALSE, sizeof (GstClockTime));
+
+  return histogram;
+}
+
+void
+gst_validate_histogram_free (GstValidateHistogram * histogram)
+{
+  g_array_unref (histogram->values);
+  g_slice_free (GstValidateHistogram, histogram);
+}
+
+void
+gst_validate_histogram_add (GstValidateHistogram * histogram,
+    GstClockTime value)
+{
+  g_array_append_val (histogram->values, value);
+  histogram->sorted = FALSE;
+}
+
+guint
+gst_validate_histogram_get_count (GstValidateHistogram * histogram)
+{
+  return histogram->values->len;
+}
+
+static gint
+_compare_clocktimes (const GstClockTime * a, const GstClockTime * b)
+{
+  if (*a < *b)
+    return -1;
+  else if (*a == *b)
+    return 0;
+
+  return 1;
+}
+
+/* @percentile is between 0 and 100, uses the nearest-rank method */
+GstClockTime
+gst_validate_histogram_get_percentile (GstValidateHistogram * histogram,
+    gdouble percentile)
+{
+  guint rank;
+
+  if (histogram->values->len == 0)
+    return GST_CLOCK_TIME_NONE;
+
+  if (!histogram->sorted) {
+    g_array_sort (histogram->values, (GCompareFunc) _compare_clocktimes);
+    histogram->sorted = TRUE;
+  }
+
+  rank = ceil (CLAMP (percentile, 0, 100) / 100 * histogram->values->len);
+
+  return g_array_index (histogram->values, GstClockTime, MAX (rank, 1) - 1);
+}
+
+static guint
+_histogram_bucket (GstClockTime value)
+{
+  guint bucket = 0;
+
+  for (value /= GST_MSECOND; value && bucket < HISTOGRAM_N_BUCKETS - 1;
+      value >>= 1)
+    bucket++;
+
+  return bucket;
+}
+
+gchar *
+gst_validate_histogram_to_string (GstValidateHistogram * histogram)
+{
+  guint i, max_count = 0, buckets[HISTOGRAM_N_BUCKETS] = { 0, };
+  GstClockTime total = 0;
+  GString *string = g_string_new (NULL);
+  guint count = histogram->values->len;
+
+  if (count == 0) {
+    g_string_append (string, "no values");
+
+    return g_string_free (string, FALSE);
+  }
+
+  for (i = 0; i < count; i++) {
+    GstClockTime value = g_array_index (histogram->values, GstClockTime, i);
+    guint bucket = _histogram_bucket (value);
+
+    total += value;
+    buckets[bucket]++;
+    max_count = MAX (max_count, buckets[bucket]);
+  }
+
+  g_string_append_printf (string, "count: %u, min: %" GST_TIME_FORMAT
+      ", mean: %" GST_TIME_FORMAT ", median: %" GST_TIME_FORMAT
+      ", 90%%: %" GST_TIME_FORMAT ", 99%%: %" GST_TIME_FORMAT
+      ", max: %" GST_TIME_FORMAT, count,
+      GST_TIME_ARGS (gst_validate_histogram_get_percentile (histogram, 0)),
+      GST_TIME_ARGS (total / count),
+      GST_TIME_ARGS (gst_validate_histogram_get_percentile (histogram, 50)),
+      GST_TIME_ARGS (gst_validate_histogram_get_percentile (histogram, 90)),
+      GST_TIME_ARGS (gst_validate_histogram_get_percentile (histogram, 99)),
+      GST_TIME_ARGS (gst_validate_histogram_get_percentile (histogram, 100)));
+
+  for (i = 0; i < HISTOGRAM_N_BUCKETS; i++) {
+    guint width;
+
+    if (buckets[i] == 0)
+      continue;
+
+    if (i == 0)
+      g_string_append_printf (string, "\n%14s < 1ms: ", "");
+    else if (i == HISTOGRAM_N_BUCKETS - 1)
+      g_string_append_printf (string, "\n%8s >= %6ums: ", "",
+          1 << (i - 1));
+    else
+      g_string_append_printf (string, "\n%6ums - %6ums: ", 1 << (i - 1),
+          1 << i);
+
+    width = MAX (1, buckets[i] * HISTOGRAM_BAR_WIDTH / max_count);
+    for (; width; width--)
+      g_string_append_c (string, '#');
+    g_string_append_printf (string, " %u", buckets[i]);
+  }
+
+  return g_string_free (string, FALSE);
+}
+
+/**
+ * gst_validate_utils_get_mtime:
+ * @statbuf: The result of a g_stat() call
+ *
+ * Returns: The modification time in @statbuf in nanoseconds, including the
+ * fraction of second when the platform provides it, so that a file written
+ * twice in the same second is seen as modified.
+ */
+gint64
+gst_validate_utils_get_mtime (GStatBuf * statbuf)
+{
+  gint64 mtime = (gint64) statbuf->st_mtime * GST_SECOND;
+
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+  mtime += statbuf->st_mtim.tv_nsec;
+#endif
+
+  return mtime;
+}
+
+/**
+ * gst_validate_utils_mtime_is_recent:
+ * @mtime: A modification time as returned by gst_validate_utils_get_mtime()
+ *
+ * Returns: %TRUE if @mtime is less than a second old. Files on file systems
+ * with whole second timestamps can then still be modified without their
+ * modification time changing, so caches keyed on it should not be trusted.
+ */
+gboolean
+gst_validate_utils_mtime_is_recent (gint64 mtime)
+{
+  return g_get_real_time () * GST_USECOND - mtime < GST_SECOND;
+}
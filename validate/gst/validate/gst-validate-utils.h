@@ -26,6 +26,7 @@
 #include<setjmp.h>
 #include<stdlib.h>
 #include<glib.h>
+#include <glib/gstdio.h>
 #include <gst/gst.h>
 
 typedef int (*ParseVariableFunc) (const gchar *name,
@@ -35,8 +36,21 @@ gdouble gst_validate_utils_parse_expression (const gchar *expr,
                                              ParseVariableFunc variable_func,
                                              gpointer user_data,
                                              gchar **error);
+typedef struct _GstValidateExpression GstValidateExpression;
+
+GstValidateExpression * gst_validate_expression_compile (const gchar *expr,
+                                                         gchar **error);
+gdouble gst_validate_expression_evaluate                (GstValidateExpression *expression,
+                                                         ParseVariableFunc variable_func,
+                                                         gpointer user_data,
+                                                         gchar **error);
+void gst_validate_expression_free                       (GstValidateExpression *expression);
+
 guint gst_validate_utils_flags_from_str     (GType type, const gchar * str_flags);
 void gst_validate_utils_enum_from_str       (GType type,
                                              const gchar * str_enum,
                                              guint * enum_value);
+
+gint64 gst_validate_utils_get_mtime               (GStatBuf * statbuf);
+gboolean gst_validate_utils_mtime_is_recent       (gint64 mtime);
 #endif
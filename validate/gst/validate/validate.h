@@ -8,5 +8,10 @@
 #include <gst/validate/gst-validate-report.h>
 #include <gst/validate/gst-validate-reporter.h>
 #include <gst/validate/gst-validate-media-info.h>
+#include <gst/validate/gst-validate-media-info-db.h>
+#include <gst/validate/gst-validate-frame-index.h>
+#include <gst/validate/gst-validate-resource-sampler.h>
+#include <gst/validate/gst-validate-stepped-clock.h>
+#include <gst/validate/gst-validate-progress.h>
 
 void gst_validate_init (void);
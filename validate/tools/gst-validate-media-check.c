@@ -27,6 +27,9 @@
 
 #include <stdlib.h>
 #include <string.h>
+#ifdef G_OS_UNIX
+#include <unistd.h>
+#endif
 
 #include <gst/gst.h>
 #include <gst/validate/validate.h>
@@ -160,6 +163,348 @@ _parse_encoding_profile (const gchar * option_name, const gchar * value,
 }
 #endif
 
+/* Batch mode: many files inspected by a pool of workers, the discoverers
+ * being reused from one file to the next */
+typedef struct
+{
+  gchar *uri;
+  gchar *output_file;
+
+  gboolean ret;
+  gboolean reused;
+  gchar *error;
+  GstClockTime duration;
+} MediaCheckJob;
+
+typedef struct
+{
+  gboolean discover_only;
+  gboolean force;
+  gboolean frame_index;
+  gboolean fingerprint_frames;
+  guint sample_count;
+  GstClockTime sample_window;
+  guint n_jobs;
+  guint done;
+  GMutex lock;
+
+  /* The GstDiscoverer not used by any worker, at most one per worker,
+   * released once all the files are done */
+  GAsyncQueue *discoverers;
+
+  /* Where the summaries of the saved results are added, or NULL */
+  GstValidateMediaInfoDBWriter *db;
+} MediaCheckBatch;
+
+/* Results without a fingerprint are never reused */
+static void
+_media_info_unset_fingerprint (GstValidateMediaInfo * mi)
+{
+  g_free (mi->fingerprint);
+  mi->fingerprint = NULL;
+}
+
+static gboolean
+_media_check_reuse_results (GstValidateMediaInfo * mi, const gchar * uri,
+    gboolean discover_only, gboolean frame_index, const gchar * path)
+{
+  guint sample_count = mi->sample_count;
+  GstClockTime sample_window = mi->sample_window;
+  gboolean fingerprint_frames = mi->fingerprint_frames;
+
+  if (!gst_validate_media_info_reuse_results (mi, uri, discover_only, path))
+    return FALSE;
+
+  if (!frame_index || mi->frame_indexes)
+    return TRUE;
+
+  /* The frame indexes were not written last time */
+  gst_validate_media_info_clear (mi);
+  gst_validate_media_info_init (mi);
+  mi->sample_count = sample_count;
+  mi->sample_window = sample_window;
+  mi->fingerprint_frames = fingerprint_frames;
+
+  return FALSE;
+}
+
+static void
+_media_check_job_free (MediaCheckJob * job)
+{
+  g_free (job->uri);
+  g_free (job->output_file);
+  g_free (job->error);
+  g_slice_free (MediaCheckJob, job);
+}
+
+static void
+_media_check_job_run (MediaCheckJob * job, MediaCheckBatch * batch)
+{
+  GstValidateMediaInfo mi;
+  GError *err = NULL;
+  GstDiscoverer *discoverer = g_async_queue_try_pop (batch->discoverers);
+  GstClockTime start = gst_util_get_timestamp ();
+  gboolean saved = FALSE;
+
+  gst_validate_media_info_init (&mi);
+  mi.sample_count = batch->sample_count;
+  mi.sample_window = batch->sample_window;
+  mi.fingerprint_frames = batch->fingerprint_frames;
+
+  if (!batch->force && job->output_file
+      && _media_check_reuse_results (&mi, job->uri, batch->discover_only,
+          batch->frame_index, job->output_file)) {
+    /* Only the results of checks that passed are reused */
+    job->ret = TRUE;
+    job->reused = saved = TRUE;
+    goto done;
+  }
+
+  if (!discoverer) {
+    discoverer = gst_discoverer_new (GST_SECOND * 60, &err);
+    if (!discoverer) {
+      job->error =
+          g_strdup (err ? err->message : "Could not create discoverer");
+      g_clear_error (&err);
+      goto done;
+    }
+  }
+
+  /* The pool already keeps the processors busy, run the playback checks
+   * of a file one after the other */
+  job->ret = gst_validate_media_info_inspect_uri_full (&mi, job->uri,
+      discoverer, batch->discover_only, 1, &err);
+  if (err) {
+    job->error = g_strdup (err->message);
+    g_clear_error (&err);
+  }
+
+  if (batch->frame_index && job->output_file
+      && !gst_validate_media_info_write_frame_indexes (&mi, job->output_file,
+          &err)) {
+    if (!job->error)
+      job->error = g_strdup_printf ("Could not write frame indexes: %s",
+          err ? err->message : "unknown reason");
+    g_clear_error (&err);
+    job->ret = FALSE;
+    _media_info_unset_fingerprint (&mi);
+  }
+
+  if (job->output_file
+      && !gst_validate_media_info_save (&mi, job->output_file, &err)) {
+    if (!job->error)
+      job->error = g_strdup_printf ("Could not write %s: %s",
+          job->output_file, err->message);
+    g_clear_error (&err);
+    job->ret = FALSE;
+  } else if (job->output_file) {
+    saved = TRUE;
+  }
+
+done:
+  if (discoverer)
+    g_async_queue_push (batch->discoverers, discoverer);
+  if (batch->db && saved)
+    gst_validate_media_info_db_writer_add (batch->db, &mi, job->output_file);
+  gst_validate_media_info_clear (&mi);
+  job->duration = gst_util_get_timestamp () - start;
+
+  g_mutex_lock (&batch->lock);
+  batch->done++;
+  g_print ("[%u/%u] %s %s%s in %" GST_TIME_FORMAT "%s%s\n", batch->done,
+      batch->n_jobs, job->uri, job->ret ? "OK" : "FAILED",
+      job->reused ? " (unchanged)" : "",
+      GST_TIME_ARGS (job->duration), job->error ? ": " : "",
+      job->error ? job->error : "");
+  g_mutex_unlock (&batch->lock);
+}
+
+static gchar *
+_media_check_output_file (const gchar * uri, const gchar * output_dir)
+{
+  gchar *filename, *output_file = NULL;
+
+  if (output_dir) {
+    gchar *basename = g_path_get_basename (uri);
+    gchar *hash = g_compute_checksum_for_string (G_CHECKSUM_SHA1, uri, -1);
+
+    /* Files with the same name in different directories do not overwrite
+     * each other's results */
+    filename = g_strdup_printf ("%s.%.8s.media_info", basename, hash);
+    output_file = g_build_filename (output_dir, filename, NULL);
+    g_free (basename);
+    g_free (filename);
+    g_free (hash);
+  } else if ((filename = g_filename_from_uri (uri, NULL, NULL))) {
+    /* Next to the file, where the launcher looks for it */
+    output_file = g_strdup_printf ("%s.media_info", filename);
+    g_free (filename);
+  }
+
+  return output_file;
+}
+
+static gint
+_compare_paths (const gchar ** a, const gchar ** b)
+{
+  return g_strcmp0 (*a, *b);
+}
+
+/* Whether @path is one of the files written by this tool: the results
+ * (FILE.media_info), the frame indexes and fingerprints next to them
+ * (FILE.media_info.*) or the database */
+static gboolean
+_media_check_is_output (const gchar * path, GStatBuf * database_stat)
+{
+  GStatBuf statbuf;
+  gchar *basename = g_path_get_basename (path);
+  gboolean ret = strstr (basename, ".media_info") != NULL;
+
+  g_free (basename);
+  if (!ret && database_stat && g_stat (path, &statbuf) == 0)
+    ret = statbuf.st_dev == database_stat->st_dev &&
+        statbuf.st_ino == database_stat->st_ino;
+
+  return ret;
+}
+
+static void
+_media_check_add_path (GPtrArray * uris, const gchar * path,
+    GStatBuf * database_stat)
+{
+  GDir *dir;
+  GPtrArray *names;
+  const gchar *name;
+  guint i;
+
+  if (gst_uri_is_valid (path)) {
+    g_ptr_array_add (uris, g_strdup (path));
+    return;
+  }
+
+  if (!g_file_test (path, G_FILE_TEST_IS_DIR)) {
+    if (!_media_check_is_output (path, database_stat))
+      g_ptr_array_add (uris, gst_filename_to_uri (path, NULL));
+    return;
+  }
+
+  if (!(dir = g_dir_open (path, 0, NULL)))
+    return;
+
+  /* Sorted so that the list does not depend on the file system */
+  names = g_ptr_array_new_with_free_func (g_free);
+  while ((name = g_dir_read_name (dir)))
+    g_ptr_array_add (names, g_build_filename (path, name, NULL));
+  g_dir_close (dir);
+  g_ptr_array_sort (names, (GCompareFunc) _compare_paths);
+
+  for (i = 0; i < names->len; i++)
+    _media_check_add_path (uris, g_ptr_array_index (names, i), database_stat);
+  g_ptr_array_unref (names);
+}
+
+static gboolean
+_media_check_add_uri_list (GPtrArray * uris, const gchar * uri_list,
+    GStatBuf * database_stat)
+{
+  gchar *content, **lines;
+  GError *err = NULL;
+  guint i;
+
+  if (!g_file_get_contents (uri_list, &content, NULL, &err)) {
+    g_printerr ("Could not read %s: %s\n", uri_list, err->message);
+    g_clear_error (&err);
+    return FALSE;
+  }
+
+  lines = g_strsplit (content, "\n", -1);
+  for (i = 0; lines[i]; i++) {
+    gchar *line = g_strstrip (lines[i]);
+
+    if (*line != '\0' && *line != '#')
+      _media_check_add_path (uris, line, database_stat);
+  }
+  g_strfreev (lines);
+  g_free (content);
+
+  return TRUE;
+}
+
+static int
+_run_batch (GPtrArray * uris, const gchar * output_dir,
+    gboolean discover_only, gboolean force, gboolean frame_index,
+    gboolean fingerprint_frames, guint sample_count,
+    GstClockTime sample_window, const gchar * database, gint n_workers)
+{
+  guint i, failed = 0;
+  int res = 0;
+  GError *err = NULL;
+  GThreadPool *pool;
+  GPtrArray *jobs;
+  MediaCheckBatch batch;
+  GstClockTime start = gst_util_get_timestamp ();
+
+  if (n_workers <= 0) {
+#ifdef G_OS_UNIX
+    n_workers = sysconf (_SC_NPROCESSORS_ONLN);
+#endif
+    n_workers = MAX (n_workers, 1);
+  }
+
+  batch.discover_only = discover_only;
+  batch.force = force;
+  batch.frame_index = frame_index;
+  batch.fingerprint_frames = fingerprint_frames;
+  batch.sample_count = sample_count;
+  batch.sample_window = sample_window;
+  batch.n_jobs = uris->len;
+  batch.done = 0;
+  g_mutex_init (&batch.lock);
+  batch.discoverers = g_async_queue_new_full (gst_object_unref);
+  batch.db = database ? gst_validate_media_info_db_writer_new (database) :
+      NULL;
+
+  jobs = g_ptr_array_new_with_free_func ((GDestroyNotify)
+      _media_check_job_free);
+  pool = g_thread_pool_new ((GFunc) _media_check_job_run, &batch, n_workers,
+      TRUE, NULL);
+  for (i = 0; i < uris->len; i++) {
+    MediaCheckJob *job = g_slice_new0 (MediaCheckJob);
+
+    job->uri = g_strdup (g_ptr_array_index (uris, i));
+    job->output_file = _media_check_output_file (job->uri, output_dir);
+    g_ptr_array_add (jobs, job);
+    g_thread_pool_push (pool, job, NULL);
+  }
+
+  /* Waits for all the files to be done */
+  g_thread_pool_free (pool, FALSE, TRUE);
+  g_mutex_clear (&batch.lock);
+  g_async_queue_unref (batch.discoverers);
+
+  if (batch.db && !gst_validate_media_info_db_writer_close (batch.db, &err)) {
+    g_printerr ("Could not write %s: %s\n", database, err->message);
+    g_clear_error (&err);
+    res = 1;
+  }
+
+  g_print ("\nSummary:\n");
+  for (i = 0; i < jobs->len; i++) {
+    MediaCheckJob *job = g_ptr_array_index (jobs, i);
+
+    if (!job->ret)
+      failed++;
+    g_print ("  %s %" GST_TIME_FORMAT " %s\n", job->ret ? "OK    " : "FAILED",
+        GST_TIME_ARGS (job->duration), job->uri);
+  }
+  g_print ("%u files, %u failed, %d workers, in %" GST_TIME_FORMAT "\n",
+      jobs->len, failed, n_workers,
+      GST_TIME_ARGS (gst_util_get_timestamp () - start));
+  g_ptr_array_unref (jobs);
+
+  return failed ? 1 : res;
+}
+
 int
 main (int argc, gchar ** argv)
 {
@@ -169,9 +514,13 @@ main (int argc, gchar ** argv)
   GError *err = NULL;
   gchar *output_file = NULL;
   gchar *expected_file = NULL;
+  gchar *uri_list = NULL, *output_dir = NULL, *database = NULL;
   gchar *output = NULL;
   gsize outputlength;
-  gboolean ret, discover_only;
+  gboolean ret, discover_only = FALSE, force = FALSE, frame_index = FALSE;
+  gboolean fingerprint_frames = FALSE;
+  gint jobs = 0, samples = 0;
+  gdouble sample_window = 1.0;
 
   GOptionEntry options[] = {
     {"output-file", 'o', 0, G_OPTION_ARG_FILENAME,
@@ -184,11 +533,51 @@ main (int argc, gchar ** argv)
     {"discover-only", 'e', 0, G_OPTION_ARG_NONE,
           &discover_only, "Only discover files, no other playback tests",
         NULL},
+    {"jobs", 'j', 0, G_OPTION_ARG_INT,
+          &jobs, "How many playback tests, or files when checking several "
+          "of them, to run at the same time (default: the number of "
+          "processors)",
+        NULL},
+    {"force", 'f', 0, G_OPTION_ARG_NONE,
+          &force, "Inspect the files even if the results in the output "
+          "files are up to date",
+        NULL},
+    {"frame-index", 'i', 0, G_OPTION_ARG_NONE,
+          &frame_index, "Also write the index of the frames of every stream "
+          "next to the output file(s), used by the scenarios to check that "
+          "seeks land on the right frame",
+        NULL},
+    {"fingerprint-frames", 'F', 0, G_OPTION_ARG_NONE,
+          &fingerprint_frames, "Also save a hash and a perceptual signature "
+          "of every decoded frame, so that decoder output changes are "
+          "reported when comparing results",
+        NULL},
+    {"samples", 's', 0, G_OPTION_ARG_INT,
+          &samples, "Only check playback in short windows at that many "
+          "positions spread over the file instead of playing it entirely",
+        NULL},
+    {"sample-window", 'w', 0, G_OPTION_ARG_DOUBLE,
+          &sample_window, "How long to play at each position with "
+          "--samples, in seconds (default: 1)",
+        NULL},
+    {"uri-list", 'l', 0, G_OPTION_ARG_FILENAME,
+          &uri_list, "Check all the URIs or paths listed in a file, "
+          "one per line",
+        NULL},
+    {"database", 'd', 0, G_OPTION_ARG_FILENAME,
+          &database, "Add a summary of the results of the file(s) to that "
+          "media info database, used by the launcher to list the media "
+          "without reading all their results files",
+        NULL},
+    {"output-dir", 'O', 0, G_OPTION_ARG_FILENAME,
+          &output_dir, "When checking several files, where to write their "
+          "results (default: next to local files, as FILE.media_info)",
+        NULL},
     {NULL}
   };
 
   g_set_prgname ("gst-validate-media-check-" GST_API_VERSION);
-  ctx = g_option_context_new ("[URI]");
+  ctx = g_option_context_new ("[URI|PATH...]");
   g_option_context_set_summary (ctx, "Analizes a media file and writes "
       "the results to stdout or a file. Can also compare the results found "
       "with another results file for identifying regressions. The monitoring"
@@ -206,6 +595,39 @@ main (int argc, gchar ** argv)
   gst_init (&argc, &argv);
   gst_validate_init ();
 
+  sample_window = MAX (sample_window, 0.0);
+
+  if (uri_list || argc > 2 || (argc == 2
+          && g_file_test (argv[1], G_FILE_TEST_IS_DIR))) {
+    GPtrArray *uris = g_ptr_array_new_with_free_func (g_free);
+    GStatBuf database_stat, *pdatabase_stat = NULL;
+    int i, res = 0;
+
+    g_option_context_free (ctx);
+    if (output_file || expected_file) {
+      g_printerr ("--output-file and --expected-results can only be used "
+          "with a single file\n");
+      return 1;
+    }
+
+    if (database && g_stat (database, &database_stat) == 0)
+      pdatabase_stat = &database_stat;
+
+    if (uri_list && !_media_check_add_uri_list (uris, uri_list,
+            pdatabase_stat))
+      res = 1;
+    for (i = 1; i < argc; i++)
+      _media_check_add_path (uris, argv[i], pdatabase_stat);
+
+    if (res == 0)
+      res = _run_batch (uris, output_dir, discover_only, force, frame_index,
+          fingerprint_frames, MAX (samples, 0), sample_window * GST_SECOND,
+          database, jobs);
+    g_ptr_array_unref (uris);
+
+    return res;
+  }
+
   if (argc != 2) {
     gchar *msg = g_option_context_get_help (ctx, TRUE, NULL);
     g_printerr ("%s\n", msg);
@@ -215,12 +637,58 @@ main (int argc, gchar ** argv)
   }
   g_option_context_free (ctx);
 
+  if (frame_index && !output_file) {
+    g_printerr ("--frame-index needs an --output-file\n");
+    return 1;
+  }
+  if (database && !output_file) {
+    g_printerr ("--database needs an --output-file\n");
+    return 1;
+  }
+
   gst_validate_media_info_init (&mi);
-  ret = gst_validate_media_info_inspect_uri (&mi, argv[1], discover_only, NULL);
-  output = gst_validate_media_info_to_string (&mi, &outputlength);
+  mi.sample_count = MAX (samples, 0);
+  mi.sample_window = sample_window * GST_SECOND;
+  mi.fingerprint_frames = fingerprint_frames;
+
+  if (!force && output_file
+      && _media_check_reuse_results (&mi, argv[1], discover_only,
+          frame_index, output_file)) {
+    g_print ("Nothing changed since %s was written, reusing it\n",
+        output_file);
+    ret = TRUE;
+  } else {
+    ret = gst_validate_media_info_inspect_uri_full (&mi, argv[1], NULL,
+        discover_only, MAX (jobs, 0), NULL);
+    if (frame_index
+        && !gst_validate_media_info_write_frame_indexes (&mi, output_file,
+            &err)) {
+      g_print ("Could not write frame indexes: %s\n",
+          err ? err->message : "unknown reason");
+      g_clear_error (&err);
+      ret = FALSE;
+      _media_info_unset_fingerprint (&mi);
+    }
+    if (output_file && !gst_validate_media_info_save (&mi, output_file,
+            NULL)) {
+      /* Never reference results that are not there */
+      g_free (database);
+      database = NULL;
+    }
+  }
 
-  if (output_file)
-    gst_validate_media_info_save (&mi, output_file, NULL);
+  if (database) {
+    GstValidateMediaInfoDBWriter *db =
+        gst_validate_media_info_db_writer_new (database);
+
+    gst_validate_media_info_db_writer_add (db, &mi, output_file);
+    if (!gst_validate_media_info_db_writer_close (db, &err)) {
+      g_print ("Could not write %s: %s\n", database, err->message);
+      g_clear_error (&err);
+      ret = FALSE;
+    }
+  }
+  output = gst_validate_media_info_to_string (&mi, &outputlength);
 
   if (expected_file) {
     GstValidateMediaInfo *expected_mi;
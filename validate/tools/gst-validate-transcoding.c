@@ -36,22 +36,394 @@
 
 #ifdef G_OS_UNIX
 #include <glib-unix.h>
+#include <sys/resource.h>
 #endif
 
 #include <gst/validate/gst-validate-scenario.h>
+#include <gst/validate/gst-validate-histogram-private.h>
+#include <gst/validate/gst-validate-utils.h>
 
 static gint ret = 0;
 static GMainLoop *mainloop;
-static GstElement *pipeline, *encodebin;
+static GstElement *pipeline;
+/* The profile being parsed */
 static GstEncodingProfile *encoding_profile = NULL;
+/* One per --output-format */
+static GList *encoding_profiles = NULL;
 static gboolean eos_on_shutdown = FALSE;
 static gboolean force_reencoding = FALSE;
 static GList *all_raw_caps = NULL;
 static guint print_pos_srcid = 0;
+/* Set when the launcher wants the progress in GST_VALIDATE_PROGRESS_FILE */
+static GstValidateProgress *progress = NULL;
 
 static gboolean buffering = FALSE;
 static gboolean is_live = FALSE;
 
+typedef struct _OutputVerification OutputVerification;
+
+/* Every output is encoded by its own bin, fed from the same decoded
+ * streams, tee'd when there are several outputs */
+typedef struct
+{
+  guint index;
+  gchar *output_uri;
+  GstEncodingProfile *profile;
+
+  /* Contains the encodebin, the sink and a queue per stream */
+  GstElement *bin;
+  GstElement *encodebin;
+
+  /* Number of issues reported by the elements of the branch */
+  volatile gint n_reports;
+  /* Number of streams linked to encodebin */
+  volatile gint n_streams;
+
+  /* With --verify-output */
+  OutputVerification *verification;
+} TranscodingBranch;
+
+/* TranscodingBranch, in the order of the output uris */
+static GPtrArray *branches = NULL;
+
+/* The output @object is part of, if any */
+static TranscodingBranch *
+find_branch (GstObject * object)
+{
+  guint i;
+
+  for (i = 0; object && i < branches->len; i++) {
+    TranscodingBranch *branch = g_ptr_array_index (branches, i);
+
+    if (object == GST_OBJECT (branch->bin)
+        || gst_object_has_ancestor (object, GST_OBJECT (branch->bin)))
+      return branch;
+  }
+
+  return NULL;
+}
+
+/* Inline verification of the outputs: the muxer output is tee'd to a
+ * decodebin that stops at the formats of the encoding profile, and the
+ * streams it exposes are checked while the file is being written, so that
+ * it does not need to be read again afterward */
+static gboolean verify_output = FALSE;
+static gint64 expected_duration = -1;
+static gint64 duration_tolerance = 0;
+
+typedef struct
+{
+  GstCaps *caps;
+  gboolean matches_profile;
+
+  guint64 n_frames;
+  guint64 n_keyframes;
+  gboolean first_is_keyframe;
+  GstClockTime first_ts;
+  GstClockTime end_ts;
+  GstClockTime last_keyframe;
+  GstClockTime max_keyframe_interval;
+} VerifiedStream;
+
+struct _OutputVerification
+{
+  /* queue ! decodebin ! fakesink per stream */
+  GstElement *bin;
+  /* Formats of the streams of the encoding profile */
+  GstCaps *stream_formats;
+
+  GMutex lock;
+  /* VerifiedStream, added from the decodebin streaming threads */
+  GPtrArray *streams;
+
+  /* Set if the output could not be demuxed, its buffers are then dropped
+   * before they reach the verification elements */
+  volatile gint failed;
+  gchar *failure;
+};
+
+static void
+_verified_stream_free (VerifiedStream * stream)
+{
+  if (stream->caps)
+    gst_caps_unref (stream->caps);
+  g_slice_free (VerifiedStream, stream);
+}
+
+static GstPadProbeReturn
+_drop_if_failed_probe (GstPad * pad, GstPadProbeInfo * info,
+    OutputVerification * verification)
+{
+  if (g_atomic_int_get (&verification->failed))
+    return GST_PAD_PROBE_DROP;
+
+  return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn
+_verified_buffer_probe (GstPad * pad, GstPadProbeInfo * info,
+    VerifiedStream * stream)
+{
+  GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+  GstClockTime ts = GST_BUFFER_PTS_IS_VALID (buffer) ?
+      GST_BUFFER_PTS (buffer) : GST_BUFFER_DTS (buffer);
+  gboolean keyframe = !GST_BUFFER_FLAG_IS_SET (buffer,
+      GST_BUFFER_FLAG_DELTA_UNIT);
+
+  if (stream->n_frames == 0)
+    stream->first_is_keyframe = keyframe;
+  stream->n_frames++;
+
+  if (!GST_CLOCK_TIME_IS_VALID (ts))
+    return GST_PAD_PROBE_OK;
+
+  if (!GST_CLOCK_TIME_IS_VALID (stream->first_ts) || ts < stream->first_ts)
+    stream->first_ts = ts;
+  if (GST_BUFFER_DURATION_IS_VALID (buffer))
+    ts += GST_BUFFER_DURATION (buffer);
+  if (!GST_CLOCK_TIME_IS_VALID (stream->end_ts) || ts > stream->end_ts)
+    stream->end_ts = ts;
+
+  if (keyframe) {
+    ts = GST_BUFFER_PTS_IS_VALID (buffer) ?
+        GST_BUFFER_PTS (buffer) : GST_BUFFER_DTS (buffer);
+
+    stream->n_keyframes++;
+    if (GST_CLOCK_TIME_IS_VALID (stream->last_keyframe)
+        && ts > stream->last_keyframe)
+      stream->max_keyframe_interval = MAX (stream->max_keyframe_interval,
+          ts - stream->last_keyframe);
+    stream->last_keyframe = ts;
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+_verification_pad_added_cb (GstElement * decodebin, GstPad * pad,
+    OutputVerification * verification)
+{
+  GstPad *sinkpad;
+  const GstStructure *structure;
+  VerifiedStream *stream = g_slice_new0 (VerifiedStream);
+  GstElement *fakesink = gst_element_factory_make ("fakesink", NULL);
+
+  stream->caps = gst_pad_get_current_caps (pad);
+  if (stream->caps == NULL)
+    stream->caps = gst_pad_query_caps (pad, NULL);
+  structure = gst_caps_get_structure (stream->caps, 0);
+  /* Raw streams mean decodebin had to decode them to expose them */
+  stream->matches_profile = structure &&
+      !g_str_has_suffix (gst_structure_get_name (structure), "/x-raw")
+      && gst_caps_can_intersect (stream->caps, verification->stream_formats);
+  stream->first_ts = stream->end_ts = GST_CLOCK_TIME_NONE;
+  stream->last_keyframe = GST_CLOCK_TIME_NONE;
+
+  g_mutex_lock (&verification->lock);
+  g_ptr_array_add (verification->streams, stream);
+  g_mutex_unlock (&verification->lock);
+
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER,
+      (GstPadProbeCallback) _verified_buffer_probe, stream, NULL);
+
+  g_object_set (fakesink, "sync", FALSE, "async", FALSE, NULL);
+  gst_bin_add (GST_BIN (verification->bin), fakesink);
+  gst_element_sync_state_with_parent (fakesink);
+
+  sinkpad = gst_element_get_static_pad (fakesink, "sink");
+  gst_pad_link (pad, sinkpad);
+  gst_object_unref (sinkpad);
+}
+
+static GstCaps *
+_encoding_profile_get_stream_formats (GstEncodingProfile * profile)
+{
+  const GList *tmp;
+  GstCaps *formats;
+
+  if (!GST_IS_ENCODING_CONTAINER_PROFILE (profile))
+    return gst_encoding_profile_get_format (profile);
+
+  formats = gst_caps_new_empty ();
+  for (tmp = gst_encoding_container_profile_get_profiles
+      (GST_ENCODING_CONTAINER_PROFILE (profile)); tmp; tmp = tmp->next)
+    gst_caps_append (formats, gst_encoding_profile_get_format (tmp->data));
+
+  return formats;
+}
+
+/* Returns the element the encoded output should be sent to */
+static GstElement *
+output_verification_new (TranscodingBranch * branch)
+{
+  GstPad *pad, *ghostpad;
+  GstCaps *decodebin_caps;
+  GstElement *queue, *decodebin;
+  OutputVerification *verification = g_slice_new0 (OutputVerification);
+
+  verification->bin = gst_bin_new ("verification");
+  /* decodebin only prerolls once it exposed its streams, which some
+   * formats only allow once the whole file is written, the pipeline must
+   * not wait for it */
+  g_object_set (verification->bin, "async-handling", TRUE, NULL);
+  verification->stream_formats =
+      _encoding_profile_get_stream_formats (branch->profile);
+  verification->streams = g_ptr_array_new_with_free_func ((GDestroyNotify)
+      _verified_stream_free);
+  g_mutex_init (&verification->lock);
+
+  /* Unlimited, the verification branch never blocks the encoding */
+  queue = gst_element_factory_make ("queue", NULL);
+  g_object_set (queue, "max-size-buffers", 0, "max-size-bytes", 0,
+      "max-size-time", (guint64) 0, NULL);
+
+  /* Streams that do not match the profile are decoded, so that they are
+   * exposed too */
+  decodebin = gst_element_factory_make ("decodebin", NULL);
+  decodebin_caps = gst_caps_copy (verification->stream_formats);
+  gst_caps_append (decodebin_caps,
+      gst_caps_from_string ("video/x-raw;audio/x-raw"));
+  g_object_set (decodebin, "caps", decodebin_caps, NULL);
+  gst_caps_unref (decodebin_caps);
+  g_signal_connect (decodebin, "pad-added",
+      G_CALLBACK (_verification_pad_added_cb), verification);
+
+  gst_bin_add_many (GST_BIN (verification->bin), queue, decodebin, NULL);
+  gst_element_link (queue, decodebin);
+
+  pad = gst_element_get_static_pad (queue, "sink");
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_DATA_DOWNSTREAM,
+      (GstPadProbeCallback) _drop_if_failed_probe, verification, NULL);
+  ghostpad = gst_ghost_pad_new ("sink", pad);
+  gst_object_unref (pad);
+  gst_element_add_pad (verification->bin, ghostpad);
+
+  branch->verification = verification;
+
+  return verification->bin;
+}
+
+/* Called from the thread posting the error, so that the buffers stop being
+ * sent to the verification elements before the error is returned upstream */
+static void
+_verification_error_cb (GstBus * bus, GstMessage * message, gpointer unused)
+{
+  TranscodingBranch *branch = find_branch (GST_MESSAGE_SRC (message));
+
+  if (branch && branch->verification &&
+      gst_object_has_ancestor (GST_MESSAGE_SRC (message),
+          GST_OBJECT (branch->verification->bin)))
+    g_atomic_int_set (&branch->verification->failed, TRUE);
+}
+
+/* Whether the error comes from a verification branch, which is then
+ * removed so that the transcoding goes on without it */
+static gboolean
+handle_verification_error (GstMessage * message)
+{
+  GError *err;
+  TranscodingBranch *branch = find_branch (GST_MESSAGE_SRC (message));
+  OutputVerification *verification;
+
+  if (!branch || !branch->verification ||
+      !gst_object_has_ancestor (GST_MESSAGE_SRC (message),
+          GST_OBJECT (branch->verification->bin)))
+    return FALSE;
+
+  verification = branch->verification;
+  if (verification->failure)
+    return TRUE;
+
+  gst_message_parse_error (message, &err, NULL);
+  verification->failure = g_strdup (err->message);
+  g_print ("Output %u (%s) can not be verified while it is written: %s\n",
+      branch->index, branch->output_uri, err->message);
+  g_error_free (err);
+
+  gst_element_set_locked_state (verification->bin, TRUE);
+  gst_element_set_state (verification->bin, GST_STATE_NULL);
+  gst_bin_remove (GST_BIN (branch->bin), verification->bin);
+
+  return TRUE;
+}
+
+/* Checks the streams seen in each output against its encoding profile and
+ * the number of streams sent to encodebin, once the pipeline stopped */
+static void
+report_output_verification (GstValidateMonitor * monitor, GString * output)
+{
+  guint i, j;
+
+  for (i = 0; i < branches->len; i++) {
+    TranscodingBranch *branch = g_ptr_array_index (branches, i);
+    OutputVerification *verification = branch->verification;
+    GstClockTime duration = 0, max_keyframe_interval = 0;
+    guint n_streams = g_atomic_int_get (&branch->n_streams);
+    gboolean duration_ok = TRUE;
+    GstStructure *structure;
+    gchar *str;
+
+    if (verification == NULL)
+      continue;
+
+    g_mutex_lock (&verification->lock);
+    for (j = 0; j < verification->streams->len; j++) {
+      VerifiedStream *stream = g_ptr_array_index (verification->streams, j);
+      gchar *caps = gst_caps_to_string (stream->caps);
+
+      if (!stream->matches_profile)
+        GST_VALIDATE_REPORT (monitor, FILE_PROFILE_INCORRECT,
+            "Stream %u of %s has caps %s, which are not in its encoding "
+            "profile", j, branch->output_uri, caps);
+      else if (stream->n_frames && !stream->first_is_keyframe)
+        GST_VALIDATE_REPORT (monitor, FILE_KEY_FRAMES_INCORRECT,
+            "Stream %u (%s) of %s does not start with a key frame", j, caps,
+            branch->output_uri);
+      else if (stream->n_frames && !stream->n_keyframes)
+        GST_VALIDATE_REPORT (monitor, FILE_KEY_FRAMES_INCORRECT,
+            "Stream %u (%s) of %s does not contain any key frame", j, caps,
+            branch->output_uri);
+      g_free (caps);
+
+      if (GST_CLOCK_TIME_IS_VALID (stream->first_ts))
+        duration = MAX (duration, stream->end_ts - stream->first_ts);
+      max_keyframe_interval = MAX (max_keyframe_interval,
+          stream->max_keyframe_interval);
+    }
+
+    if (verification->failure == NULL) {
+      if (verification->streams->len != n_streams)
+        GST_VALIDATE_REPORT (monitor, FILE_PROFILE_INCORRECT,
+            "%s contains %u streams, %u were encoded", branch->output_uri,
+            verification->streams->len, n_streams);
+
+      if (expected_duration >= 0 &&
+          ABS ((gint64) duration - expected_duration) > duration_tolerance) {
+        duration_ok = FALSE;
+        GST_VALIDATE_REPORT (monitor, FILE_DURATION_INCORRECT,
+            "%s lasts %" GST_TIME_FORMAT " instead of %" GST_TIME_FORMAT,
+            branch->output_uri, GST_TIME_ARGS (duration),
+            GST_TIME_ARGS (expected_duration));
+      }
+    }
+
+    structure = gst_structure_new ("output-verification",
+        "output", G_TYPE_UINT, branch->index,
+        "verified", G_TYPE_BOOLEAN, verification->failure == NULL,
+        "streams", G_TYPE_UINT, verification->streams->len,
+        "encoded-streams", G_TYPE_UINT, n_streams,
+        "duration", G_TYPE_UINT64, duration,
+        "duration-ok", G_TYPE_BOOLEAN, duration_ok,
+        "max-keyframe-interval", G_TYPE_UINT64, max_keyframe_interval, NULL);
+    g_mutex_unlock (&verification->lock);
+
+    str = gst_structure_to_string (structure);
+    g_string_append_printf (output, "%s\n", str);
+    g_free (str);
+    gst_structure_free (structure);
+  }
+}
+
 typedef struct
 {
   volatile gint refcount;
@@ -61,9 +433,17 @@ typedef struct
   /* FIXME Do we need a weak ref here? */
   GstValidateScenario *scenario;
   guint count_bufs;
+  guint max_delta_frames;
   gboolean seen_event;
   GstClockTime running_time;
 
+  /* Running time of the last buffer the encoder pushed */
+  GstClockTime last_running_time;
+  /* When the event went through the encoder pad, in wall clock and running
+   * time, latencies are measured from there */
+  GstClockTime event_time;
+  GstClockTime event_running_time;
+
   /* Make sure to remove all probes when we are done */
   gboolean done;
 
@@ -72,10 +452,21 @@ typedef struct
 /* This is used to
  *  1) Make sure we receive the event
  *  2) Count the number of frames that were not KF seen after the event
+ *  3) Measure the latency of the key unit
  */
 #define FORCE_KF_DATA_NAME "force-key-unit"
 #define NOT_KF_AFTER_FORCE_KF_EVT_TOLERANCE 1
 
+/* Key unit latencies of all the requests, the delta frames counts are
+ * stored as GstClockTime too */
+static GstValidateHistogram *key_unit_wall_latency = NULL;
+static GstValidateHistogram *key_unit_running_latency = NULL;
+static GstValidateHistogram *key_unit_delta_frames = NULL;
+static GMutex key_unit_stats_lock;
+
+static gdouble max_key_unit_latency = 0.0;
+static gdouble key_unit_latency_percentile = 95.0;
+
 #ifdef G_OS_UNIX
 static gboolean
 intr_handler (gpointer user_data)
@@ -119,51 +510,101 @@ key_unit_data_new (GstValidateScenario *scenario, GstClockTime running_time)
 
   info->scenario = scenario;
   info->running_time = running_time;
+  info->last_running_time = GST_CLOCK_TIME_NONE;
+  info->max_delta_frames = NOT_KF_AFTER_FORCE_KF_EVT_TOLERANCE;
 
   return info;
 }
 
+static void
+key_unit_stats_add (KeyUnitProbeInfo * kuinfo, GstClockTime running_time)
+{
+  GstClockTime wall_latency = gst_util_get_timestamp () - kuinfo->event_time;
+  GstClockTime running_latency = GST_CLOCK_TIME_NONE;
+
+  /* When no buffer went through before the event, there is no running
+   * time to measure from */
+  if (GST_CLOCK_TIME_IS_VALID (running_time) &&
+      GST_CLOCK_TIME_IS_VALID (kuinfo->event_running_time)) {
+    running_latency = running_time > kuinfo->event_running_time ?
+        running_time - kuinfo->event_running_time : 0;
+  }
+
+  GST_DEBUG_OBJECT (kuinfo->scenario,
+      "Properly got keyframe after \"force-keyframe\" event "
+      "with running_time %" GST_TIME_FORMAT " (latency %d frame(s), %"
+      GST_TIME_FORMAT " of running time, %" GST_TIME_FORMAT
+      " of wall clock time)", GST_TIME_ARGS (kuinfo->running_time),
+      kuinfo->count_bufs, GST_TIME_ARGS (running_latency),
+      GST_TIME_ARGS (wall_latency));
+
+  g_mutex_lock (&key_unit_stats_lock);
+  if (key_unit_wall_latency == NULL) {
+    key_unit_wall_latency = gst_validate_histogram_new ();
+    key_unit_running_latency = gst_validate_histogram_new ();
+    key_unit_delta_frames = gst_validate_histogram_new ();
+  }
+  gst_validate_histogram_add (key_unit_wall_latency, wall_latency);
+  if (GST_CLOCK_TIME_IS_VALID (running_latency))
+    gst_validate_histogram_add (key_unit_running_latency, running_latency);
+  gst_validate_histogram_add (key_unit_delta_frames, kuinfo->count_bufs);
+  g_mutex_unlock (&key_unit_stats_lock);
+}
+
 static GstPadProbeReturn
 _check_is_key_unit_cb (GstPad * pad, GstPadProbeInfo * info, KeyUnitProbeInfo *kuinfo)
 {
   if (GST_IS_EVENT (GST_PAD_PROBE_INFO_DATA (info))) {
-    if (gst_video_event_is_force_key_unit (GST_PAD_PROBE_INFO_DATA (info)))
+    /* Only the first event is the request, the encoder sends its own
+     * force key unit event downstream once it handled it */
+    if (gst_video_event_is_force_key_unit (GST_PAD_PROBE_INFO_DATA (info))
+        && !kuinfo->seen_event) {
       kuinfo->seen_event = TRUE;
-    else if (GST_EVENT_TYPE (info->data) == GST_EVENT_SEGMENT &&
+      kuinfo->event_time = gst_util_get_timestamp ();
+
+      /* The key unit is wanted at the requested running time, or as soon
+       * as possible */
+      if (GST_CLOCK_TIME_IS_VALID (kuinfo->running_time))
+        kuinfo->event_running_time = kuinfo->running_time;
+      else
+        kuinfo->event_running_time = kuinfo->last_running_time;
+    } else if (GST_EVENT_TYPE (info->data) == GST_EVENT_SEGMENT &&
         GST_PAD_DIRECTION (pad) == GST_PAD_SRC) {
       const GstSegment *segment = NULL;
 
       gst_event_parse_segment (info->data, &segment);
       kuinfo->segment = *segment;
     }
-  } else if (GST_IS_BUFFER (GST_PAD_PROBE_INFO_DATA (info)) && kuinfo->seen_event) {
+  } else if (GST_IS_BUFFER (GST_PAD_PROBE_INFO_DATA (info))) {
+     GstClockTime running_time = gst_segment_to_running_time (&kuinfo->segment,
+         GST_FORMAT_TIME, GST_BUFFER_TIMESTAMP (info->data));
 
-     if (GST_CLOCK_TIME_IS_VALID (kuinfo->running_time)) {
-       GstClockTime running_time = gst_segment_to_running_time (&kuinfo->segment,
-           GST_FORMAT_TIME, GST_BUFFER_TIMESTAMP (info->data));
+     if (!kuinfo->seen_event) {
+       kuinfo->last_running_time = running_time;
+
+       return GST_PAD_PROBE_OK;
+     }
 
+     if (GST_CLOCK_TIME_IS_VALID (kuinfo->running_time)) {
        if (running_time < kuinfo->running_time)
          return GST_PAD_PROBE_OK;
      }
 
      if (GST_BUFFER_FLAG_IS_SET (GST_PAD_PROBE_INFO_BUFFER (info), GST_BUFFER_FLAG_DELTA_UNIT)) {
-       if (kuinfo->count_bufs >= NOT_KF_AFTER_FORCE_KF_EVT_TOLERANCE) {
+       if (kuinfo->count_bufs >= kuinfo->max_delta_frames) {
          GST_VALIDATE_REPORT (kuinfo->scenario,
              SCENARIO_ACTION_EXECUTION_ERROR,
              "Did not receive a key frame after requested one, "
              " at running_time %" GST_TIME_FORMAT " (with a %i "
              "frame tolerance)", GST_TIME_ARGS (kuinfo->running_time),
-             NOT_KF_AFTER_FORCE_KF_EVT_TOLERANCE);
+             kuinfo->max_delta_frames);
 
          return GST_PAD_PROBE_REMOVE;
        }
 
        kuinfo->count_bufs++;
      } else {
-       GST_DEBUG_OBJECT (kuinfo->scenario,
-           "Properly got keyframe after \"force-keyframe\" event "
-           "with running_time %" GST_TIME_FORMAT " (latency %d frame(s))",
-           GST_TIME_ARGS (kuinfo->running_time), kuinfo->count_bufs);
+       key_unit_stats_add (kuinfo, running_time);
 
        return GST_PAD_PROBE_REMOVE;
      }
@@ -194,7 +635,7 @@ static gboolean
 _execute_request_key_unit (GstValidateScenario * scenario,
     GstValidateAction * action)
 {
-  guint count;
+  guint count, max_delta_frames;
   GstIterator *iter;
   gboolean all_headers;
 
@@ -208,8 +649,20 @@ _execute_request_key_unit (GstValidateScenario * scenario,
   GstClockTime running_time = GST_CLOCK_TIME_NONE;
   const gchar *direction = gst_structure_get_string (action->structure,
       "direction");
+  TranscodingBranch *branch;
+  gint output = 0;
+
+  /* Outputs are numbered in the order they were given */
+  gst_structure_get_int (action->structure, "output", &output);
+  if (output < 0 || output >= branches->len) {
+    GST_VALIDATE_REPORT (scenario, SCENARIO_ACTION_EXECUTION_ERROR,
+        "No output %d, only %u were given", output, branches->len);
+
+    return FALSE;
+  }
+  branch = g_ptr_array_index (branches, output);
 
-  iter = gst_bin_iterate_recurse (GST_BIN (encodebin));
+  iter = gst_bin_iterate_recurse (GST_BIN (branch->encodebin));
   if (!gst_iterator_find_custom (iter,
           (GCompareFunc) _find_video_encoder, &result,NULL)) {
     g_error ("Could not find any video encode");
@@ -246,7 +699,26 @@ _execute_request_key_unit (GstValidateScenario * scenario,
     }
   }
 
+  if (!gst_structure_get_uint (action->structure, "max-delta-frames",
+          &max_delta_frames)) {
+    gint signed_max_delta_frames;
+
+    if (!gst_structure_get_int (action->structure, "max-delta-frames",
+            &signed_max_delta_frames)) {
+      max_delta_frames = NOT_KF_AFTER_FORCE_KF_EVT_TOLERANCE;
+    } else if (signed_max_delta_frames < 0) {
+      GST_VALIDATE_REPORT (scenario, SCENARIO_ACTION_EXECUTION_ERROR,
+          "max-delta-frames can not be negative (%d)",
+          signed_max_delta_frames);
+
+      goto fail;
+    } else {
+      max_delta_frames = signed_max_delta_frames;
+    }
+  }
+
   info = key_unit_data_new (scenario, running_time);
+  info->max_delta_frames = max_delta_frames;
   if (g_strcmp0 (direction, "upstream") == 0) {
     event = gst_video_event_new_upstream_force_key_unit (running_time,
         all_headers, count);
@@ -331,6 +803,8 @@ static gboolean
 _execute_set_restriction (GstValidateScenario * scenario,
     GstValidateAction * action)
 {
+  guint i;
+  gboolean found = FALSE;
   GstCaps *caps;
   GType profile_type = G_TYPE_NONE;
   const gchar *restriction_caps, *profile_type_name, *profile_name;
@@ -375,13 +849,18 @@ _execute_set_restriction (GstValidateScenario * scenario,
     return FALSE;
   }
 
-  if (GST_IS_ENCODING_CONTAINER_PROFILE (encoding_profile)) {
-    gboolean found = FALSE;
+  /* Applies to all the outputs that have a matching profile */
+  for (i = 0; i < branches->len; i++) {
     const GList *tmp;
+    GstEncodingProfile *output_profile =
+        ((TranscodingBranch *) g_ptr_array_index (branches, i))->profile;
+
+    if (!GST_IS_ENCODING_CONTAINER_PROFILE (output_profile))
+      continue;
 
     for (tmp =
         gst_encoding_container_profile_get_profiles
-        (GST_ENCODING_CONTAINER_PROFILE (encoding_profile)); tmp;
+        (GST_ENCODING_CONTAINER_PROFILE (output_profile)); tmp;
         tmp = tmp->next) {
       GstEncodingProfile *profile = tmp->data;
 
@@ -396,16 +875,16 @@ _execute_set_restriction (GstValidateScenario * scenario,
         found = TRUE;
       }
     }
+  }
 
-    if (!found) {
-      g_error ("Could not find profile for %s%s",
-          profile_type_name ? profile_type_name : "",
-          profile_name ? profile_name : "");
-
-      gst_caps_unref (caps);
-      return FALSE;
+  /* Outputs without such a profile keep their caps */
+  if (!found) {
+    g_error ("Could not find profile for %s%s",
+        profile_type_name ? profile_type_name : "",
+        profile_name ? profile_name : "");
 
-    }
+    gst_caps_unref (caps);
+    return FALSE;
   }
 
   if (profile_type != G_TYPE_NONE) {
@@ -426,7 +905,7 @@ static gboolean
 print_position (void)
 {
   GstQuery *query;
-  gint64 position, duration;
+  gint64 position = -1, duration = -1;
 
   gdouble rate = 1.0;
   GstFormat format = GST_FORMAT_TIME;
@@ -444,6 +923,8 @@ print_position (void)
   g_print ("<position: %" GST_TIME_FORMAT " duration: %" GST_TIME_FORMAT
       " speed: %f />\r", GST_TIME_ARGS (position), GST_TIME_ARGS (duration),
       rate);
+  if (progress)
+    gst_validate_progress_set_position (progress, position, duration, rate);
 
   return TRUE;
 }
@@ -460,6 +941,8 @@ bus_callback (GstBus * bus, GstMessage * message, gpointer data)
         GstState old, new, pending;
 
         gst_message_parse_state_changed (message, &old, &new, &pending);
+        if (progress)
+          gst_validate_progress_set_state (progress, new);
 
         if (new == GST_STATE_PLAYING) {
           if (print_pos_srcid == 0)
@@ -482,10 +965,19 @@ bus_callback (GstBus * bus, GstMessage * message, gpointer data)
     {
       GError *err;
       gchar *debug;
+      TranscodingBranch *branch;
+
+      if (handle_verification_error (message))
+        break;
+
       ret = -1;
       gst_message_parse_error (message, &err, &debug);
       g_print ("Error: %s %s\n", GST_OBJECT_NAME (GST_MESSAGE_SRC (message)),
           err->message);
+      branch = find_branch (GST_MESSAGE_SRC (message));
+      if (branch && branches->len > 1)
+        g_print ("  while encoding output %u (%s)\n", branch->index,
+            branch->output_uri);
       GST_DEBUG_BIN_TO_DOT_FILE_WITH_TS (GST_BIN (pipeline),
           GST_DEBUG_GRAPH_SHOW_ALL, "gst-validate-transcode.error");
       g_error_free (err);
@@ -505,6 +997,8 @@ bus_callback (GstBus * bus, GstMessage * message, gpointer data)
 
       gst_message_parse_buffering (message, &percent);
       g_print ("%s %d%%  \r", "Buffering...", percent);
+      if (progress)
+        gst_validate_progress_set_buffering (progress, percent);
 
       /* no state management needed for live pipelines */
       if (is_live)
@@ -536,63 +1030,540 @@ bus_callback (GstBus * bus, GstMessage * message, gpointer data)
   return TRUE;
 }
 
+/* Transcoding performance: every encoder output is probed to know how
+ * fast each stream is encoded, and the CPU time of each streaming thread
+ * is measured between the moment it enters and leaves its task */
+typedef struct
+{
+  TranscodingBranch *branch;
+  gchar *encoder;
+
+  guint64 n_buffers;
+  guint64 bytes;
+  /* Wall clock time since the pipeline was started */
+  GstClockTime first_buffer;
+  GstClockTime last_buffer;
+  /* Span of media time that was encoded */
+  GstClockTime first_pts;
+  GstClockTime last_pts;
+
+  /* guint64, bytes encoded for each second of media */
+  GArray *bytes_per_second;
+} EncodedStreamStats;
+
+#define ENCODED_STREAM_STATS_NAME "validate-encoded-stream-stats"
+
+static GstClockTime start_time = GST_CLOCK_TIME_NONE;
+static gdouble min_realtime_factor = 0.0;
+static gchar *stats_file = NULL;
+
+/* EncodedStreamStats, only added to while the pipeline starts */
+static GPtrArray *encoded_streams = NULL;
+static GMutex encoded_streams_lock;
+
+/* Element name -> CPU time, in nanoseconds, of the threads it started */
+static GHashTable *elements_cpu_time = NULL;
+static GMutex elements_cpu_time_lock;
+
+typedef struct
+{
+  gchar *element;
+  GstClockTime cpu_time;
+} StreamingThreadStart;
+
 static void
-pad_added_cb (GstElement * uridecodebin, GstPad * pad, GstElement * encodebin)
+_streaming_thread_start_free (StreamingThreadStart * start)
 {
-  GstCaps *caps;
-  GstPad *sinkpad = NULL;
+  g_free (start->element);
+  g_slice_free (StreamingThreadStart, start);
+}
 
-  caps = gst_pad_query_caps (pad, NULL);
+static GPrivate streaming_thread_start =
+G_PRIVATE_INIT ((GDestroyNotify) _streaming_thread_start_free);
 
-  /* Ask encodebin for a compatible pad */
-  GST_DEBUG_OBJECT (uridecodebin, "Pad added, caps: %" GST_PTR_FORMAT, caps);
+static void
+_encoded_stream_stats_free (EncodedStreamStats * stats)
+{
+  g_free (stats->encoder);
+  g_array_unref (stats->bytes_per_second);
+  g_slice_free (EncodedStreamStats, stats);
+}
 
-  g_signal_emit_by_name (encodebin, "request-pad", caps, &sinkpad);
-  if (caps)
-    gst_caps_unref (caps);
+static GstPadProbeReturn
+_encoded_buffer_probe (GstPad * pad, GstPadProbeInfo * info,
+    EncodedStreamStats * stats)
+{
+  GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+  GstClockTime now = gst_util_get_timestamp () - start_time;
+  GstClockTime pts = GST_BUFFER_PTS (buffer);
+  gsize size = gst_buffer_get_size (buffer);
+
+  if (stats->n_buffers++ == 0)
+    stats->first_buffer = now;
+  stats->last_buffer = now;
+  stats->bytes += size;
+
+  if (GST_CLOCK_TIME_IS_VALID (pts)) {
+    guint second;
+
+    if (!GST_CLOCK_TIME_IS_VALID (stats->first_pts) || pts < stats->first_pts)
+      stats->first_pts = pts;
+    if (GST_BUFFER_DURATION_IS_VALID (buffer))
+      pts += GST_BUFFER_DURATION (buffer);
+    if (!GST_CLOCK_TIME_IS_VALID (stats->last_pts) || pts > stats->last_pts)
+      stats->last_pts = pts;
+
+    second = (GST_BUFFER_PTS (buffer) - stats->first_pts) / GST_SECOND;
+    if (second >= stats->bytes_per_second->len)
+      g_array_set_size (stats->bytes_per_second, second + 1);
+    g_array_index (stats->bytes_per_second, guint64, second) += size;
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+static gint
+_find_untracked_encoder (GValue * velement, gpointer udata)
+{
+  GstElement *element = g_value_get_object (velement);
+  const gchar *klass =
+      gst_element_class_get_metadata (GST_ELEMENT_GET_CLASS (element),
+      GST_ELEMENT_METADATA_KLASS);
+
+  if (g_strstr_len (klass, -1, "Encoder")
+      && !g_object_get_data (G_OBJECT (element), ENCODED_STREAM_STATS_NAME))
+    return 0;
+
+  return !0;
+}
+
+/* Called once encodebin created the elements for a new stream */
+static void
+track_new_encoders (TranscodingBranch * branch)
+{
+  GValue result = { 0, };
+  GstIterator *iter = gst_bin_iterate_recurse (GST_BIN (branch->encodebin));
+
+  while (gst_iterator_find_custom (iter,
+          (GCompareFunc) _find_untracked_encoder, &result, NULL)) {
+    GstElement *encoder = g_value_get_object (&result);
+    GstPad *srcpad = gst_element_get_static_pad (encoder, "src");
+    EncodedStreamStats *stats = g_slice_new0 (EncodedStreamStats);
+
+    stats->branch = branch;
+    stats->encoder = gst_object_get_name (GST_OBJECT (encoder));
+    stats->first_pts = stats->last_pts = GST_CLOCK_TIME_NONE;
+    stats->bytes_per_second = g_array_new (FALSE, TRUE, sizeof (guint64));
+    g_object_set_data (G_OBJECT (encoder), ENCODED_STREAM_STATS_NAME, stats);
+
+    g_mutex_lock (&encoded_streams_lock);
+    g_ptr_array_add (encoded_streams, stats);
+    g_mutex_unlock (&encoded_streams_lock);
+
+    if (srcpad) {
+      gst_pad_add_probe (srcpad, GST_PAD_PROBE_TYPE_BUFFER,
+          (GstPadProbeCallback) _encoded_buffer_probe, stats, NULL);
+      gst_object_unref (srcpad);
+    } else {
+      GST_FIXME ("Implement weird encoder management");
+    }
+
+    g_value_reset (&result);
+    gst_iterator_resync (iter);
+  }
+  g_value_unset (&result);
+  gst_iterator_free (iter);
+}
+
+static GstClockTime
+_get_thread_cpu_time (void)
+{
+#if defined (G_OS_UNIX) && defined (RUSAGE_THREAD)
+  struct rusage usage;
+
+  if (getrusage (RUSAGE_THREAD, &usage) == 0)
+    return GST_TIMEVAL_TO_TIME (usage.ru_utime) +
+        GST_TIMEVAL_TO_TIME (usage.ru_stime);
+#endif
+
+  return GST_CLOCK_TIME_NONE;
+}
+
+/* Runs in the streaming threads themselves */
+static void
+_stream_status_cb (GstBus * bus, GstMessage * message, gpointer unused)
+{
+  GstStreamStatusType type;
+  GstElement *owner;
+  StreamingThreadStart *start;
+  GstClockTime cpu_time;
+
+  gst_message_parse_stream_status (message, &type, &owner);
+  if (type == GST_STREAM_STATUS_TYPE_ENTER) {
+    if (!GST_CLOCK_TIME_IS_VALID (cpu_time = _get_thread_cpu_time ()))
+      return;
+
+    start = g_slice_new0 (StreamingThreadStart);
+    start->element = gst_object_get_name (GST_OBJECT (owner));
+    start->cpu_time = cpu_time;
+    g_private_replace (&streaming_thread_start, start);
+  } else if (type == GST_STREAM_STATUS_TYPE_LEAVE) {
+    GstClockTime *total;
+
+    if (!(start = g_private_get (&streaming_thread_start)))
+      return;
+
+    cpu_time = _get_thread_cpu_time () - start->cpu_time;
+    g_mutex_lock (&elements_cpu_time_lock);
+    if (!(total = g_hash_table_lookup (elements_cpu_time, start->element))) {
+      total = g_new0 (GstClockTime, 1);
+      g_hash_table_insert (elements_cpu_time, g_strdup (start->element),
+          total);
+    }
+    *total += cpu_time;
+    g_mutex_unlock (&elements_cpu_time_lock);
+
+    g_private_replace (&streaming_thread_start, NULL);
+  }
+}
+
+static void
+setup_transcoding_stats (GstBus * bus)
+{
+  encoded_streams = g_ptr_array_new_with_free_func ((GDestroyNotify)
+      _encoded_stream_stats_free);
+  elements_cpu_time = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+      g_free);
+
+  gst_bus_enable_sync_message_emission (bus);
+  g_signal_connect (bus, "sync-message::stream-status",
+      (GCallback) _stream_status_cb, NULL);
+}
+
+static gdouble
+_encoded_stream_realtime_factor (EncodedStreamStats * stats)
+{
+  if (!GST_CLOCK_TIME_IS_VALID (stats->first_pts) || !stats->last_buffer)
+    return 0.0;
+
+  return gst_guint64_to_gdouble (stats->last_pts - stats->first_pts) /
+      gst_guint64_to_gdouble (stats->last_buffer);
+}
+
+static void
+_structure_set_percentiles (GstStructure * structure, const gchar * prefix,
+    GstValidateHistogram * histogram)
+{
+  guint i;
+  const gdouble percentiles[] = { 50, 90, 99, 100 };
+  const gchar *names[] = { "p50", "p90", "p99", "max" };
+
+  for (i = 0; i < G_N_ELEMENTS (percentiles); i++) {
+    gchar *name = g_strdup_printf ("%s-%s", prefix, names[i]);
+
+    gst_structure_set (structure, name, G_TYPE_UINT64,
+        gst_validate_histogram_get_percentile (histogram, percentiles[i]),
+        NULL);
+    g_free (name);
+  }
+}
+
+/* Aggregates the latencies of all the key unit requests, the budget applies
+ * to the running time latency, the wall clock one depends on how fast the
+ * machine encodes */
+static void
+report_key_unit_stats (GstValidateMonitor * monitor, GString * output)
+{
+  GstStructure *structure;
+  GstClockTime latency;
+  gchar *str;
+
+  g_mutex_lock (&key_unit_stats_lock);
+  structure = gst_structure_new ("key-unit-latency",
+      "requests", G_TYPE_UINT,
+      gst_validate_histogram_get_count (key_unit_wall_latency), NULL);
+  _structure_set_percentiles (structure, "running-time",
+      key_unit_running_latency);
+  _structure_set_percentiles (structure, "wall-clock", key_unit_wall_latency);
+  _structure_set_percentiles (structure, "delta-frames",
+      key_unit_delta_frames);
+  latency = gst_validate_histogram_get_percentile (key_unit_running_latency,
+      key_unit_latency_percentile);
+  g_mutex_unlock (&key_unit_stats_lock);
+
+  str = gst_structure_to_string (structure);
+  g_string_append_printf (output, "%s\n", str);
+  g_free (str);
+  gst_structure_free (structure);
+
+  if (max_key_unit_latency > 0 && GST_CLOCK_TIME_IS_VALID (latency)
+      && latency > max_key_unit_latency * GST_SECOND)
+    GST_VALIDATE_REPORT (monitor, EVENT_KEY_UNIT_LATENCY_OVER_BUDGET,
+        "%.1f%% of the key units came within %" GST_TIME_FORMAT
+        " of running time after being requested, the budget is %.3fs",
+        key_unit_latency_percentile, GST_TIME_ARGS (latency),
+        max_key_unit_latency);
+}
+
+/* Prints one GstStructure per encoded stream and per element that started
+ * a streaming thread, and checks the realtime factors. Has to be called
+ * once the pipeline has been stopped, so that the streaming threads are
+ * all done */
+static void
+report_transcoding_stats (GstValidateMonitor * monitor)
+{
+  guint i;
+  GString *output = g_string_new (NULL);
+  GList *names, *tmp;
+
+  for (i = 0; i < encoded_streams->len; i++) {
+    EncodedStreamStats *stats = g_ptr_array_index (encoded_streams, i);
+    gdouble realtime_factor = _encoded_stream_realtime_factor (stats);
+    gdouble elapsed = gst_guint64_to_gdouble (stats->last_buffer) / GST_SECOND;
+    GValue bitrate = { 0, }, kbps = { 0, };
+    GstStructure *structure;
+    gchar *str;
+    guint j;
+
+    g_value_init (&bitrate, GST_TYPE_ARRAY);
+    g_value_init (&kbps, G_TYPE_UINT);
+    for (j = 0; j < stats->bytes_per_second->len; j++) {
+      g_value_set_uint (&kbps, g_array_index (stats->bytes_per_second,
+              guint64, j) * 8 / 1000);
+      gst_value_array_append_value (&bitrate, &kbps);
+    }
 
+    structure = gst_structure_new ("encoded-stream",
+        "output", G_TYPE_UINT, stats->branch->index,
+        "encoder", G_TYPE_STRING, stats->encoder,
+        "buffers", G_TYPE_UINT64, stats->n_buffers,
+        "bytes", G_TYPE_UINT64, stats->bytes,
+        "fps", G_TYPE_DOUBLE, elapsed > 0 ? stats->n_buffers / elapsed : 0.0,
+        "realtime-factor", G_TYPE_DOUBLE, realtime_factor,
+        "first-buffer", G_TYPE_UINT64, stats->n_buffers ?
+        stats->first_buffer : GST_CLOCK_TIME_NONE, NULL);
+    gst_structure_take_value (structure, "bitrate", &bitrate);
+    g_value_unset (&kbps);
+
+    str = gst_structure_to_string (structure);
+    g_string_append_printf (output, "%s\n", str);
+    g_free (str);
+    gst_structure_free (structure);
+
+    if (min_realtime_factor > 0 && stats->n_buffers
+        && realtime_factor < min_realtime_factor)
+      GST_VALIDATE_REPORT (monitor, REALTIME_FACTOR_UNDER_BUDGET,
+          "%s encoded at %.2fx realtime for %s, the minimum is %.2fx",
+          stats->encoder, realtime_factor, stats->branch->output_uri,
+          min_realtime_factor);
+  }
+
+  for (i = 0; i < branches->len; i++) {
+    TranscodingBranch *branch = g_ptr_array_index (branches, i);
+    GstStructure *structure = gst_structure_new ("output",
+        "index", G_TYPE_UINT, branch->index,
+        "uri", G_TYPE_STRING, branch->output_uri,
+        "issues", G_TYPE_INT, g_atomic_int_get (&branch->n_reports), NULL);
+    gchar *str = gst_structure_to_string (structure);
+
+    g_string_append_printf (output, "%s\n", str);
+    g_free (str);
+    gst_structure_free (structure);
+  }
+
+  if (key_unit_wall_latency)
+    report_key_unit_stats (monitor, output);
+
+  if (verify_output)
+    report_output_verification (monitor, output);
+
+  names = g_hash_table_get_keys (elements_cpu_time);
+  names = g_list_sort (names, (GCompareFunc) g_strcmp0);
+  for (tmp = names; tmp; tmp = tmp->next) {
+    GstStructure *structure = gst_structure_new ("streaming-thread",
+        "element", G_TYPE_STRING, tmp->data,
+        "cpu-time", G_TYPE_UINT64,
+        *(GstClockTime *) g_hash_table_lookup (elements_cpu_time, tmp->data),
+        NULL);
+    gchar *str = gst_structure_to_string (structure);
+
+    g_string_append_printf (output, "%s\n", str);
+    g_free (str);
+    gst_structure_free (structure);
+  }
+  g_list_free (names);
+
+  g_print ("\nTranscoding statistics:\n%s", output->str);
+  if (stats_file && !g_file_set_contents (stats_file, output->str, -1, NULL))
+    g_printerr ("Could not write statistics to %s\n", stats_file);
+  g_string_free (output, TRUE);
+}
+
+/* Links @srcpad to a new encoding pad of @branch, through a queue when
+ * the stream is shared with other outputs */
+static gboolean
+link_to_branch (GstPad * srcpad, GstCaps * caps, TranscodingBranch * branch,
+    gboolean with_queue)
+{
+  GstPad *sinkpad = NULL, *ghostpad;
+
+  /* Ask encodebin for a compatible pad */
+  g_signal_emit_by_name (branch->encodebin, "request-pad", caps, &sinkpad);
   if (sinkpad == NULL) {
-    GST_WARNING ("Couldn't get an encoding pad for pad %s:%s\n",
-        GST_DEBUG_PAD_NAME (pad));
-    return;
+    GST_WARNING ("Couldn't get an encoding pad for pad %s:%s on output %u\n",
+        GST_DEBUG_PAD_NAME (srcpad), branch->index);
+    return FALSE;
   }
 
-  if (G_UNLIKELY (gst_pad_link (pad, sinkpad) != GST_PAD_LINK_OK)) {
-    GstCaps *othercaps = gst_pad_get_current_caps (sinkpad);
-    caps = gst_pad_get_current_caps (pad);
+  if (with_queue) {
+    GstElement *queue = gst_element_factory_make ("queue", NULL);
+    GstPad *queue_srcpad = gst_element_get_static_pad (queue, "src");
+
+    gst_bin_add (GST_BIN (branch->bin), queue);
+    gst_pad_link (queue_srcpad, sinkpad);
+    gst_element_sync_state_with_parent (queue);
+    gst_object_unref (queue_srcpad);
+    gst_object_unref (sinkpad);
+    sinkpad = gst_element_get_static_pad (queue, "sink");
+  }
+
+  ghostpad = gst_ghost_pad_new (NULL, sinkpad);
+  gst_object_unref (sinkpad);
+  gst_pad_set_active (ghostpad, TRUE);
+  gst_element_add_pad (branch->bin, ghostpad);
+
+  if (G_UNLIKELY (gst_pad_link (srcpad, ghostpad) != GST_PAD_LINK_OK)) {
+    GstCaps *othercaps = gst_pad_get_current_caps (ghostpad);
+    GstCaps *srccaps = gst_pad_get_current_caps (srcpad);
 
     GST_ERROR ("Couldn't link pads \n\n%" GST_PTR_FORMAT "\n\n  and \n\n %"
-        GST_PTR_FORMAT "\n\n", caps, othercaps);
+        GST_PTR_FORMAT "\n\n", srccaps, othercaps);
 
+    if (srccaps)
+      gst_caps_unref (srccaps);
+    if (othercaps)
+      gst_caps_unref (othercaps);
+
+    return FALSE;
+  }
+
+  g_atomic_int_inc (&branch->n_streams);
+  track_new_encoders (branch);
+
+  return TRUE;
+}
+
+static void
+pad_added_cb (GstElement * uridecodebin, GstPad * pad, gpointer unused)
+{
+  guint i;
+  GstCaps *caps;
+  GstElement *tee;
+  GstPad *teepad;
+
+  caps = gst_pad_query_caps (pad, NULL);
+  GST_DEBUG_OBJECT (uridecodebin, "Pad added, caps: %" GST_PTR_FORMAT, caps);
+
+  if (branches->len == 1) {
+    link_to_branch (pad, caps, g_ptr_array_index (branches, 0), FALSE);
+    goto done;
+  }
+
+  /* The stream is decoded once and encoded by every output */
+  tee = gst_element_factory_make ("tee", NULL);
+  gst_bin_add (GST_BIN (pipeline), tee);
+  for (i = 0; i < branches->len; i++) {
+    teepad = gst_element_get_request_pad (tee, "src_%u");
+    if (!link_to_branch (teepad, caps, g_ptr_array_index (branches, i), TRUE))
+      gst_element_release_request_pad (tee, teepad);
+    gst_object_unref (teepad);
+  }
+  gst_element_sync_state_with_parent (tee);
+
+  teepad = gst_element_get_static_pad (tee, "sink");
+  gst_pad_link (pad, teepad);
+  gst_object_unref (teepad);
+
+done:
+  if (caps)
     gst_caps_unref (caps);
-    gst_caps_unref (othercaps);
+}
+
+static TranscodingBranch *
+transcoding_branch_new (guint index, const gchar * outuri,
+    GstEncodingProfile * profile)
+{
+  gchar *name = g_strdup_printf ("output%u", index);
+  TranscodingBranch *branch = g_slice_new0 (TranscodingBranch);
+  GstElement *sink;
+
+  branch->index = index;
+  branch->output_uri = g_strdup (outuri);
+  branch->profile = profile;
+  branch->bin = gst_bin_new (name);
+  g_free (name);
+
+  branch->encodebin = gst_element_factory_make ("encodebin", NULL);
+  g_object_set (branch->encodebin, "avoid-reencoding", !force_reencoding,
+      "profile", profile, NULL);
+  sink = gst_element_make_from_uri (GST_URI_SINK, outuri, "sink", NULL);
+  g_assert (sink);
+
+  gst_bin_add_many (GST_BIN (branch->bin), branch->encodebin, sink, NULL);
+
+  if (verify_output) {
+    GstElement *tee = gst_element_factory_make ("tee", NULL);
+    GstElement *queue = gst_element_factory_make ("queue", NULL);
+    GstElement *verification = output_verification_new (branch);
+
+    gst_bin_add_many (GST_BIN (branch->bin), tee, queue, verification, NULL);
+    gst_element_link_many (branch->encodebin, tee, queue, sink, NULL);
+    gst_element_link (tee, verification);
+  } else {
+    gst_element_link (branch->encodebin, sink);
   }
 
-  return;
+  return branch;
 }
 
 static void
-create_transcoding_pipeline (gchar * uri, gchar * outuri)
+create_transcoding_pipeline (gchar * uri, gchar ** outuris)
 {
-  GstElement *src, *sink;
+  guint i;
+  GList *tmp;
+  GstElement *src;
 
   mainloop = g_main_loop_new (NULL, FALSE);
 
   pipeline = gst_pipeline_new ("encoding-pipeline");
   src = gst_element_factory_make ("uridecodebin", NULL);
+  g_object_set (src, "uri", uri, NULL);
+  g_signal_connect (src, "pad-added", G_CALLBACK (pad_added_cb), NULL);
+  gst_bin_add (GST_BIN (pipeline), src);
 
-  encodebin = gst_element_factory_make ("encodebin", NULL);
-  g_object_set (encodebin, "avoid-reencoding", !force_reencoding, NULL);
-  sink = gst_element_make_from_uri (GST_URI_SINK, outuri, "sink", NULL);
-  g_assert (sink);
+  branches = g_ptr_array_new ();
+  for (i = 0, tmp = encoding_profiles; tmp; i++, tmp = tmp->next) {
+    TranscodingBranch *branch = transcoding_branch_new (i, outuris[i],
+        tmp->data);
 
-  g_object_set (src, "uri", uri, NULL);
-  g_object_set (encodebin, "profile", encoding_profile, NULL);
+    gst_bin_add (GST_BIN (pipeline), branch->bin);
+    g_ptr_array_add (branches, branch);
+  }
+}
+
+/* Can be called from any thread */
+static void
+_report_added_cb (GstValidateRunner * runner, GstValidateReport * report,
+    gpointer unused)
+{
+  TranscodingBranch *branch = NULL;
 
-  g_signal_connect (src, "pad-added", G_CALLBACK (pad_added_cb), encodebin);
+  if (GST_IS_VALIDATE_MONITOR (report->reporter))
+    branch = find_branch (GST_OBJECT (gst_validate_monitor_get_element
+            (GST_VALIDATE_MONITOR (report->reporter))));
 
-  gst_bin_add_many (GST_BIN (pipeline), src, encodebin, sink, NULL);
-  gst_element_link (encodebin, sink);
+  if (branch)
+    g_atomic_int_inc (&branch->n_reports);
 }
 
 static gboolean
@@ -718,6 +1689,10 @@ _parse_encoding_profile (const gchar * option_name, const gchar * value,
   }
   g_strfreev (strcaps_v);
 
+  /* Each -o describes the profile of the next output uri */
+  encoding_profiles = g_list_append (encoding_profiles, encoding_profile);
+  encoding_profile = NULL;
+
   return TRUE;
 }
 
@@ -764,7 +1739,8 @@ main (int argc, gchar ** argv)
           "A preset name can be used by adding +presetname, eg:\n"
           "video/webm:video/x-vp8+mypreset:audio/x-vorbis\n"
           "The presence property of the profile can be specified with |<presence>, eg:\n"
-          "video/webm:video/x-vp8|<presence>:audio/x-vorbis\n",
+          "video/webm:video/x-vp8|<presence>:audio/x-vorbis\n"
+          "Can be repeated, once per output uri\n",
         "properties-values"},
     {"set-scenario", '\0', 0, G_OPTION_ARG_STRING, &scenario,
         "Let you set a scenario, it will override the GST_VALIDATE_SCENARIO "
@@ -788,6 +1764,32 @@ main (int argc, gchar ** argv)
     {"force-reencoding", 'r', 0, G_OPTION_ARG_NONE, &force_reencoding,
         "Whether to try to force reencoding, meaning trying to only remux "
         "if possible(default: TRUE)", NULL},
+    {"min-realtime-factor", '\0', 0, G_OPTION_ARG_DOUBLE, &min_realtime_factor,
+        "Report a critical issue if a stream is encoded slower than that "
+        "many times realtime (default: no minimum)", NULL},
+    {"stats-file", '\0', 0, G_OPTION_ARG_FILENAME, &stats_file,
+        "Also write the transcoding statistics to that file, one "
+        "GstStructure per line", NULL},
+    {"verify-output", '\0', 0, G_OPTION_ARG_NONE, &verify_output,
+          "Demux the outputs while they are written to check that their "
+          "streams match the encoding profile, start with a key frame and, "
+          "with --expected-duration, last as long as expected", NULL},
+    {"expected-duration", '\0', 0, G_OPTION_ARG_INT64, &expected_duration,
+          "Expected duration of the outputs, in nanoseconds, checked by "
+          "--verify-output", NULL},
+    {"duration-tolerance", '\0', 0, G_OPTION_ARG_INT64, &duration_tolerance,
+          "How far, in nanoseconds, the duration of the outputs can be from "
+          "--expected-duration (default: 0)", NULL},
+    {"max-key-unit-latency", '\0', 0, G_OPTION_ARG_DOUBLE,
+          &max_key_unit_latency,
+          "Report a critical issue if key units come more than that many "
+          "seconds of running time after being requested by the "
+          "video-request-key-unit action, for the given "
+          "--key-unit-latency-percentile of the requests", NULL},
+    {"key-unit-latency-percentile", '\0', 0, G_OPTION_ARG_DOUBLE,
+          &key_unit_latency_percentile,
+          "Percentile of the key unit requests checked against "
+          "--max-key-unit-latency (default: 95)", NULL},
     {NULL}
   };
 
@@ -802,9 +1804,11 @@ main (int argc, gchar ** argv)
     gst_init (&argc, &argv);
 
   g_set_prgname ("gst-validate-transcoding-" GST_API_VERSION);
-  ctx = g_option_context_new ("[input-uri] [output-uri]");
+  ctx = g_option_context_new ("[input-uri] [output-uri] [output-uri...]");
   g_option_context_set_summary (ctx, "Transcodes input-uri to output-uri, "
-      "using the given encoding profile. The pipeline will be monitored for "
+      "using the given encoding profile. When several output uris are given, "
+      "the input is decoded once and encoded with one --output-format per "
+      "output uri, in order. The pipeline will be monitored for "
       "possible issues detection using the gst-validate lib."
       "\nCan also perform file conformance"
       "tests after transcoding to make sure the result is correct");
@@ -843,23 +1847,30 @@ main (int argc, gchar ** argv)
 
 
   _register_actions ();
-  if (argc != 3) {
-    g_printerr ("%i arguments recived, 2 expected.\n"
+  if (argc < 3) {
+    g_printerr ("%i arguments recived, at least 2 expected.\n"
         "You should run the test using:\n"
-        "    ./gst-validate-transcoding-0.10 <input-uri> <output-uri> [options]\n",
-        argc - 1);
+        "    ./gst-validate-transcoding-1.0 <input-uri> <output-uri> "
+        "[<output-uri>...] [options]\n", argc - 1);
     return 1;
   }
 
-  if (encoding_profile == NULL) {
+  if (encoding_profiles == NULL && argc == 3) {
     GST_INFO ("Creating default encoding profile");
 
     _parse_encoding_profile ("encoding-profile",
         "application/ogg:video/x-theora:audio/x-vorbis", NULL, NULL);
   }
 
-  /* Create the pipeline */
-  create_transcoding_pipeline (argv[1], argv[2]);
+  if (g_list_length (encoding_profiles) != argc - 2) {
+    g_printerr ("%i output uris for %u encoding profiles, every output "
+        "needs its own --output-format\n", argc - 2,
+        g_list_length (encoding_profiles));
+    return 1;
+  }
+
+  /* Create the pipeline, decoding the input once for all the outputs */
+  create_transcoding_pipeline (argv[1], &argv[2]);
 
 #ifdef G_OS_UNIX
   signal_watch_id =
@@ -870,6 +1881,8 @@ main (int argc, gchar ** argv)
   monitor =
       gst_validate_monitor_factory_create (GST_OBJECT_CAST (pipeline), runner,
       NULL);
+  g_signal_connect (runner, "report-added", G_CALLBACK (_report_added_cb),
+      NULL);
   mainloop = g_main_loop_new (NULL, FALSE);
 
   if (!runner) {
@@ -877,12 +1890,21 @@ main (int argc, gchar ** argv)
     exit (1);
   }
 
+  progress = gst_validate_progress_new_from_env ();
+  if (progress)
+    gst_validate_progress_set_runner (progress, runner);
+
   bus = gst_element_get_bus (pipeline);
   gst_bus_add_signal_watch (bus);
   g_signal_connect (bus, "message", (GCallback) bus_callback, mainloop);
+  setup_transcoding_stats (bus);
+  if (verify_output)
+    g_signal_connect (bus, "sync-message::error",
+        (GCallback) _verification_error_cb, NULL);
   gst_object_unref (bus);
 
   g_print ("Starting pipeline\n");
+  start_time = gst_util_get_timestamp ();
   sret = gst_element_set_state (pipeline, GST_STATE_PLAYING);
   switch (sret) {
     case GST_STATE_CHANGE_FAILURE:
@@ -903,6 +1925,10 @@ main (int argc, gchar ** argv)
 
   g_main_loop_run (mainloop);
 
+  /* Stopping the streaming threads so their CPU time is known */
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  report_transcoding_stats (monitor);
+
   rep_err = gst_validate_runner_printf (runner);
   if (ret == 0)
     ret = rep_err;
@@ -913,6 +1939,8 @@ exit:
   g_object_unref (pipeline);
   g_object_unref (monitor);
   g_object_unref (runner);
+  if (progress)
+    gst_validate_progress_free (progress);
 
 #ifdef G_OS_UNIX
   g_source_remove (signal_watch_id);
@@ -33,6 +33,7 @@
 #include <gst/validate/gst-validate-scenario.h>
 
 #ifdef G_OS_UNIX
+#include <unistd.h>
 #include <glib-unix.h>
 #endif
 
@@ -43,6 +44,8 @@ static GstElement *pipeline;
 static gboolean buffering = FALSE;
 static gboolean is_live = FALSE;
 static guint print_pos_srcid = 0;
+/* Set when the launcher wants the progress in GST_VALIDATE_PROGRESS_FILE */
+static GstValidateProgress *progress = NULL;
 
 #ifdef G_OS_UNIX
 static gboolean
@@ -61,7 +64,7 @@ static gboolean
 print_position (void)
 {
   GstQuery *query;
-  gint64 position, duration;
+  gint64 position = -1, duration = -1;
 
   gdouble rate = 1.0;
   GstFormat format = GST_FORMAT_TIME;
@@ -79,6 +82,8 @@ print_position (void)
   g_print ("<position: %" GST_TIME_FORMAT " duration: %" GST_TIME_FORMAT
       " speed: %f />\r", GST_TIME_ARGS (position), GST_TIME_ARGS (duration),
       rate);
+  if (progress)
+    gst_validate_progress_set_position (progress, position, duration, rate);
 
   return TRUE;
 }
@@ -110,6 +115,8 @@ bus_callback (GstBus * bus, GstMessage * message, gpointer data)
 
         gst_message_parse_state_changed (message, &oldstate, &newstate,
             &pending);
+        if (progress)
+          gst_validate_progress_set_state (progress, newstate);
 
         GST_DEBUG ("State changed (old: %s, new: %s, pending: %s)",
             gst_element_state_get_name (oldstate),
@@ -135,6 +142,8 @@ bus_callback (GstBus * bus, GstMessage * message, gpointer data)
 
       gst_message_parse_buffering (message, &percent);
       g_print ("%s %d%%  \r", "Buffering...", percent);
+      if (progress)
+        gst_validate_progress_set_buffering (progress, percent);
 
       /* no state management needed for live pipelines */
       if (is_live)
@@ -166,14 +175,372 @@ bus_callback (GstBus * bus, GstMessage * message, gpointer data)
   return TRUE;
 }
 
+/* Batch mode: several pipelines run concurrently in the same process, each
+ * one with its own runner so that the reports stay attributed to it */
+typedef struct
+{
+  guint id;
+  gchar *line;
+  gchar **pipeline_desc;
+  gchar *scenario;
+
+  GstElement *pipeline;
+  GstValidateRunner *runner;
+  GstValidateMonitor *monitor;
+  GstValidateScenario *scenario_obj;
+  gboolean buffering;
+  gboolean is_live;
+  gboolean done;
+
+  gint ret;
+  GstClockTime start_time;
+  GstClockTime duration;
+} BatchJob;
+
+static GQueue batch_pending = G_QUEUE_INIT;
+static guint batch_running = 0;
+
+static void _batch_job_start_next (void);
+
+static void
+_batch_job_free (BatchJob * job)
+{
+  g_free (job->line);
+  g_strfreev (job->pipeline_desc);
+  g_free (job->scenario);
+  g_slice_free (BatchJob, job);
+}
+
+/* A batch file line holds the arguments gst-validate would take, only
+ * --set-scenario and --set-configs are supported besides the pipeline */
+static BatchJob *
+_batch_job_new (guint id, const gchar * line,
+    const gchar * default_scenario, GError ** err)
+{
+  gint argc, i;
+  gchar **argv;
+  const gchar *scenario = NULL, *configs = NULL;
+  GPtrArray *desc = g_ptr_array_new ();
+  BatchJob *job;
+
+  if (!g_shell_parse_argv (line, &argc, &argv, err)) {
+    g_ptr_array_free (desc, TRUE);
+    return NULL;
+  }
+
+  for (i = 0; i < argc; i++) {
+    if (g_str_has_prefix (argv[i], "--set-scenario="))
+      scenario = argv[i] + strlen ("--set-scenario=");
+    else if (g_str_has_prefix (argv[i], "--set-configs="))
+      configs = argv[i] + strlen ("--set-configs=");
+    else if (!g_strcmp0 (argv[i], "--set-scenario") && i + 1 < argc)
+      scenario = argv[++i];
+    else if (!g_strcmp0 (argv[i], "--set-configs") && i + 1 < argc)
+      configs = argv[++i];
+    else
+      g_ptr_array_add (desc, g_strdup (argv[i]));
+  }
+  g_ptr_array_add (desc, NULL);
+
+  job = g_slice_new0 (BatchJob);
+  job->id = id;
+  job->line = g_strdup (line);
+  job->pipeline_desc = (gchar **) g_ptr_array_free (desc, FALSE);
+  /* Configs apply on top of the line's scenario, or the default one */
+  if (!scenario)
+    scenario = default_scenario;
+  if (scenario)
+    job->scenario = g_strjoin (":", scenario, configs, NULL);
+  else
+    job->scenario = g_strdup (configs);
+  g_strfreev (argv);
+
+  return job;
+}
+
+static gboolean
+_batch_job_finish (BatchJob * job)
+{
+  GstBus *bus;
+  int rep_err;
+
+  bus = gst_element_get_bus (job->pipeline);
+  g_signal_handlers_disconnect_by_data (bus, job);
+  gst_bus_remove_signal_watch (bus);
+  gst_object_unref (bus);
+
+  gst_element_set_state (job->pipeline, GST_STATE_NULL);
+  job->duration = gst_util_get_timestamp () - job->start_time;
+
+  g_print ("\n==== [%u] %s ====\n", job->id, job->line);
+  rep_err = gst_validate_runner_printf (job->runner);
+  if (job->ret == 0)
+    job->ret = rep_err;
+  g_print ("==== [%u] %s in %" GST_TIME_FORMAT " ====\n", job->id,
+      job->ret ? "failed" : "passed", GST_TIME_ARGS (job->duration));
+
+  g_object_unref (job->pipeline);
+  job->pipeline = NULL;
+  if (job->scenario_obj)
+    g_object_unref (job->scenario_obj);
+  g_object_unref (job->runner);
+  g_object_unref (job->monitor);
+
+  batch_running--;
+  _batch_job_start_next ();
+
+  return FALSE;
+}
+
+static void
+_batch_job_done (BatchJob * job)
+{
+  if (job->done)
+    return;
+
+  /* Not from the bus signal handler, the pipeline gets torn down */
+  job->done = TRUE;
+  g_idle_add ((GSourceFunc) _batch_job_finish, job);
+}
+
+static void
+_batch_bus_callback (GstBus * bus, GstMessage * message, BatchJob * job)
+{
+  switch (GST_MESSAGE_TYPE (message)) {
+    case GST_MESSAGE_ERROR:
+    {
+      GError *err;
+      gchar *debug;
+
+      gst_message_parse_error (message, &err, &debug);
+      g_print ("[%u] Error: %s -- Setting returncode to -1\n", job->id,
+          err->message);
+      g_error_free (err);
+      g_free (debug);
+      job->ret = -1;
+      _batch_job_done (job);
+      break;
+    }
+    case GST_MESSAGE_EOS:
+      _batch_job_done (job);
+      break;
+    case GST_MESSAGE_BUFFERING:
+    {
+      gint percent;
+
+      /* no state management needed for live pipelines */
+      if (job->is_live || job->done)
+        break;
+
+      gst_message_parse_buffering (message, &percent);
+      if (percent == 100) {
+        if (job->buffering) {
+          job->buffering = FALSE;
+          gst_element_set_state (job->pipeline, GST_STATE_PLAYING);
+        }
+      } else if (!job->buffering) {
+        gst_element_set_state (job->pipeline, GST_STATE_PAUSED);
+        job->buffering = TRUE;
+      }
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+static gboolean
+_batch_job_start (BatchJob * job)
+{
+  GstBus *bus;
+  GError *err = NULL;
+
+  job->start_time = gst_util_get_timestamp ();
+  job->pipeline = (GstElement *)
+      gst_parse_launchv ((const gchar **) job->pipeline_desc, &err);
+  if (!job->pipeline) {
+    g_print ("[%u] Failed to create pipeline: %s\n", job->id,
+        err ? err->message : "unknown reason");
+    g_clear_error (&err);
+    job->ret = -1;
+
+    return FALSE;
+  }
+  g_clear_error (&err);
+
+  if (!GST_IS_PIPELINE (job->pipeline)) {
+    GstElement *new_pipeline = gst_pipeline_new ("");
+
+    gst_bin_add (GST_BIN (new_pipeline), job->pipeline);
+    job->pipeline = new_pipeline;
+  }
+
+  job->runner = gst_validate_runner_new ();
+  job->monitor =
+      gst_validate_monitor_factory_create (GST_OBJECT_CAST (job->pipeline),
+      job->runner, NULL);
+  if (job->scenario)
+    job->scenario_obj = gst_validate_scenario_factory_create (job->runner,
+        job->pipeline, job->scenario);
+
+  bus = gst_element_get_bus (job->pipeline);
+  gst_bus_add_signal_watch (bus);
+  g_signal_connect (bus, "message", (GCallback) _batch_bus_callback, job);
+  gst_object_unref (bus);
+
+  g_print ("[%u] Starting pipeline: %s\n", job->id, job->line);
+  switch (gst_element_set_state (job->pipeline, GST_STATE_PLAYING)) {
+    case GST_STATE_CHANGE_FAILURE:
+      g_print ("[%u] Pipeline failed to go to PLAYING state\n", job->id);
+      job->ret = -1;
+      _batch_job_done (job);
+      break;
+    case GST_STATE_CHANGE_NO_PREROLL:
+      job->is_live = TRUE;
+      break;
+    default:
+      break;
+  }
+
+  return TRUE;
+}
+
+static void
+_batch_job_start_next (void)
+{
+  BatchJob *job;
+
+  while ((job = g_queue_pop_head (&batch_pending))) {
+    if (_batch_job_start (job)) {
+      batch_running++;
+      return;
+    }
+  }
+
+  if (batch_running == 0)
+    g_main_loop_quit (mainloop);
+}
+
+static gint
+_run_batch (const gchar * batch_file, gint jobs)
+{
+  GError *err = NULL;
+  gchar *content, **lines;
+  const gchar *default_scenario;
+  GPtrArray *all_jobs;
+  guint i, failed = 0;
+  gint ret = 0, rep_err;
+  GstValidateRunner *batch_runner;
+  GstClockTime start = gst_util_get_timestamp ();
+
+  if (!g_file_get_contents (batch_file, &content, NULL, &err)) {
+    g_printerr ("Could not read %s: %s\n", batch_file, err->message);
+    g_clear_error (&err);
+
+    return 1;
+  }
+
+  /* Scenarios are set per pipeline, --set-scenario being the default for
+   * lines that do not have one, do not let the monitors pick it up */
+  default_scenario = g_getenv ("GST_VALIDATE_SCENARIO");
+  default_scenario = default_scenario ? g_strdup (default_scenario) : NULL;
+  g_unsetenv ("GST_VALIDATE_SCENARIO");
+
+  all_jobs = g_ptr_array_new_with_free_func ((GDestroyNotify) _batch_job_free);
+  lines = g_strsplit (content, "\n", -1);
+  for (i = 0; lines[i]; i++) {
+    BatchJob *job;
+    gchar *line = g_strstrip (lines[i]);
+
+    if (*line == '\0' || *line == '#')
+      continue;
+
+    if (!(job = _batch_job_new (all_jobs->len, line, default_scenario, &err))) {
+      g_printerr ("%s:%u: %s\n", batch_file, i + 1, err->message);
+      g_clear_error (&err);
+      ret = 1;
+      continue;
+    }
+
+    g_ptr_array_add (all_jobs, job);
+    g_queue_push_tail (&batch_pending, job);
+  }
+  g_strfreev (lines);
+  g_free (content);
+  g_free ((gchar *) default_scenario);
+
+  if (jobs <= 0) {
+#ifdef G_OS_UNIX
+    jobs = sysconf (_SC_NPROCESSORS_ONLN);
+#endif
+    jobs = MAX (jobs, 1);
+  }
+
+  /* The resource usage is sampled for the whole process by the first
+   * runner, so it is taken by this one and reported for the whole batch
+   * rather than charged to the first pipeline */
+  batch_runner = gst_validate_runner_new ();
+
+  mainloop = g_main_loop_new (NULL, FALSE);
+  for (i = 0; i < (guint) jobs && !g_queue_is_empty (&batch_pending); i++)
+    _batch_job_start_next ();
+
+  if (batch_running)
+    g_main_loop_run (mainloop);
+
+  /* Interrupted, tear down what is still running and fail the rest */
+  g_queue_clear (&batch_pending);
+  for (i = 0; i < all_jobs->len; i++) {
+    BatchJob *job = g_ptr_array_index (all_jobs, i);
+
+    if (job->start_time == 0)
+      job->ret = -1;
+    else if (job->pipeline) {
+      if (job->ret == 0)
+        job->ret = -1;
+      _batch_job_finish (job);
+    }
+  }
+  g_main_loop_unref (mainloop);
+
+  if (batch_runner->sampler) {
+    g_print ("\n==== Batch resource usage ====\n");
+    rep_err = gst_validate_runner_printf (batch_runner);
+    if (ret == 0)
+      ret = rep_err;
+  }
+  g_object_unref (batch_runner);
+
+  g_print ("\n==== Batch summary ====\n");
+  for (i = 0; i < all_jobs->len; i++) {
+    BatchJob *job = g_ptr_array_index (all_jobs, i);
+
+    g_print ("[%u] %s in %" GST_TIME_FORMAT ": %s\n", job->id,
+        job->ret ? "failed" : "passed", GST_TIME_ARGS (job->duration),
+        job->line);
+    if (job->ret) {
+      failed++;
+      if (ret == 0)
+        ret = job->ret;
+    }
+  }
+  g_print ("%u pipelines, %u failed, %d at a time, in %" GST_TIME_FORMAT "\n",
+      all_jobs->len, failed, jobs,
+      GST_TIME_ARGS (gst_util_get_timestamp () - start));
+  g_ptr_array_unref (all_jobs);
+
+  return ret;
+}
+
 int
 main (int argc, gchar ** argv)
 {
   GError *err = NULL;
   const gchar *scenario = NULL, *configs = NULL;
-  gboolean list_scenarios = FALSE;
+  gboolean list_scenarios = FALSE, accelerated = FALSE;
   GstStateChangeReturn sret;
-  gchar *output_file = NULL;
+  gchar *output_file = NULL, *batch_file = NULL;
+  gint jobs = 0;
 
 #ifdef G_OS_UNIX
   guint signal_watch_id;
@@ -195,6 +562,17 @@ main (int argc, gchar ** argv)
         "' you can specify a list of scenario separated by ':'"
         " it will override the GST_VALIDATE_SCENARIO environment variable,",
         NULL},
+    {"accelerated", '\0', 0, G_OPTION_ARG_NONE, &accelerated,
+        "Run the scenario on a stepped clock, skipping the time spent "
+          "waiting on the clock instead of running in real time. It will override the GST_VALIDATE_ACCELERATED "
+          "environment variable", NULL},
+    {"batch", '\0', 0, G_OPTION_ARG_FILENAME, &batch_file,
+        "Run all the pipelines listed in a file in this process instead of "
+          "a single one. Each line holds a pipeline description, optionally "
+          "preceded by --set-scenario and --set-configs", NULL},
+    {"jobs", 'j', 0, G_OPTION_ARG_INT, &jobs,
+        "How many pipelines of the batch to run at the same time (default: "
+          "the number of processors)", NULL},
     {NULL}
   };
   GOptionContext *ctx;
@@ -235,6 +613,9 @@ main (int argc, gchar ** argv)
     g_free (scenarios);
   }
 
+  if (accelerated)
+    g_setenv ("GST_VALIDATE_ACCELERATED", "1", TRUE);
+
   gst_init (&argc, &argv);
   gst_validate_init ();
 
@@ -244,6 +625,21 @@ main (int argc, gchar ** argv)
     return 0;
   }
 
+  if (batch_file) {
+    g_option_context_free (ctx);
+#ifdef G_OS_UNIX
+    signal_watch_id =
+        g_unix_signal_add (SIGINT, (GSourceFunc) intr_handler, NULL);
+#endif
+    ret = _run_batch (batch_file, jobs);
+#ifdef G_OS_UNIX
+    g_source_remove (signal_watch_id);
+#endif
+    g_free (batch_file);
+
+    return ret;
+  }
+
   if (argc == 1) {
     g_print ("%s", g_option_context_get_help (ctx, FALSE, NULL));
     g_option_context_free (ctx);
@@ -283,6 +679,10 @@ main (int argc, gchar ** argv)
     exit (1);
   }
 
+  progress = gst_validate_progress_new_from_env ();
+  if (progress)
+    gst_validate_progress_set_runner (progress, runner);
+
   bus = gst_element_get_bus (pipeline);
   gst_bus_add_signal_watch (bus);
   g_signal_connect (bus, "message", (GCallback) bus_callback, mainloop);
@@ -323,6 +723,8 @@ exit:
   g_object_unref (pipeline);
   g_object_unref (runner);
   g_object_unref (monitor);
+  if (progress)
+    gst_validate_progress_free (progress);
 #ifdef G_OS_UNIX
   g_source_remove (signal_watch_id);
 #endif
@@ -99,6 +99,10 @@ class GESTest(GstValidateTest):
         self.set_sample_paths()
         self.add_arguments("-l", self.project_uri)
 
+    def get_cache_inputs(self):
+        # The medias of the project are looked up in the sample paths
+        return None
+
 
 class GESPlaybackTest(GESTest):
     def __init__(self, classname, options, reporter, project_uri, scenario):
@@ -110,6 +114,9 @@ class GESPlaybackTest(GESTest):
 
 
 class GESRenderTest(GESTest):
+    # Encoders keep several threads busy
+    cpu_weight = 4
+
     def __init__(self, classname, options, reporter, project_uri, combination):
         super(GESRenderTest, self).__init__(classname, options, reporter,
                                       project_uri)
@@ -17,16 +17,21 @@
 # Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
 # Boston, MA 02110-1301, USA.
 import os
+import sys
 import time
 import urlparse
-import subprocess
+import multiprocessing
 import ConfigParser
 from loggable import Loggable
+from mediainfodb import MediaInfoDB, MediaInfoDBError
+from cache import get_media_cache_inputs
 
 from baseclasses import GstValidateTest, TestsManager, Test, ScenarioManager, NamedDic
 from utils import MediaFormatCombination, get_profile,\
     path2url, DEFAULT_TIMEOUT, which, GST_SECOND, Result, \
-    compare_rendered_with_original, Protocols
+    compare_rendered_with_original, compare_durations, \
+    get_verified_duration, Protocols, printc, Colors, run_with_timeout, \
+    ignore_sigint, mkdir, DURATION_TOLERANCE
 
 
 class PipelineDescriptor(object):
@@ -91,6 +96,10 @@ G_V_ENCODING_TARGET_COMBINATIONS = [
     MediaFormatCombination("mp4", "mp3", "h264"),
     MediaFormatCombination("mkv", "vorbis", "h264")]
 
+# Containers whose muxer writes the header needed to demux them once the
+# whole file is written, their outputs can not be verified while written
+G_V_UNVERIFIABLE_CONTAINERS = ["mp4"]
+
 
 # List of scenarios to run depending on the protocol in use
 G_V_SCENARIOS = {Protocols.FILE: ["play_15s",
@@ -133,7 +142,8 @@ G_V_BLACKLISTED_TESTS = \
 
 class GstValidateLaunchTest(GstValidateTest):
     def __init__(self, classname, options, reporter, pipeline_desc,
-                 timeout=DEFAULT_TIMEOUT, scenario=None, file_infos=None):
+                 timeout=DEFAULT_TIMEOUT, scenario=None, file_infos=None,
+                 uri=None, media_info_path=None):
         try:
             timeout = G_V_PROTOCOL_TIMEOUTS[file_infos.get("file-info", "protocol")]
         except KeyError:
@@ -146,11 +156,25 @@ class GstValidateLaunchTest(GstValidateTest):
 
         self.pipeline_desc = pipeline_desc
         self.file_infos = file_infos
+        self.uri = uri
+        self.media_info_path = media_info_path
 
     def build_arguments(self):
         GstValidateTest.build_arguments(self)
         self.add_arguments(self.pipeline_desc)
 
+    def get_cache_inputs(self):
+        inputs = GstValidateTest.get_cache_inputs(self)
+        if inputs is None or self.uri is None:
+            return inputs
+
+        media_inputs = get_media_cache_inputs(self.uri, self.media_info_path,
+                                              self.options)
+        if media_inputs is None:
+            return None
+
+        return inputs + media_inputs
+
     def get_current_value(self):
         if self.scenario:
             sent_eos = self.sent_eos_position()
@@ -181,12 +205,118 @@ class GstValidateMediaCheckTest(Test):
         self.add_arguments(self._uri, "--expected-results",
                            self._media_info_path)
 
+    def get_cache_inputs(self):
+        return get_media_cache_inputs(self._uri, self._media_info_path,
+                                      self.options)
+
+
+class GstValidateMediaCheckReuseTest(Test):
+    """ Checks that gst-validate-media-check never reuses the results of a
+    file it failed on: it is run twice on a file that is not a media, both
+    runs have to fail without crashing and without saving a fingerprint
+    that would let the next run reuse their results """
+
+    RUNS = 2
+
+    def __init__(self, classname, options, reporter):
+        super(GstValidateMediaCheckReuseTest, self).__init__(
+            G_V_DISCOVERER_COMMAND, classname, options, reporter)
+        self._media_info = None
+
+    def _get_run_file(self, n, name):
+        return "%s.run%d.%s" % (self._media_info, n, name)
+
+    def build_command(self):
+        directory = os.path.join(self.options.logsdir, "media_check_reuse")
+        mkdir(directory)
+        fpath = os.path.join(directory, "not_a_media")
+        f = open(fpath, "w")
+        try:
+            f.write("Not a media file\n" * 1024)
+        finally:
+            f.close()
+        # Files modified less than a second ago are never fingerprinted
+        past = time.time() - 60
+        os.utime(fpath, (past, past))
+
+        self._media_info = fpath + "." + G_V_MEDIA_INFO_EXT
+        for path in [self._media_info] + \
+                [self._get_run_file(n, name) for n in range(self.RUNS)
+                 for name in ["status", "results"]]:
+            if os.path.exists(path):
+                os.remove(path)
+
+        # The exit status and the results of each run are kept for
+        # check_results
+        run = "%s %s --output-file %s" % (self.application, path2url(fpath),
+                                          self._media_info)
+        self.command = ""
+        for n in range(self.RUNS):
+            self.command += "%s; echo $? > %s; " \
+                "cp %s %s 2> /dev/null; " % (
+                    run, self._get_run_file(n, "status"), self._media_info,
+                    self._get_run_file(n, "results"))
+        self.command += "true"
+
+    def _check_run(self, n):
+        """ Returns why run n is wrong, None if it is right """
+        try:
+            f = open(self._get_run_file(n, "status"))
+            try:
+                status = int(f.read())
+            finally:
+                f.close()
+        except (IOError, ValueError):
+            return "run %d did not complete" % (n + 1)
+
+        # 1 when it failed cleanly, crashes are reported by the shell as
+        # 128 + the signal number
+        if status != 1:
+            return "run %d returned %d instead of 1" % (n + 1, status)
+
+        config = ConfigParser.ConfigParser()
+        try:
+            config.read(self._get_run_file(n, "results"))
+        except ConfigParser.Error as e:
+            return "could not parse the results of run %d: %s" % (n + 1, e)
+
+        if config.has_option("file-info", "fingerprint"):
+            return "run %d saved a fingerprint" % (n + 1)
+
+        return None
+
+    def check_results(self):
+        Test.check_results(self)
+        if self.result is not Result.PASSED:
+            return
+
+        for n in range(self.RUNS):
+            error = self._check_run(n)
+            if error is not None:
+                self.set_result(Result.FAILED, error, "media-check-reuse")
+                return
+
+        f = open(self.logfile)
+        try:
+            if "reusing it" in f.read():
+                self.set_result(Result.FAILED,
+                                "The results of a failed run were reused",
+                                "media-check-reuse")
+        finally:
+            f.close()
+
+    def get_cache_inputs(self):
+        return None
+
 
 class GstValidateTranscodingTest(GstValidateTest):
     _scenarios = ScenarioManager()
+    # Encoders keep several threads busy
+    cpu_weight = 4
+
     def __init__(self, classname, options, reporter,
                  combination, uri, file_infos, timeout=DEFAULT_TIMEOUT,
-                 scenario_name="play_15s"):
+                 scenario_name="play_15s", media_info_path=None):
 
         Loggable.__init__(self)
 
@@ -214,8 +344,10 @@ class GstValidateTranscodingTest(GstValidateTest):
 
         self.file_infos = file_infos
         self.uri = uri
+        self.media_info_path = media_info_path
         self.combination = combination
         self.dest_file = ""
+        self.stats_file = ""
 
     def set_rendering_info(self):
         self.dest_file = path = os.path.join(self.options.dest,
@@ -236,8 +368,31 @@ class GstValidateTranscodingTest(GstValidateTest):
     def build_arguments(self):
         GstValidateTest.build_arguments(self)
         self.set_rendering_info()
+        if not self.scenario:
+            # The output is checked while it is written when possible, see
+            # check_results
+            self.stats_file = self.logfile + ".stats"
+            self.add_arguments("--stats-file", self.stats_file)
+            if self.combination.container not in G_V_UNVERIFIABLE_CONTAINERS:
+                self.add_arguments("--verify-output", "--expected-duration",
+                                   self.file_infos.get("media-info",
+                                                       "file-duration"),
+                                   "--duration-tolerance",
+                                   str(DURATION_TOLERANCE))
         self.add_arguments(self.uri, self.dest_file)
 
+    def get_cache_inputs(self):
+        inputs = GstValidateTest.get_cache_inputs(self)
+        if inputs is None:
+            return None
+
+        media_inputs = get_media_cache_inputs(self.uri, self.media_info_path,
+                                              self.options)
+        if media_inputs is None:
+            return None
+
+        return inputs + media_inputs
+
     def get_current_value(self):
         if self.scenario:
             sent_eos = self.sent_eos_position()
@@ -257,12 +412,18 @@ class GstValidateTranscodingTest(GstValidateTest):
         return self.get_current_size()
 
     def check_results(self):
-        if self.result is Result.PASSED and not self.scenario:
-            orig_duration = long(self.file_infos.get("media-info", "file-duration"))
-            res, msg = compare_rendered_with_original(orig_duration, self.dest_file)
-            self.set_result(res, msg)
-        elif self.message == "":
-            GstValidateTest.check_results(self)
+        GstValidateTest.check_results(self)
+        if self.result is not Result.PASSED or self.scenario:
+            return
+
+        orig_duration = long(self.file_infos.get("media-info", "file-duration"))
+        duration = get_verified_duration(self.stats_file)
+        if duration is not None:
+            self.set_result(*compare_durations(orig_duration, duration))
+        else:
+            # Could not be demuxed while being written, discover it
+            self.set_result(*compare_rendered_with_original(orig_duration,
+                                                            self.dest_file))
 
 
 class GstValidateManager(TestsManager, Loggable):
@@ -282,10 +443,21 @@ class GstValidateManager(TestsManager, Loggable):
 
         return False
 
+    def add_options(self, group):
+        group.add_option("", "--discovery-timeout", dest="discovery_timeout",
+                         type="int", default=120,
+                         help="Time after which generating the media info "
+                         "of a file is stopped, in seconds, the file being "
+                         "skipped")
+
     def list_tests(self):
         for test_pipeline in G_V_PLAYBACK_TESTS:
             self._add_playback_test(test_pipeline)
 
+        self.add_test(GstValidateMediaCheckReuseTest(
+            "validate.media_check.reuse_failing", self.options,
+            self.reporter))
+
         for uri, mediainfo in self._list_uris():
             protocol = mediainfo.config.get("file-info", "protocol")
             try:
@@ -313,7 +485,19 @@ class GstValidateManager(TestsManager, Loggable):
                                                          self.options,
                                                          self.reporter,
                                                          comb, uri,
-                                                         mediainfo.config))
+                                                         mediainfo.config,
+                                                         media_info_path=mediainfo.path))
+
+    def _add_media_info(self, uri, media_info, config):
+        caps = config.get("media-info", "caps")
+        config.set("file-info", "protocol", urlparse.urlparse(uri).scheme)
+        for caps2, prot in G_V_CAPS_TO_PROTOCOL:
+            if caps2 == caps:
+                config.set("file-info", "protocol", prot)
+                break
+        self._uris.append((uri,
+                           NamedDic({"path": media_info,
+                                     "config": config})))
 
     def _check_discovering_info(self, media_info, uri=None):
         self.debug("Checking %s", media_info)
@@ -322,47 +506,101 @@ class GstValidateManager(TestsManager, Loggable):
         config.readfp(f)
         try:
             # Just testing that the vairous mandatory infos are present
-            caps = config.get("media-info", "caps")
+            config.get("media-info", "caps")
             config.get("media-info", "file-duration")
             config.get("media-info", "seekable")
             if uri is None:
                 uri = config.get("file-info", "uri")
-            config.set("file-info", "protocol", urlparse.urlparse(uri).scheme)
-            for caps2, prot in G_V_CAPS_TO_PROTOCOL:
-                if caps2 == caps:
-                    config.set("file-info", "protocol", prot)
-                    break
-            self._uris.append((uri,
-                               NamedDic({"path": media_info,
-                                         "config": config})))
+            self._add_media_info(uri, media_info, config)
         except ConfigParser.NoOptionError as e:
             self.debug("Exception: %s for %s", e, media_info)
         f.close()
 
-    def _discover_file(self, uri, fpath):
+    def _add_media_info_db_entry(self, entry):
+        if not entry.is_up_to_date():
+            self._check_discovering_info(entry.media_info_path, entry.uri)
+            return
+
+        # Same content as the media info file, as far as the tests are
+        # concerned, without having to parse it
+        config = ConfigParser.ConfigParser()
+        config.add_section("file-info")
+        config.set("file-info", "uri", entry.uri)
+        config.set("file-info", "file-size", str(entry.file_size))
+        config.add_section("media-info")
+        config.set("media-info", "caps", entry.caps)
+        config.set("media-info", "file-duration", str(entry.duration))
+        config.set("media-info", "seekable", str(entry.seekable).lower())
+        config.set("media-info", "is-image", str(entry.is_image).lower())
+        self._add_media_info(entry.uri, entry.media_info_path, config)
+
+    def _list_uris_from_db(self):
+        """ Returns the media info files of the media listed from the
+        database """
+        listed = set()
         try:
-            media_info = "%s.%s" % (fpath, G_V_MEDIA_INFO_EXT)
-            args = G_V_DISCOVERER_COMMAND.split(" ")
-            args.append(uri)
-            if os.path.isfile(media_info):
-                self._check_discovering_info(media_info, uri)
-                return True
-            elif fpath.endswith(G_V_STREAM_INFO_EXT):
-                self._check_discovering_info(fpath)
-                return True
-            elif self.options.generate_info:
-                args.extend(["--output-file", media_info])
-            else:
-                return True
+            db = MediaInfoDB(self.options.media_info_db)
+        except (IOError, MediaInfoDBError) as e:
+            self.warning("Could not use media info database: %s", e)
+            return listed
+
+        paths = [os.path.join(os.path.abspath(path), "")
+                 for path in self.options.paths]
+        for entry in db:
+            if [path for path in paths
+                    if entry.media_info_path.startswith(path)]:
+                self._add_media_info_db_entry(entry)
+                listed.add(entry.media_info_path)
+        db.close()
+
+        return listed
 
-            subprocess.check_output(args)
+    def _discover_file(self, uri, fpath):
+        media_info = "%s.%s" % (fpath, G_V_MEDIA_INFO_EXT)
+        if os.path.isfile(media_info):
             self._check_discovering_info(media_info, uri)
+        elif fpath.endswith(G_V_STREAM_INFO_EXT):
+            self._check_discovering_info(fpath)
 
-            return True
+    def _generate_media_infos(self, fpaths):
+        """ Runs the discoverer on fpaths with --jobs workers, returns the
+        paths it failed on """
+        if not fpaths:
+            return set()
 
-        except subprocess.CalledProcessError as e:
-            self.debug("Exception: %s", e)
-            return False
+        commands = []
+        for i, fpath in enumerate(fpaths):
+            args = G_V_DISCOVERER_COMMAND.split(" ")
+            args.extend([path2url(fpath), "--output-file",
+                         "%s.%s" % (fpath, G_V_MEDIA_INFO_EXT)])
+            commands.append((i, args, self.options.discovery_timeout))
+
+        printc("Generating the media info of %d files" % len(commands),
+               Colors.OKBLUE)
+        failed = set()
+        pool = multiprocessing.Pool(min(self.options.num_jobs, len(commands)),
+                                    ignore_sigint)
+        try:
+            results = pool.imap_unordered(run_with_timeout, commands)
+            for n in range(len(commands)):
+                # Waiting without timeout can not be interrupted
+                i, error, time_taken = results.next(sys.maxint)
+                if error is not None:
+                    failed.add(fpaths[i])
+                    printc("[%d/%d] %s: %s" % (n + 1, len(commands),
+                                               fpaths[i], error),
+                           Colors.FAIL)
+                else:
+                    printc("[%d/%d] %s (%.3fs)" % (n + 1, len(commands),
+                                                   fpaths[i], time_taken))
+            pool.close()
+        except KeyboardInterrupt:
+            pool.terminate()
+            raise
+        finally:
+            pool.join()
+
+        return failed
 
     def _list_uris(self):
         if self._uris:
@@ -372,14 +610,46 @@ class GstValidateManager(TestsManager, Loggable):
             if isinstance(self.options.paths, str):
                 self.options.paths = [os.path.join(self.options.paths)]
 
+            # Media added since the database was written are still found
+            # by walking the paths
+            listed = set()
+            db_path = None
+            if self.options.media_info_db and \
+                    os.path.isfile(self.options.media_info_db):
+                listed = self._list_uris_from_db()
+                db_path = os.path.abspath(self.options.media_info_db)
+                self.debug("Uris found in %s: %s",
+                           self.options.media_info_db, self._uris)
+
+            fpaths = []
             for path in self.options.paths:
                 for root, dirs, files in os.walk(path):
-                    for f in files:
+                    # The same order whatever the file system
+                    dirs.sort()
+                    for f in sorted(files):
                         fpath = os.path.join(path, root, f)
-                        if os.path.isdir(fpath) or fpath.endswith(G_V_MEDIA_INFO_EXT):
+                        # Skip what media-check writes: the media info
+                        # files, what it writes next to them and the
+                        # database
+                        if os.path.isdir(fpath) or \
+                                "." + G_V_MEDIA_INFO_EXT in f or \
+                                os.path.abspath(fpath) == db_path or \
+                                os.path.abspath("%s.%s" % (
+                                    fpath, G_V_MEDIA_INFO_EXT)) in listed:
                             continue
                         else:
-                            self._discover_file(path2url(fpath), fpath)
+                            fpaths.append(fpath)
+
+            failed = set()
+            if self.options.generate_info:
+                failed = self._generate_media_infos(
+                    [fpath for fpath in fpaths
+                     if not fpath.endswith(G_V_STREAM_INFO_EXT) and
+                     not os.path.isfile("%s.%s" % (fpath, G_V_MEDIA_INFO_EXT))])
+
+            for fpath in fpaths:
+                if fpath not in failed:
+                    self._discover_file(path2url(fpath), fpath)
 
         self.debug("Uris found: %s", self._uris)
 
@@ -416,7 +686,9 @@ class GstValidateManager(TestsManager, Loggable):
                                                         self.reporter,
                                                         npipe,
                                                         scenario=scenario,
-                                                        file_infos=minfo.config)
+                                                        file_infos=minfo.config,
+                                                        uri=uri,
+                                                        media_info_path=minfo.path)
                                  )
         else:
             self.add_test(GstValidateLaunchTest(self._get_fname(scenario, "testing"),
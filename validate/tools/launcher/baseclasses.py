@@ -21,7 +21,9 @@
 
 import os
 import re
+import json
 import time
+import errno
 import utils
 import urlparse
 import subprocess
@@ -29,6 +31,8 @@ import reporters
 import ConfigParser
 from loggable import Loggable
 from optparse import OptionGroup
+from progress import ProgressReader
+from cache import ResultsCache
 
 from utils import mkdir, Result, Colors, printc, DEFAULT_TIMEOUT, GST_SECOND
 
@@ -37,6 +41,13 @@ class Test(Loggable):
 
     """ A class representing a particular test. """
 
+    # How many processors the test keeps busy, see TestsScheduler
+    cpu_weight = 1
+    # How often get_current_value is called, in seconds
+    check_interval = 1
+    # How long a process has to exit once terminated before being killed
+    terminate_timeout = 1
+
     def __init__(self, application_name, classname, options,
                  reporter, timeout=DEFAULT_TIMEOUT, hard_timeout=None):
         """
@@ -63,6 +74,8 @@ class Test(Loggable):
         self._starting_time = None
         self.result = Result.NOT_RUN
         self.logfile = None
+        self.out = None
+        self.rusage = None
 
     def __str__(self):
         string = self.classname
@@ -91,6 +104,14 @@ class Test(Loggable):
     def build_arguments(self):
         pass
 
+    def get_subproc_env(self):
+        return os.environ
+
+    def get_cache_inputs(self):
+        """ Returns the paths of the files, other than the application,
+        the result depends on, None if it can not be cached """
+        return []
+
     def set_result(self, result, message="", error=""):
         self.debug("Setting result: %s (message: %s, error: %s", result,
                    message, error)
@@ -121,95 +142,205 @@ class Test(Loggable):
         """
         return Result.NOT_RUN
 
-    def wait_process(self):
-        last_val = 0
-        last_change_ts = time.time()
-        start_ts = time.time()
-        while True:
-            self.process.poll()
-            if self.process.returncode is not None:
-                break
-
-            # Dirty way to avoid eating to much CPU...
-            # good enough for us anyway.
-            time.sleep(1)
-
-            val = self.get_current_value()
-
-            self.debug("Got value: %s" % val)
-            if val is Result.NOT_RUN:
-                # The get_current_value logic is not implemented... dumb timeout
-                if time.time() - last_change_ts > self.timeout:
-                    self.result = Result.TIMEOUT
-                    break
-                continue
-            elif val is Result.FAILED:
-                self.result = Result.FAILED
-                break
-            elif val is Result.KNOWN_ERROR:
-                break
-
-            self.log("New val %s" % val)
-
-            if val == last_val:
-                delta = time.time() - last_change_ts
-                self.debug("%s: Same value for %d/%d seconds" % (self, delta, self.timeout))
-                if delta > self.timeout:
-                    self.result = Result.TIMEOUT
-                    break
-            elif self.hard_timeout and time.time() - start_ts > self.hard_timeout:
+    def get_next_deadline(self):
+        """ Returns the time (in time.time() unit) at which the test has to
+        be polled again, if its process did not exit before """
+        deadline = min(self._last_check_ts + self.check_interval,
+                       self._last_change_ts + self.timeout)
+        if self.hard_timeout:
+            deadline = min(deadline, self._starting_time + self.hard_timeout)
+
+        return deadline
+
+    def _reap(self, options=os.WNOHANG):
+        """ Waits for the process with wait4(), which gives its resource
+        usage, returns True once it exited """
+        if self.process.returncode is not None:
+            return True
+
+        try:
+            pid, status, rusage = os.wait4(self.process.pid, options)
+        except OSError as e:
+            if e.errno == errno.EINTR:
+                return False
+            # Already reaped, let Popen handle it
+            return self.process.poll() is not None
+
+        if pid == 0:
+            return False
+
+        if os.WIFSIGNALED(status):
+            self.process.returncode = -os.WTERMSIG(status)
+        else:
+            self.process.returncode = os.WEXITSTATUS(status)
+        self.rusage = rusage
+
+        return True
+
+    def get_resources(self):
+        """ Returns the resources used by the process, as a list of (name,
+        value), empty if it did not run """
+        if self.rusage is None:
+            return []
+
+        # ru_maxrss is in KiB, blocks are 512 bytes
+        return [("cpu-user", "%.3f" % self.rusage.ru_utime),
+                ("cpu-system", "%.3f" % self.rusage.ru_stime),
+                ("max-rss", self.rusage.ru_maxrss * 1024),
+                ("voluntary-context-switches", self.rusage.ru_nvcsw),
+                ("involuntary-context-switches", self.rusage.ru_nivcsw),
+                ("read-bytes", self.rusage.ru_inblock * 512),
+                ("write-bytes", self.rusage.ru_oublock * 512)]
+
+    def _poll_process(self):
+        """ Returns True once the process is done or has to be stopped,
+        never blocks """
+        if self._reap():
+            return True
+
+        now = time.time()
+        if self.hard_timeout and now - self._starting_time >= self.hard_timeout:
+            self.result = Result.TIMEOUT
+            return True
+
+        # The value is sampled every check_interval, and when the timeout
+        # would be reached if it did not change since the last sample
+        if now < self.get_next_deadline():
+            return False
+        self._last_check_ts = now
+
+        val = self.get_current_value()
+
+        self.debug("Got value: %s" % val)
+        if val is Result.NOT_RUN:
+            # The get_current_value logic is not implemented... dumb timeout
+            if now - self._last_change_ts > self.timeout:
                 self.result = Result.TIMEOUT
-                break
-            else:
-                last_change_ts = time.time()
-                last_val = val
+                return True
+            return False
+        elif val is Result.FAILED:
+            self.result = Result.FAILED
+            return True
+        elif val is Result.KNOWN_ERROR:
+            return True
+
+        self.log("New val %s" % val)
+
+        if val == self._last_val:
+            delta = now - self._last_change_ts
+            self.debug("%s: Same value for %d/%d seconds" % (self, delta, self.timeout))
+            if delta >= self.timeout:
+                self.result = Result.TIMEOUT
+                return True
+        else:
+            self._last_change_ts = now
+            self._last_val = val
+
+        return False
+
+    def wait_process(self):
+        with utils.ChildWatcher() as watcher:
+            while not self._poll_process():
+                watcher.wait(self.get_next_deadline())
 
         self.check_results()
 
-    def run(self):
+    def build_command(self):
         self.command = "%s " % (self.application)
-        self._starting_time = time.time()
         self.build_arguments()
+
+    def start(self):
+        """ Launches the test, its output going to self.out """
+        self._starting_time = time.time()
+        self._last_val = 0
+        self._last_change_ts = self._last_check_ts = time.time()
+        self.build_command()
         printc("Launching: %s%s\n"
                "           logs are in %s\n"
                "           Command: '%s'"
                % (Colors.ENDC, self.classname,
                   self.logfile, self.command), Colors.OKBLUE)
-        try:
-            self.process = subprocess.Popen(self.command,
-                                            stderr=self.reporter.out,
-                                            stdout=self.reporter.out,
-                                            shell=True)
-            self.wait_process()
-        except KeyboardInterrupt:
-            self.process.kill()
-            raise
+        self.process = subprocess.Popen(self.command,
+                                        stderr=self.out,
+                                        stdout=self.out,
+                                        shell=True,
+                                        env=self.get_subproc_env())
+
+    def poll(self):
+        """ Returns True once the test is done, its results checked """
+        if not self._poll_process():
+            return False
+
+        self.check_results()
+        return True
 
+    def kill(self):
         try:
-            self.process.terminate()
+            self.process.kill()
         except OSError:
             pass
 
+    def finish(self):
         self.time_taken = time.time() - self._starting_time
 
-        self.reporter.out.seek(0)
-        self.reporter.out.write("=================\n"
-                                "Test name: %s\n"
-                                "Command: '%s'\n"
-                                "=================\n\n"
-                                % (self.classname, self.command))
+        if not self._reap():
+            try:
+                self.process.terminate()
+            except OSError:
+                pass
+
+            # Reap it anyway, to get its resource usage
+            deadline = time.time() + self.terminate_timeout
+            while not self._reap() and time.time() < deadline:
+                time.sleep(0.05)
+            if self.process.returncode is None:
+                self.kill()
+                self._reap(0)
+
+        self.out.seek(0)
+        self.out.write("=================\n"
+                       "Test name: %s\n"
+                       "Command: '%s'\n"
+                       "=================\n\n"
+                       % (self.classname, self.command))
         printc("Result: %s%s\n" % (self.result,
                " (" + self.message + ")" if self.message else ""),
                color=utils.get_color_for_result(self.result))
 
         return self.result
 
+    def set_cached_result(self, cached):
+        """ Reports the result of a previous run instead of running """
+        self.set_result(Result.PASSED, "cached")
+        self.out.write("=================\n"
+                       "Test name: %s\n"
+                       "Command: '%s'\n"
+                       "=================\n\n"
+                       "Not run, passed on %s in %.3f seconds with the same "
+                       "inputs\n"
+                       % (self.classname, self.command,
+                          time.ctime(cached["date"]), cached["time-taken"]))
+        printc("Result: %s (cached)\n" % self.result,
+               color=utils.get_color_for_result(self.result))
+
+    def run(self):
+        try:
+            self.start()
+            self.wait_process()
+        except KeyboardInterrupt:
+            self.kill()
+            raise
+
+        return self.finish()
+
 
 class GstValidateTest(Test):
 
     """ A class representing a particular test. """
     findpos_regex = re.compile('.*position.*(\d+):(\d+):(\d+).(\d+).*duration.*(\d+):(\d+):(\d+).(\d+)')
     findlastseek_regex = re.compile('seeking to.*(\d+):(\d+):(\d+).(\d+).*stop.*(\d+):(\d+):(\d+).(\d+).*rate.*(\d+)\.(\d+)')
+    _progress = None
+    _log_tail = None
 
     def __init__(self, application_name, classname,
                  options, reporter, timeout=DEFAULT_TIMEOUT,
@@ -230,27 +361,75 @@ class GstValidateTest(Test):
     def clean(self):
         Test.clean(self)
         self._sent_eos_pos = None
+        self._log_tail = None
+        self._criticals = []
+        self._last_position = (-1, -1)
+        self._last_seek_line = None
+        if self._progress is not None:
+            self._progress.close()
+            self._progress = None
+
+    def get_subproc_env(self):
+        # The tools write their position there, see _get_position
+        progress_file = self.logfile + ".progress"
+        if os.path.exists(progress_file):
+            os.remove(progress_file)
+        self._progress = ProgressReader(progress_file)
+
+        env = os.environ.copy()
+        env["GST_VALIDATE_PROGRESS_FILE"] = progress_file
+        return env
 
     def build_arguments(self):
         if self.scenario is not None:
             self.add_arguments("--set-scenario", self.scenario.name)
 
-    def get_validate_criticals_errors(self):
-        ret = "["
-        errors = []
-        for l in open(self.logfile, 'r').readlines():
+    def get_cache_inputs(self):
+        if self.scenario is None:
+            return []
+
+        try:
+            return [self.scenario.path]
+        except AttributeError:
+            return None
+
+    def _read_log(self):
+        """ Parses what was logged since the previous call, so that the
+        log, that can be huge with GST_DEBUG, is read only once """
+        if self._log_tail is None or self._log_tail.path != self.logfile:
+            self._log_tail = utils.LogTail(self.logfile)
+
+        position_line = None
+        for l in self._log_tail.read_lines():
             if "critical : " in l:
-                if ret != "[":
-                    ret += ", "
-                error = l.split("critical : ")[1].replace("\n", '')
-                if error not in errors:
-                    ret += error
-                    errors.append(error)
-
-        if ret == "[":
-            return "No critical"
+                error = l.split("critical : ")[1]
+                if error not in self._criticals:
+                    self._criticals.append(error)
+
+            l = l.lower().strip()
+            if (l.startswith("<position:") and l.endswith("/>")) or \
+                    (l.startswith("buffering") and l.endswith("%")):
+                position_line = l
+            elif "seeking to: " in l:
+                self._last_seek_line = l
+
+            if "sending eos" in l and self._sent_eos_pos is None:
+                self._sent_eos_pos = time.time()
+
+        if position_line is None:
+            return
+
+        if position_line.startswith("<position:"):
+            self._last_position = self._parse_position(position_line)
         else:
-            return ret + "]"
+            self._last_position = self._parse_buffering(position_line)
+
+    def get_validate_criticals_errors(self):
+        self._read_log()
+        if not self._criticals:
+            return "No critical"
+
+        return "[" + ", ".join(self._criticals) + "]"
 
     def check_results(self):
         if self.result is Result.FAILED or self.result is Result.PASSED:
@@ -291,49 +470,32 @@ class GstValidateTest(Test):
 
 
     def _get_position(self):
-        position = duration = -1
-
         self.debug("Getting position")
-        m = None
-        for l in reversed(open(self.logfile, 'r').readlines()):
-            l = l.lower()
-            if "<position:" in l or "buffering" in l:
-                m = l
-                break
-
-        if m is None:
+        if self._progress is not None:
+            progress = self._progress.read()
+            if progress is not None:
+                if progress.buffering < 100:
+                    return progress.buffering, 100
+                return progress.position, progress.duration
+
+        # Applications not writing the progress record
+        self._read_log()
+        if self._last_position == (-1, -1):
             self.debug("Could not fine any positionning info")
-            return position, duration
-
-        for j in m.split("\r"):
-            j = j.lstrip().rstrip()
-            if j.startswith("<position:") and j.endswith("/>"):
-                position, duration = self._parse_position(j)
-            elif j.startswith("buffering") and j.endswith("%"):
-                position, duration = self._parse_buffering(j)
-            else:
-                self.log("No info in %s" % j)
 
-        return position, duration
+        return self._last_position
 
     def _get_last_seek_values(self):
-        m = None
         rate = start = stop = None
 
-        for l in reversed(open(self.logfile, 'r').readlines()):
-            l = l.lower()
-            if "seeking to: " in l:
-                m = l
-                break
-
-        if m is None:
+        self._read_log()
+        if self._last_seek_line is None:
             self.debug("Could not fine any seeking info")
             return start, stop, rate
 
-
-        values = self.findlastseek_regex.findall(m)
+        values = self.findlastseek_regex.findall(self._last_seek_line)
         if len(values) != 1:
-            self.warning("Got a unparsable value: %s" % p)
+            self.warning("Got a unparsable value: %s" % self._last_seek_line)
             return start, stop, rate
 
         v = values[0]
@@ -342,20 +504,10 @@ class GstValidateTest(Test):
                 float(str(v[8]) + "." + str(v[9])))
 
     def sent_eos_position(self):
-        if self._sent_eos_pos is not None:
-            return self._sent_eos_pos
-
-        m = None
-        rate = start = stop = None
+        if self._sent_eos_pos is None:
+            self._read_log()
 
-        for l in reversed(open(self.logfile, 'r').readlines()):
-            l = l.lower()
-            if "sending eos" in l:
-                m = l
-                self._sent_eos_pos = time.time()
-                return self._sent_eos_pos
-
-        return None
+        return self._sent_eos_pos
 
     def get_current_position(self):
         position, duration = self._get_position()
@@ -377,6 +529,136 @@ class GstValidateTest(Test):
         return size
 
 
+class TestsScheduler(Loggable):
+
+    """ Runs tests in parallel, keeping the sum of the cpu_weight of the
+    running tests under the number of jobs. When several jobs run, tests are
+    started longest first, according to how long they took in the previous
+    runs, otherwise they keep their original order """
+
+    DURATIONS_FILE = "durations.json"
+
+    def __init__(self, options, reporter):
+        Loggable.__init__(self)
+
+        self.options = options
+        self.reporter = reporter
+        self.jobs = max(options.num_jobs, 1)
+        self._cache = None
+        if not options.no_cache:
+            self._cache = ResultsCache(options)
+        self._cache_keys = {}
+        self._durations_path = os.path.join(options.logsdir,
+                                            self.DURATIONS_FILE)
+        try:
+            self._durations = json.load(open(self._durations_path))
+        except (IOError, ValueError):
+            self._durations = {}
+
+    def _save_durations(self):
+        try:
+            f = open(self._durations_path, "w")
+            json.dump(self._durations, f)
+            f.close()
+        except IOError as e:
+            self.warning("Could not save tests durations: %s" % e)
+
+    def _sort_key(self, test):
+        # Tests that never ran come first, they might be long
+        return -self._durations.get(test.classname, float("inf"))
+
+    def _next_test(self, pending, running):
+        load = sum(test.cpu_weight for test in running)
+        for test in pending:
+            # A test heavier than all the jobs still runs, alone
+            if not running or load + test.cpu_weight <= self.jobs:
+                return test
+
+        return None
+
+    def _finish_test(self, test):
+        test.finish()
+        self.reporter.after_test(test)
+        self._durations[test.classname] = test.time_taken
+
+        key = self._cache_keys.pop(test, None)
+        if key is not None:
+            self._cache.store(key, test)
+
+    def _restore_test(self, test):
+        """ Returns True if test passed with the same inputs before, its
+        result being reported, otherwise its cache key is kept to store
+        its result """
+        if self._cache is None:
+            return False
+
+        test.build_command()
+        key = self._cache.get_key(test)
+        if key is None:
+            return False
+
+        cached = self._cache.lookup(key)
+        if cached is None:
+            self._cache_keys[test] = key
+            return False
+
+        test.set_cached_result(cached)
+        self.reporter.after_test(test)
+        return True
+
+    def run(self, tests):
+        """ Returns Result.PASSED, or the result of the failed test if
+        running tests had to stop on failures, then waiting for the running
+        ones without starting any new one """
+        if self.jobs > 1:
+            pending = sorted(tests, key=self._sort_key)
+        else:
+            pending = list(tests)
+        running = []
+        res = Result.PASSED
+
+        try:
+            with utils.ChildWatcher() as watcher:
+                while pending or running:
+                    while res == Result.PASSED:
+                        test = self._next_test(pending, running)
+                        if test is None:
+                            break
+
+                        pending.remove(test)
+                        self.reporter.before_test(test)
+                        if self._restore_test(test):
+                            continue
+
+                        test.start()
+                        running.append(test)
+
+                    for test in running[:]:
+                        if not test.poll():
+                            continue
+
+                        running.remove(test)
+                        self._finish_test(test)
+                        if test.result != Result.PASSED and \
+                                (self.options.forever or
+                                 self.options.fatal_error):
+                            res = test.result
+                            pending = []
+
+                    if running and (res != Result.PASSED or
+                                    self._next_test(pending, running) is None):
+                        watcher.wait(min(test.get_next_deadline()
+                                         for test in running))
+        except KeyboardInterrupt:
+            for test in running:
+                test.kill()
+            raise
+        finally:
+            self._save_durations()
+
+        return res
+
+
 class TestsManager(Loggable):
 
     """ A class responsible for managing tests. """
@@ -453,17 +735,8 @@ class TestsManager(Loggable):
 
         return False
 
-    def run_tests(self):
-        for test in self.tests:
-            if self._is_test_wanted(test):
-                self.reporter.before_test(test)
-                res = test.run()
-                self.reporter.after_test()
-                if res != Result.PASSED and (self.options.forever or
-                                             self.options.fatal_error):
-                    return test.result
-
-        return Result.PASSED
+    def get_wanted_tests(self):
+        return [test for test in self.tests if self._is_test_wanted(test)]
 
     def clean_tests(self):
         for test in self.tests:
@@ -546,11 +819,15 @@ class _TestsLauncher(Loggable):
             self.tests.extend(tester.tests)
 
     def _run_tests(self):
+        # The tests of all the testers share the same jobs
+        tests = []
         for tester in self.testers:
-            res = tester.run_tests()
-            if res != Result.PASSED and (self.options.forever or
-                    self.options.fatal_error):
-                return False
+            tests.extend(tester.get_wanted_tests())
+
+        res = TestsScheduler(self.options, self.reporter).run(tests)
+        if res != Result.PASSED and (self.options.forever or
+                self.options.fatal_error):
+            return False
 
         return True
 
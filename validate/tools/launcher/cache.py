@@ -0,0 +1,276 @@
+#!/usr/bin/python
+#
+# Copyright (c) 2014, Collabora Ltd.
+#
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this program; if not, write to the
+# Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+# Boston, MA 02110-1301, USA.
+
+""" Cache of the results of the tests that passed, indexed by a hash of
+everything the tests depend on """
+
+import os
+import re
+import glob
+import json
+import time
+import hashlib
+import urlparse
+import subprocess
+from loggable import Loggable
+
+from utils import mkdir, which, Result, Protocols
+
+# The start and the end of the media files are hashed, with their size and
+# modification time, like gst-validate-media-check does
+MEDIA_CHUNK_SIZE = 64 * 1024
+
+# Variables that do not change the behaviour of the tools
+IGNORED_ENVIRONMENT = re.compile("GST_DEBUG.*")
+
+
+def _hash_file(path, checksum):
+    f = open(path, "rb")
+    try:
+        while True:
+            data = f.read(1 << 20)
+            if not data:
+                break
+            checksum.update(data)
+    finally:
+        f.close()
+
+
+def _hash_media_file(path, checksum):
+    st = os.stat(path)
+    # With the fraction of second, a file written twice in the same second
+    # is seen as modified
+    checksum.update("%d %r" % (st.st_size, st.st_mtime))
+
+    f = open(path, "rb")
+    try:
+        checksum.update(f.read(MEDIA_CHUNK_SIZE))
+        if st.st_size > 2 * MEDIA_CHUNK_SIZE:
+            f.seek(-MEDIA_CHUNK_SIZE, os.SEEK_END)
+            checksum.update(f.read(MEDIA_CHUNK_SIZE))
+    finally:
+        f.close()
+
+
+def uri_to_path(uri, options):
+    """ Returns the local path of a media, None if it can not be
+    fingerprinted """
+    url = urlparse.urlparse(uri)
+    if url.scheme == Protocols.FILE:
+        return urlparse.unquote(url.path)
+    elif url.scheme == Protocols.HTTP and \
+            url.netloc == "127.0.0.1:%s" % options.http_server_port:
+        return os.path.join(options.http_server_dir,
+                            urlparse.unquote(url.path).lstrip("/"))
+
+    return None
+
+
+def get_media_cache_inputs(uri, media_info_path, options):
+    """ The inputs of a test on the media at uri, see
+    Test.get_cache_inputs """
+    path = uri_to_path(uri, options)
+    if path is None:
+        return None
+
+    inputs = [path]
+    if media_info_path is not None:
+        inputs.append(urlparse.urlparse(media_info_path).path)
+
+    return inputs
+
+
+class ResultsCache(Loggable):
+
+    """ Tests give the files they depend on with get_cache_inputs(), their
+    key is a hash of those files, of their command, of the executable and
+    GStreamer libraries it uses and of the plugins registry """
+
+    def __init__(self, options):
+        Loggable.__init__(self)
+
+        self.options = options
+        self.directory = options.cache_dir
+        self._environment_hash = None
+        self._applications_hashes = {}
+
+    def _get_registry_paths(self):
+        for var in ["GST_REGISTRY_1_0", "GST_REGISTRY"]:
+            if os.environ.get(var):
+                return [os.environ[var]]
+
+        cache_dir = os.environ.get("XDG_CACHE_HOME",
+                                   os.path.expanduser("~/.cache"))
+        return sorted(glob.glob(os.path.join(cache_dir, "gstreamer-1.0",
+                                             "registry.*.bin")))
+
+    def _get_environment_hash(self):
+        """ The registry stores the name, size and modification time of
+        every plugin and is written again when one of them changes """
+        if self._environment_hash is not None:
+            return self._environment_hash
+
+        checksum = hashlib.sha1()
+        for path in self._get_registry_paths():
+            try:
+                _hash_file(path, checksum)
+            except IOError as e:
+                self.debug("Could not read registry %s: %s", path, e)
+
+        for var in sorted(os.environ):
+            if var.startswith("GST_") and not IGNORED_ENVIRONMENT.match(var):
+                checksum.update("%s=%s\n" % (var, os.environ[var]))
+
+        self._environment_hash = checksum.hexdigest()
+        return self._environment_hash
+
+    def _get_gst_libraries(self, path):
+        """ Returns the GStreamer libraries the executable at path links,
+        None if they can not be found """
+        try:
+            output = subprocess.check_output(["ldd", path],
+                                             stderr=subprocess.STDOUT)
+        except (subprocess.CalledProcessError, OSError) as e:
+            self.debug("Could not list the libraries of %s: %s", path, e)
+            return None
+
+        libraries = []
+        for l in output.splitlines():
+            l = l.split("=>")
+            if len(l) == 2 and "gst" in l[0]:
+                library = l[1].split("(")[0].strip()
+                if not os.path.isfile(library):
+                    # "not found"
+                    return None
+                libraries.append(library)
+
+        return libraries or None
+
+    def _get_real_executable(self, path):
+        """ Uninstalled executables are libtool wrapper scripts, that relink
+        .libs/NAME against the uninstalled libraries as .libs/lt-NAME when
+        it is run and out of date. Returns None when that was not done
+        yet, the libraries it uses not being known """
+        directory, name = os.path.split(path)
+        libtool_path = os.path.join(directory, ".libs", name)
+        if not os.path.isfile(libtool_path):
+            return path
+
+        relinked_path = os.path.join(directory, ".libs", "lt-" + name)
+        try:
+            if os.path.getmtime(relinked_path) >= \
+                    os.path.getmtime(libtool_path):
+                return relinked_path
+        except OSError:
+            pass
+
+        return None
+
+    def _get_application_hash(self, application):
+        """ Hashes the executable and the GStreamer libraries it links, None
+        if they can not be found """
+        executable = application.split(" ")[0]
+        if executable in self._applications_hashes:
+            return self._applications_hashes[executable]
+
+        checksum = None
+        paths = which(executable)
+        if paths:
+            path = self._get_real_executable(paths[0])
+            libraries = None
+            if path is not None:
+                libraries = self._get_gst_libraries(path)
+            if libraries is not None:
+                checksum = hashlib.sha1()
+                for p in [path] + libraries:
+                    try:
+                        _hash_file(p, checksum)
+                    except IOError as e:
+                        self.debug("Could not read %s: %s", p, e)
+                        checksum = None
+                        break
+
+        if checksum is None:
+            self.debug("Results of %s will not be cached", executable)
+
+        self._applications_hashes[executable] = checksum
+        return checksum
+
+    def get_key(self, test):
+        """ Returns the key of test, its command being built, None if it
+        can not be cached """
+        inputs = test.get_cache_inputs()
+        if inputs is None:
+            return None
+
+        application_hash = self._get_application_hash(test.application)
+        if application_hash is None:
+            return None
+
+        checksum = application_hash.copy()
+        checksum.update(self._get_environment_hash())
+        checksum.update(test.classname)
+        checksum.update(test.command)
+        for path in inputs:
+            checksum.update(path)
+            try:
+                if os.path.getsize(path) > 2 * MEDIA_CHUNK_SIZE:
+                    _hash_media_file(path, checksum)
+                else:
+                    _hash_file(path, checksum)
+            except (IOError, OSError) as e:
+                self.debug("Can not cache %s, %s: %s", test.classname, path, e)
+                return None
+
+        return checksum.hexdigest()
+
+    def _get_path(self, key):
+        return os.path.join(self.directory, key[:2], key + ".json")
+
+    def lookup(self, key):
+        """ Returns the result stored for key, None if there is none """
+        try:
+            f = open(self._get_path(key))
+        except IOError:
+            return None
+
+        try:
+            return json.load(f)
+        except ValueError:
+            return None
+        finally:
+            f.close()
+
+    def store(self, key, test):
+        if test.result != Result.PASSED:
+            return
+
+        path = self._get_path(key)
+        mkdir(os.path.dirname(path))
+        try:
+            f = open(path + ".tmp", "w")
+            json.dump({"classname": test.classname,
+                       "command": test.command,
+                       "time-taken": test.time_taken,
+                       "date": time.time()}, f)
+            f.close()
+            os.rename(path + ".tmp", path)
+        except (IOError, OSError) as e:
+            self.warning("Could not cache the result of %s: %s"
+                         % (test.classname, e))
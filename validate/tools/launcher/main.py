@@ -21,6 +21,7 @@ import sys
 import utils
 import urlparse
 import loggable
+import multiprocessing
 from optparse import OptionParser, OptionGroup
 
 from httpserver import HTTPServer
@@ -45,6 +46,12 @@ def main():
     parser.add_option("-F", "--fatal-error", dest="fatal_error",
                       action="store_true", default=False,
                       help="Stop on first fail")
+    parser.add_option("-j", "--jobs", dest="num_jobs",
+                      type="int", default=1,
+                      help="Number of tests to run at the same time, 0 for "
+                      "the number of processors. Tests known to use several "
+                      "processors, like transcoding ones, count as several "
+                      "jobs")
     parser.add_option("-t", "--wanted-tests", dest="wanted_tests",
                       default=[],
                       action="append",
@@ -68,6 +75,11 @@ def main():
     parser.add_option("-g", "--generate-media-info", dest="generate_info",
                      action="store_true", default=False,
                      help="Set it in order to generate the missing .media_infos files")
+    parser.add_option("", "--no-cache", dest="no_cache",
+                     action="store_true", default=False,
+                     help="Run all the tests, even the ones that passed "
+                     "before with the same binaries, plugins, media files "
+                     "and scenarios")
 
     dir_group = OptionGroup(parser, "Directories and files to be used by the launcher")
     parser.add_option('--xunit-file', action='store',
@@ -89,6 +101,10 @@ def main():
                       default=None,
                       help="Directory where to store logs, default is logs/ in "
                       "--output-dir result")
+    dir_group.add_option("", "--cache-dir", dest="cache_dir",
+                      default=None,
+                      help="Directory where to store the results of the "
+                      "tests that passed, default is cache/ in --main-dir")
     dir_group.add_option("-R", "--render-path", dest="dest",
                      default=None,
                      help="Set the path to which projects should be rendered")
@@ -97,6 +113,12 @@ def main():
                       help="Paths in which to look for media files, will be %s "
                       "if nothing specified" %
                       os.path.join(DEFAULT_MAIN_DIR, QA_ASSETS, "medias"))
+    dir_group.add_option("", "--media-info-db", dest="media_info_db",
+                      default=None,
+                      help="Media info database, as written by "
+                      "gst-validate-media-check-1.0 --database, from which "
+                      "to list the media files found in the --medias-paths "
+                      "instead of reading all their .media_info files")
     dir_group.add_option("", "--clone-dir", dest="clone_dir",
                       default=None,
                       help="Paths in which to look for media files, will be %s "
@@ -142,9 +164,14 @@ def main():
     (options, args) = parser.parse_args()
     if options.logsdir is None:
         options.logsdir = os.path.join(options.outputdir, "logs")
+    if options.num_jobs <= 0:
+        options.num_jobs = multiprocessing.cpu_count()
     if options.xunit_file is None:
         options.xunit_file = os.path.join(options.logsdir, "xunit.xml")
 
+    if options.cache_dir is None:
+        options.cache_dir = os.path.join(options.main_dir, "cache")
+
     if options.dest is None:
         options.dest = os.path.join(options.outputdir, "rendered")
     if not os.path.exists(options.dest):
@@ -0,0 +1,145 @@
+#!/usr/bin/python
+#
+# Copyright (c) 2014, Collabora Ltd.
+#
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this program; if not, write to the
+# Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+# Boston, MA 02110-1301, USA.
+
+""" Reader of the media info databases written by
+gst-validate-media-check --database, see gst-validate-media-info-db.c
+for the format """
+
+import os
+import mmap
+import struct
+
+MAGIC = "GVMD"
+VERSION = 2
+
+# os.stat() gives the modification time as a float, that can not hold it to
+# the nanosecond
+MTIME_PRECISION = 1000
+
+HEADER = struct.Struct("<4sIIIQQ")
+RECORD = struct.Struct("<IIIIQQq")
+
+FLAG_SEEKABLE = 1 << 0
+FLAG_IS_IMAGE = 1 << 1
+FLAG_PASSED = 1 << 2
+
+
+class MediaInfoDBError(Exception):
+    pass
+
+
+class MediaInfoDBEntry(object):
+    def __init__(self, uri, media_info_path, caps, flags, duration,
+                 file_size, media_info_mtime):
+        self.uri = uri
+        self.media_info_path = media_info_path
+        self.caps = caps
+        self.duration = duration
+        self.file_size = file_size
+        self.seekable = bool(flags & FLAG_SEEKABLE)
+        self.is_image = bool(flags & FLAG_IS_IMAGE)
+        self.passed = bool(flags & FLAG_PASSED)
+        self.media_info_mtime = media_info_mtime
+
+    def is_up_to_date(self):
+        """ Whether the media info file was not written again since the
+        entry was made, the modification times being in nanoseconds """
+        try:
+            mtime = int(round(os.stat(self.media_info_path).st_mtime * 1e9))
+        except OSError:
+            return False
+
+        return abs(mtime - self.media_info_mtime) < MTIME_PRECISION
+
+
+class MediaInfoDB(object):
+    def __init__(self, path):
+        f = open(path, "rb")
+        try:
+            self._map = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        except (mmap.error, ValueError) as e:
+            raise MediaInfoDBError("Could not map %s: %s" % (path, e))
+        finally:
+            f.close()
+
+        if len(self._map) < HEADER.size:
+            raise MediaInfoDBError("%s is not a media info database" % path)
+
+        magic, version, self._n_records, self._record_size, \
+            self._strings_offset, strings_size = \
+            HEADER.unpack_from(self._map, 0)
+        self._strings_end = self._strings_offset + strings_size
+
+        if magic != MAGIC or version != VERSION or \
+                self._record_size < RECORD.size or \
+                self._strings_offset < HEADER.size or \
+                self._strings_end > len(self._map) or strings_size == 0 or \
+                (self._strings_offset - HEADER.size) / self._record_size < \
+                self._n_records:
+            raise MediaInfoDBError("%s is not a valid media info database"
+                                   % path)
+
+    def __len__(self):
+        return self._n_records
+
+    def _get_string(self, offset):
+        start = self._strings_offset + offset
+        if start >= self._strings_end:
+            raise MediaInfoDBError("Invalid string offset %d" % offset)
+
+        end = self._map.find("\0", start, self._strings_end)
+        if end == -1:
+            raise MediaInfoDBError("Unterminated string at offset %d" % offset)
+
+        return self._map[start:end]
+
+    def _get_uri(self, n):
+        return self._get_string(RECORD.unpack_from(self._map, HEADER.size +
+                                n * self._record_size)[0])
+
+    def get_entry(self, n):
+        uri, media_info_path, caps, flags, duration, file_size, mtime = \
+            RECORD.unpack_from(self._map, HEADER.size + n * self._record_size)
+
+        return MediaInfoDBEntry(self._get_string(uri),
+                                self._get_string(media_info_path),
+                                self._get_string(caps), flags, duration,
+                                file_size, mtime)
+
+    def __iter__(self):
+        for n in range(self._n_records):
+            yield self.get_entry(n)
+
+    def lookup(self, uri):
+        """ Entries are sorted by uri """
+        low, high = 0, self._n_records
+        while low < high:
+            mid = (low + high) / 2
+            mid_uri = self._get_uri(mid)
+            if mid_uri == uri:
+                return self.get_entry(mid)
+            elif uri < mid_uri:
+                high = mid
+            else:
+                low = mid + 1
+
+        return None
+
+    def close(self):
+        self._map.close()
@@ -0,0 +1,99 @@
+#!/usr/bin/python
+#
+# Copyright (c) 2014, Collabora Ltd.
+#
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this program; if not, write to the
+# Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+# Boston, MA 02110-1301, USA.
+
+""" Reader of the progress record the gst-validate tools write to
+GST_VALIDATE_PROGRESS_FILE, see gst-validate-progress.c for the format """
+
+import os
+import mmap
+import struct
+
+MAGIC = "GVPR"
+VERSION = 1
+
+RECORD = struct.Struct("<4sIIIqqdiII12x")
+SEQUENCE = struct.Struct("<I")
+SEQUENCE_OFFSET = 8
+
+# How many times to retry reading a record being written
+MAX_RETRIES = 100
+
+
+class Progress(object):
+    def __init__(self, state, position, duration, rate, buffering,
+                 n_issues, n_criticals):
+        self.state = state
+        self.position = position
+        self.duration = duration
+        self.rate = rate
+        self.buffering = buffering
+        self.n_issues = n_issues
+        self.n_criticals = n_criticals
+
+
+class ProgressReader(object):
+    """ Maps the progress file once it has been created by the tool """
+
+    def __init__(self, path):
+        self.path = path
+        self._map = None
+
+    def _open(self):
+        try:
+            f = open(self.path, "rb")
+        except IOError:
+            return False
+
+        try:
+            if os.fstat(f.fileno()).st_size < RECORD.size:
+                return False
+            self._map = mmap.mmap(f.fileno(), RECORD.size,
+                                  access=mmap.ACCESS_READ)
+        except (mmap.error, ValueError):
+            return False
+        finally:
+            f.close()
+
+        return True
+
+    def read(self):
+        """ Returns the latest Progress, None if the tool did not write any """
+        if self._map is None and not self._open():
+            return None
+
+        for i in range(MAX_RETRIES):
+            sequence = SEQUENCE.unpack_from(self._map, SEQUENCE_OFFSET)[0]
+            if sequence % 2:
+                continue
+
+            values = RECORD.unpack_from(self._map, 0)
+            if SEQUENCE.unpack_from(self._map, SEQUENCE_OFFSET)[0] != sequence:
+                continue
+
+            if values[0] != MAGIC or values[1] != VERSION:
+                return None
+
+            return Progress(*values[3:10])
+
+        return None
+
+    def close(self):
+        if self._map is not None:
+            self._map.close()
+            self._map = None
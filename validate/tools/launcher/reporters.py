@@ -21,6 +21,7 @@
 
 import os
 import re
+import json
 import codecs
 from loggable import Loggable
 from xml.sax import saxutils
@@ -52,8 +53,6 @@ class Reporter(Loggable):
     def __init__(self, options):
         Loggable.__init__(self)
 
-        self._current_test = None
-        self.out = None
         self.options = options
         self.stats = {'timeout': 0,
                       'failures': 0,
@@ -67,8 +66,7 @@ class Reporter(Loggable):
         path = os.path.join(self.options.logsdir,
                             test.classname.replace(".", os.sep))
         mkdir(os.path.dirname(path))
-        self.out = open(path, 'w+')
-        self._current_test = test
+        test.out = open(path, 'w+')
         test.logfile = path
 
     def set_failed(self, test):
@@ -87,12 +85,49 @@ class Reporter(Loggable):
         else:
             raise UnknownResult("%s" % test.result)
 
-    def after_test(self):
-        self.results.append(self._current_test)
-        self.add_results(self._current_test)
-        self.out.close()
-        self.out = None
-        self._current_test = None
+    def after_test(self, test):
+        self.results.append(test)
+        self.add_results(test)
+        test.out.close()
+        test.out = None
+
+    def _report_resources(self):
+        """ Prints the totals and the tests using the most CPU time and
+        memory, and saves the resources of every test in the logs
+        directory to compare runs """
+        resources = {}
+        for test in self.results:
+            if test.get_resources():
+                resources[test.classname] = dict(test.get_resources())
+
+        if not resources:
+            return
+
+        try:
+            f = open(os.path.join(self.options.logsdir, "resources.json"), "w")
+            json.dump(resources, f, indent=1, sort_keys=True)
+            f.close()
+        except IOError as e:
+            self.warning("Could not save tests resources: %s" % e)
+
+        def cpu(classname):
+            return float(resources[classname]["cpu-user"]) + \
+                float(resources[classname]["cpu-system"])
+
+        def rss(classname):
+            return resources[classname]["max-rss"] / (1024.0 * 1024.0)
+
+        lenstat = (len("Resources") + 1)
+        printc("Resources:\n%s" % (lenstat * "-"), Colors.OKBLUE)
+        printc("%sTotal CPU time: %.3fs" % (lenstat * " ",
+               sum(cpu(classname) for classname in resources)))
+        for name, key, fmt in [("CPU time", cpu, "%.3fs"),
+                               ("peak RSS", rss, "%.1fMiB")]:
+            printc("%sHighest %s:" % (lenstat * " ", name))
+            for classname in sorted(resources, key=key, reverse=True)[:5]:
+                printc("%s  %s: %s" % (lenstat * " ", classname,
+                                       fmt % key(classname)))
+        print "\n"
 
     def final_report(self):
         print "\n"
@@ -101,6 +136,7 @@ class Reporter(Loggable):
             printc(test)
 
         print "\n"
+        self._report_resources()
         lenstat = (len("Statistics") + 1)
         printc("Statistics:\n%s" %(lenstat * "-"), Colors.OKBLUE)
         printc("%sPassed: %d" % (lenstat * " ", self.stats["passed"]), Colors.OKGREEN)
@@ -131,15 +167,25 @@ class XunitReporter(Reporter):
         self.report()
         super(XunitReporter, self).final_report()
 
-    def _get_captured(self):
-        if self.out:
-            self.out.seek(0)
-            value = self.out.read()
+    def _get_captured(self, test):
+        if test.out:
+            test.out.seek(0)
+            value = test.out.read()
             if value:
                 return '<system-out><![CDATA[%s]]></system-out>' % \
                     escape_cdata(value)
         return ''
 
+    def _get_properties(self, test):
+        resources = test.get_resources()
+        if not resources:
+            return ''
+
+        return '<properties>%s</properties>' % ''.join(
+            ['<property name=%s value=%s/>' % (self._quoteattr(name),
+                                              self._quoteattr(str(value)))
+             for name, value in resources])
+
     def _quoteattr(self, attr):
         """Escape an XML attribute. Value can be unicode."""
         attr = xml_safe(attr)
@@ -174,14 +220,15 @@ class XunitReporter(Reporter):
         self.stats['failures'] += 1
         self.errorlist.append(
             '<testcase classname=%(cls)s name=%(name)s time="%(taken).3f">'
-            '<failure type=%(errtype)s message=%(message)s>'
+            '%(properties)s<failure type=%(errtype)s message=%(message)s>'
             '</failure>%(systemout)s</testcase>' %
             {'cls': self._quoteattr(test.get_classname()),
              'name': self._quoteattr(test.get_name()),
              'taken': test.time_taken,
+             'properties': self._get_properties(test),
              'errtype': self._quoteattr(test.result),
              'message': self._quoteattr(test.message),
-             'systemout': self._get_captured(),
+             'systemout': self._get_captured(test),
              })
 
     def set_passed(self, test):
@@ -190,11 +237,12 @@ class XunitReporter(Reporter):
         self.stats['passed'] += 1
         self.errorlist.append(
             '<testcase classname=%(cls)s name=%(name)s '
-            'time="%(taken).3f">%(systemout)s</testcase>' %
+            'time="%(taken).3f">%(properties)s%(systemout)s</testcase>' %
             {'cls': self._quoteattr(test.get_classname()),
              'name': self._quoteattr(test.get_name()),
              'taken': test.time_taken,
-             'systemout': self._get_captured(),
+             'properties': self._get_properties(test),
+             'systemout': self._get_captured(test),
              })
 
     def _forceUnicode(self, s):
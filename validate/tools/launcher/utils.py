@@ -20,7 +20,13 @@
 
 import os
 import re
+import time
+import errno
+import fcntl
+import select
+import signal
 import urllib
+import threading
 import loggable
 import urlparse
 import subprocess
@@ -126,6 +132,122 @@ def launch_command(command, color=None):
     os.system(command)
 
 
+class ChildWatcher(object):
+
+    """ Wakes wait() up as soon as a child process exits: SIGCHLD gets a
+    handler and signal.set_wakeup_fd() writes to a pipe that wait() selects
+    on, so children exiting before wait() is called are not missed """
+
+    def __init__(self):
+        self._pipe = None
+        self._installed = False
+        self._previous_handler = None
+        self._previous_wakeup_fd = -1
+
+    def _sigchld_cb(self, signum, frame):
+        pass
+
+    def __enter__(self):
+        read_fd, write_fd = os.pipe()
+        for fd in (read_fd, write_fd):
+            flags = fcntl.fcntl(fd, fcntl.F_GETFL)
+            fcntl.fcntl(fd, fcntl.F_SETFL, flags | os.O_NONBLOCK)
+        self._pipe = (read_fd, write_fd)
+
+        try:
+            self._previous_wakeup_fd = signal.set_wakeup_fd(write_fd)
+        except ValueError:
+            # Not in the main thread, wait() only returns on deadlines
+            return self
+
+        self._previous_handler = signal.signal(signal.SIGCHLD,
+                                               self._sigchld_cb)
+        self._installed = True
+        # Let interrupted reads and writes be restarted
+        signal.siginterrupt(signal.SIGCHLD, False)
+
+        return self
+
+    def __exit__(self, exc_type, exc_value, traceback):
+        if self._installed:
+            # None when the previous handler was not set from python
+            signal.signal(signal.SIGCHLD,
+                          self._previous_handler or signal.SIG_DFL)
+            signal.set_wakeup_fd(self._previous_wakeup_fd)
+            self._installed = False
+
+        for fd in self._pipe:
+            os.close(fd)
+        self._pipe = None
+
+    def wait(self, deadline=None):
+        """ Returns when a child exited or deadline (in time.time() unit)
+        is reached, whichever comes first """
+        timeout = None
+        if deadline is not None:
+            timeout = max(deadline - time.time(), 0)
+
+        try:
+            readable = select.select([self._pipe[0]], [], [], timeout)[0]
+        except select.error as e:
+            if e.args[0] != errno.EINTR:
+                raise
+            return
+
+        if not readable:
+            return
+
+        try:
+            while os.read(self._pipe[0], 512):
+                pass
+        except OSError as e:
+            if e.errno != errno.EAGAIN:
+                raise
+
+
+class LogTail(object):
+
+    """ Reads the lines appended to a file since the previous read_lines()
+    call. Lines are also split on carriage returns, which the tools use to
+    update their position in place """
+
+    CHUNK_SIZE = 1 << 20
+
+    def __init__(self, path):
+        self.path = path
+        self._offset = 0
+        self._partial = ""
+
+    def read_lines(self):
+        """ Yields the complete lines, the last one is kept until its end
+        is written """
+        try:
+            f = open(self.path, "rb")
+        except IOError:
+            return
+
+        try:
+            if os.fstat(f.fileno()).st_size < self._offset:
+                # The file was truncated, start over
+                self._offset = 0
+                self._partial = ""
+            f.seek(self._offset)
+
+            while True:
+                data = f.read(self.CHUNK_SIZE)
+                if not data:
+                    break
+
+                self._offset += len(data)
+                lines = re.split("[\r\n]", self._partial + data)
+                self._partial = lines.pop()
+                for line in lines:
+                    if line:
+                        yield line
+        finally:
+            f.close()
+
+
 def path2url(path):
     return urlparse.urljoin('file:', urllib.pathname2url(path))
 
@@ -142,6 +264,52 @@ def isuri(string):
     return False
 
 
+def ignore_sigint():
+    """ Initializer of the multiprocessing.Pool workers, the launcher
+    handles KeyboardInterrupt itself and terminates the pool """
+    signal.signal(signal.SIGINT, signal.SIG_IGN)
+
+
+def run_with_timeout(args):
+    """ Runs a command in a multiprocessing.Pool worker, killing it after
+    timeout seconds. args is (index, command, timeout), returns (index,
+    error or None, time it took) """
+    index, command, timeout = args
+    timed_out = []
+
+    def kill(process):
+        timed_out.append(True)
+        try:
+            process.kill()
+        except OSError:
+            pass
+
+    start = time.time()
+    devnull = open(os.devnull, "w")
+    try:
+        process = subprocess.Popen(command, stdout=devnull,
+                                   stderr=subprocess.STDOUT)
+    except OSError as e:
+        devnull.close()
+        return index, str(e), 0
+
+    timer = threading.Timer(timeout, kill, [process])
+    timer.start()
+    try:
+        process.wait()
+    finally:
+        timer.cancel()
+        devnull.close()
+
+    error = None
+    if timed_out:
+        error = "timed out after %d seconds" % timeout
+    elif process.returncode != 0:
+        error = "returned %d" % process.returncode
+
+    return index, error, time.time() - start
+
+
 ##############################
 #    Encoding related utils  #
 ##############################
@@ -229,10 +397,33 @@ def get_duration(media_file):
     return duration
 
 
+verification_regex = re.compile(r'output-verification, output=\(uint\)(?P<output>\d+), '
+                                r'verified=\(boolean\)(?P<verified>\w+), .*'
+                                r'duration=\(guint64\)(?P<duration>\d+)')
+def get_verified_duration(stats_file, output=0):
+    """ Duration of @output as measured by gst-validate-transcoding
+    --verify-output, None if it could not verify it while writing it """
+    try:
+        lines = open(stats_file, 'r').readlines()
+    except IOError:
+        return None
+
+    for l in lines:
+        m = verification_regex.match(l)
+        if m and int(m.group("output")) == output and \
+                m.group("verified") == "true":
+            return long(m.group("duration"))
+
+    return None
+
+
 def compare_rendered_with_original(orig_duration, dest_file, tolerance=DURATION_TOLERANCE):
-        duration = get_duration(dest_file)
+        return compare_durations(orig_duration, get_duration(dest_file),
+                                 tolerance)
+
 
-        if orig_duration - tolerance >= duration >= orig_duration + tolerance:
+def compare_durations(orig_duration, duration, tolerance=DURATION_TOLERANCE):
+        if not (orig_duration - tolerance <= duration <= orig_duration + tolerance):
             return (Result.FAILED, "Duration of encoded file is "
                     " wrong (%s instead of %s)" %
                     (orig_duration / GST_SECOND,